@@ -0,0 +1,794 @@
+#ifndef _CLIENT1_H
+#define _CLIENT1_H
+
+#include <stdio.h>    // FILE
+#include <inttypes.h> // uint8_t
+#include <sys/types.h> // ssize_t
+#include <netdb.h>     // NI_MAXHOST
+#include <limits.h>    // PATH_MAX
+#include <pthread.h>
+#include <setjmp.h>    // jmp_buf
+
+#include "../myproto.h"
+#include "../mylz.h"
+
+#define RESUME_MIN  (1 << 20) // smaller files are simply transferred again
+#define PART_SUFFIX ".part"   // file being received, rebuilt or fetched in ranges: "<filename>.part"
+
+/* end of a file being received (output_close()) */
+#define OUTPUT_KEEP (0)       // transfer interrupted, to be resumed
+#define OUTPUT_DONE (1)       // complete, replaces the file
+#define OUTPUT_FAIL (2)       // wrong, dropped
+
+#define OUTPUT_BATCH (1 << 18) // bytes written at once
+#define OUTPUT_ALIGN (4096)    // O_DIRECT alignment of buffer, offsets and lengths
+#define OUTPUT_RING  (4)       // batches received ahead of the disk (larger files, by a writer thread)
+#define DIRECT_MIN   (64 << 20) // smaller files are written through the page cache (-D)
+#define REQ_MAX     (PROTO_LINE_MAX+3) // request line + CR LF + '\0'
+#define XFER_BUFS   (3)       // buffers of a transfer in progress (struct conn_xfer)
+
+/* file requests types */
+#define REQ_GET     (0) // GET
+#define REQ_REST    (1) // RGET, reply has offset
+#define REQ_COND    (2) // CGET, reply may be "not modified"
+#define REQ_DELTA   (3) // DGET, reply may be "not modified" or has a delta
+
+#define DELTA_MIN   (1 << 16) // smaller local copies are not patched
+#define REDIR_HOPS_MAX (4)    // redirects followed before asking to be served (REDIR)
+#define JOBS_MAX    (64)      // max connections at once (-j)
+#define MIRRORS_MAX (16)      // max servers with the same files (-M)
+#define STRIPE_MAX  (4096)    // max range length (MiB) of a file fetched in ranges (-s)
+#define MANIFEST_BATCH (1024)  // filenames read at once from a manifest (-i), requested before the next ones
+#define MANIFEST_NAME  (NAME_MAX+1) // room for a filename read from a manifest
+
+/* file request */
+struct creq {
+	int       type;       // request type (REQ_*)
+	uint32_t  block;      // REQ_DELTA: block size
+	uint32_t  nblocks;    // REQ_DELTA: nr. of signatures
+};
+
+/* compressed file being received (LZ) */
+struct unlz {
+	uint8_t   hdr[LZ_HDR_LEN]; // block header
+	int       hlen;       // block header bytes received
+	uint32_t  rawlen;     // block raw length
+	uint32_t  clen;       // block compressed length
+	uint32_t  cgot;       // block compressed bytes received
+	uint8_t   *cbuf;      // compressed block
+	uint8_t   *raw;       // decompressed block
+	int       end;        // end of stream received
+	uint64_t  size;       // file size
+	uint64_t  written;    // bytes written on file
+	uint32_t  crc;        // checksum of the bytes written
+};
+
+/* file being received */
+struct output {
+	const char    *filename;
+	char          part[PATH_MAX]; // written here, renamed when complete
+	int           fd;
+	uint8_t       *buf;       // batch being filled (aligned for O_DIRECT)
+	size_t        len;        // bytes in buf
+	size_t        cap;        // buf size
+	int           direct;     // O_DIRECT: whole blocks written, the tail without it
+	/* files larger than a batch: filled batches are written by a writer thread */
+	uint8_t       *ring;      // OUTPUT_RING batches, NULL if written by the receiver
+	size_t        lens[OUTPUT_RING]; // bytes of each batch
+	int           head;       // batch being filled
+	int           full;       // batches filled, not written yet (before head)
+	int           err;        // write failed or file dropped: the next batches are discarded
+	int           end;        // no more batches
+	pthread_t       writer;
+	pthread_mutex_t lock;
+	pthread_cond_t  cond;     // a batch filled or written
+};
+
+/* DATA DEFINITION */
+
+/* transfer in progress on a connection, released if the connection is lost */
+struct conn_xfer {
+	void          *bufs[XFER_BUFS]; // buffers, freed
+	void          *files;     // files being received...
+	int           nfiles;
+	void          (*close)(void *files, int nfiles); // ...closed to be resumed, NULL for none
+};
+
+struct conn {
+	const char    *host;      // server address
+	const char    *serv;      // server port
+	char          rhost[NI_MAXHOST]; // REDIR: address of the server redirected to
+	char          rserv[NI_MAXSERV]; // REDIR: its port
+	int           sockfd;     // connected socket
+	unsigned int  features;   // negotiated protocol extensions (FEAT_*)
+	int           rcvbuflen;  // socket receive buffer length
+	uint8_t       *rbuf;      // receive buffer (rcvbuflen bytes)
+	uint32_t      nstreams;   // MUX: streams opened, the next request gets stream nstreams + 1
+	struct conn_xfer xfer;    // transfer in progress (see conn_abort())
+};
+
+/* how connections are opened and used */
+struct conn_cfg {
+	const char    *host;      // server address
+	const char    *serv;      // server port
+	unsigned int  feats;      // extensions to negotiate (FEAT_*), 0 for none
+	int           prio;       // priority class of the requests (PRIO), -1 for none
+	int           window;     // max nr. of outstanding requests, 0 for default
+};
+
+/* list of filenames, read while they are requested (-i) */
+struct manifest {
+	const char    *path;      // "-" for standard input
+	FILE          *fp;
+	char          *line;      // getline() buffer
+	size_t        cap;
+	uint64_t      lineno;
+};
+
+/* FUNCTIONS */
+
+/**
+ * @brief Connects to server and prepares the receive buffer
+ *
+ * NOTE: exits on error
+ *
+ * @param c             connection
+ * @param host          server address
+ * @param serv          server port
+ */
+void conn_open(struct conn *c, const char *host, const char *serv);
+
+/**
+ * @brief Negotiates protocol extensions (FEAT), must be the first command
+ *
+ * NOTE: a server without extensions replies "-ERR" and closes the connection,
+ *       in that case client reconnects and no extension is enabled. A busy
+ *       server may redirect the client to a peer (REDIR): the client connects
+ *       to it and negotiates again. Exits on error.
+ *
+ * @param c             connection
+ * @param feats         wanted extensions (FEAT_*)
+ */
+void conn_negotiate(struct conn *c, unsigned int feats);
+
+/**
+ * @brief Sets the priority class of the next requests (PRIO), if negotiated
+ *
+ * NOTE: PRIO has no reply. Exits on error.
+ *
+ * @param c             connection
+ * @param prio          priority class (PROTO_PRIO_*)
+ */
+void conn_set_prio(struct conn *c, int prio);
+
+/**
+ * @brief Connects to server, negotiates protocol extensions and sets the
+ *        priority class of the requests
+ *
+ * NOTE: exits on error
+ *
+ * @param c             connection
+ * @param cfg           server and extensions
+ */
+void conn_start(struct conn *c, const struct conn_cfg *cfg);
+
+/**
+ * @brief Sends "QUIT" and closes the connection
+ *
+ * @param c             connection
+ */
+void conn_close(struct conn *c);
+
+/**
+ * @brief Releases the transfer in progress on a connection lost (see
+ *        die_recover()): its files are closed to be resumed, its buffers freed
+ *
+ * NOTE: the socket and the receive buffer are released by die_from_err()
+ *
+ * @param c             connection
+ */
+void conn_abort(struct conn *c);
+
+/**
+ * @brief Ends the transfer in progress on a connection: frees its buffers
+ *
+ * @param c             connection
+ */
+void conn_xfer_end(struct conn *c);
+
+/**
+ * @brief Prepares the request for a file with the negotiated extensions:
+ *        RGET if an interrupted transfer can be resumed, DGET if there is a
+ *        local copy of at least DELTA_MIN bytes (FEAT_DELTA), CGET if there is
+ *        a local copy (FEAT_COND), GET otherwise
+ *
+ * NOTE: a DGET request line must be followed by the signatures of the local
+ *       copy (see conn_send_sigs())
+ *
+ * @param c             connection
+ * @param filename      file to request
+ * @param buf           request buffer
+ * @param buflen        request buffer length
+ * @param req           request (output)
+ *
+ * @return  request length if OK
+ * @return -1 if the request does not fit the buffer
+ */
+int conn_request(struct conn *c, const char *filename, char *buf, int buflen, struct creq *req);
+
+/**
+ * @brief Sends the signatures of the local copy of a file (DGET)
+ *
+ * @param c             connection
+ * @param filename      file requested
+ * @param req           DGET request
+ *
+ * @return  0 if OK
+ * @return -1 on error
+ */
+int conn_send_sigs(struct conn *c, const char *filename, const struct creq *req);
+
+/**
+ * @brief Reads a reply line up to CR LF ('\0' terminated, CR LF excluded)
+ *
+ * @param sockfd        socket
+ * @param buf           line buffer
+ * @param buflen        line buffer length
+ *
+ * @return  line length if OK
+ * @return -1 on error (connection closed or line too long)
+ */
+int read_line(int sockfd, char *buf, int buflen);
+
+/**
+ * @brief Manages file transfer from receiver buffer to file-system file.
+ *
+ * NOTE: if the transfer of a file of at least RESUME_MIN bytes is interrupted,
+ *       its size and timestamp are kept in "<filename>.resume" so that it can
+ *       be resumed (see resume_check()). With output_stream() the file is
+ *       streamed instead, from offset 0 (and not removed if its checksum does
+ *       not match).
+ *
+ * @param sockfd        Opened socked where to read
+ * @param filename      Name of the file to be created
+ * @param info          Size and timestamp of the file to be received
+ * @param offset        Offset of the first byte to be received (resume)
+ * @param buf_size      Default receiver buffer size
+ * @param crc           the file is followed by its checksum (CRC)
+ *
+ * @return   1 if OK
+ * @return   0 if the checksum does not match (file removed)
+ * @return  -1 on error
+ * @return  -2 on file-system error
+ */
+ssize_t download_file(const int sockfd,
+                      const char* filename,
+                      const struct proto_info *info,
+                      const uint64_t offset,
+                      const int buf_size,
+                      const int crc);
+
+/**
+ * @brief Receives the delta of a file and rebuilds it from the local copy
+ *
+ * @param sockfd        Opened socked where to read
+ * @param filename      Name of the file to be rebuilt
+ * @param info          Size and timestamp of the file to be rebuilt
+ * @param block         Block size of the signatures
+ * @param delta_len     Length of the delta to be received
+ * @param buf_size      Default receiver buffer size
+ * @param crc           the delta is followed by the file checksum (CRC)
+ *
+ * @return   1 if OK
+ * @return   0 if the checksum does not match (local copy kept)
+ * @return  -1 on error
+ * @return  -2 on file-system error
+ */
+ssize_t download_delta(const int sockfd,
+                       const char* filename,
+                       const struct proto_info *info,
+                       const uint32_t block,
+                       const uint64_t delta_len,
+                       const int buf_size,
+                       const int crc);
+
+/**
+ * @brief Rebuilds a file from its local copy and a delta ("<filename>.part"
+ *        then renamed)
+ *
+ * @param filename      Name of the file to be rebuilt
+ * @param delta         Delta received
+ * @param info          Size and timestamp of the file to be rebuilt
+ * @param block         Block size of the signatures
+ * @param trailer       checksum of the file (CRC), NULL if not available
+ *
+ * @return   1 if OK
+ * @return   0 if the checksum does not match (local copy kept)
+ * @return  -1 on error (wrong delta)
+ * @return  -2 on file-system error
+ */
+int patch_file(const char* filename,
+               FILE *delta,
+               const struct proto_info *info,
+               const uint32_t block,
+               const uint8_t *trailer);
+
+/**
+ * @brief Compares the checksum of a received file with the one sent by the
+ *        server (CRC), printing an error if they differ
+ *
+ * @param filename      Name of the file
+ * @param trailer       checksum sent by the server (PROTO_CRC_LEN bytes)
+ * @param crc           checksum of the file received
+ *
+ * @return  1 if they match
+ * @return  0 otherwise
+ */
+int crc_match(const char *filename, const uint8_t *trailer, uint32_t crc);
+
+/**
+ * @brief Tells if a file was discarded because its checksum did not match
+ *        (see crc_match()), the exit status of the client
+ *
+ * @return  1 if a checksum did not match
+ * @return  0 otherwise
+ */
+int crc_failed(void);
+
+/**
+ * @brief Computes the checksum of the first 'len' bytes of a file
+ *
+ * @param filename      Name of the file
+ * @param len           bytes to be read
+ * @param crc           checksum (updated)
+ *
+ * @return   0 if OK
+ * @return  -1 on file-system error
+ */
+int file_crc(const char *filename, uint64_t len, uint32_t *crc);
+
+/**
+ * @brief Tells if the file content of the reply to a request is compressed
+ *        (GET and CGET with FEAT_LZ)
+ *
+ * @param c             connection
+ * @param req           request
+ *
+ * @return  1 to say YES
+ * @return  0 to say NO
+ */
+int reply_compressed(const struct conn *c, const struct creq *req);
+
+/**
+ * @brief Receives a compressed file and decompresses it while writing it
+ *
+ * @param sockfd        Opened socked where to read
+ * @param filename      Name of the file to be created
+ * @param info          Size and timestamp of the file to be received
+ * @param crc           the file is followed by its checksum (CRC)
+ *
+ * @return   1 if OK
+ * @return   0 if the checksum does not match (file removed)
+ * @return  -1 on error
+ * @return  -2 on file-system error
+ */
+ssize_t download_lz(const int sockfd,
+                    const char* filename,
+                    const struct proto_info *info,
+                    const int crc);
+
+/**
+ * @brief Prepares the decompression of a file
+ *
+ * @param z             decompression state
+ * @param size          file size
+ *
+ * @return   0 if OK
+ * @return  -1 on system error
+ */
+int unlz_init(struct unlz *z, uint64_t size);
+
+/**
+ * @brief Frees the decompression buffers
+ *
+ * @param z             decompression state
+ */
+void unlz_free(struct unlz *z);
+
+/**
+ * @brief Bytes needed to complete the current block header or block data
+ *
+ * @param z             decompression state
+ *
+ * @return  the nr. of bytes
+ */
+int unlz_need(const struct unlz *z);
+
+/**
+ * @brief Consumes compressed data, writing the decompressed blocks on file
+ *
+ * @param z             decompression state
+ * @param o             file being written
+ * @param buf           compressed data
+ * @param len           compressed data length
+ *
+ * @return  nr. of bytes consumed if OK (it stops at the end of stream)
+ * @return  -1 on error (wrong data)
+ * @return  -2 on file-system error
+ */
+int unlz_feed(struct unlz *z, struct output *o, const uint8_t *buf, int len);
+
+/**
+ * @brief Opens a file to be received, from offset if resumed: it is written
+ *        into "<filename>.part", with the blocks for its size allocated at
+ *        once, and replaces the file when complete (see output_close())
+ *
+ * NOTE: transfers from offset 0 of files of at least RESUME_MIN bytes save
+ *       the resume info (see download_file()). Files of at least the size
+ *       given to output_direct() are written with O_DIRECT.
+ *
+ * @param filename      Name of the file to be created
+ * @param info          Size and timestamp of the file to be received
+ * @param offset        Offset of the first byte to be received (resume)
+ * @param crc           checksum of the bytes before offset (output), NULL if
+ *                      not needed
+ *
+ * @return  the opened file if OK
+ * @return  NULL on file-system error
+ */
+struct output *output_open(const char* filename,
+                           const struct proto_info *info,
+                           const uint64_t offset,
+                           uint32_t *crc);
+
+/**
+ * @brief Writes data received on a file, in batches of OUTPUT_BATCH bytes;
+ *        with files larger than a batch, a writer thread writes them while
+ *        the next ones are received (up to OUTPUT_RING batches)
+ *
+ * @param o             file being received
+ * @param buf           data
+ * @param len           data length
+ *
+ * @return   0 if OK
+ * @return  -2 on file-system error
+ */
+int output_write(struct output *o, const uint8_t *buf, size_t len);
+
+/**
+ * @brief Ends a file being received: OUTPUT_DONE renames it and sets its
+ *        timestamp (see output_done()), OUTPUT_FAIL drops it and its resume
+ *        info, OUTPUT_KEEP leaves it to be resumed (interrupted transfer)
+ *
+ * @param o             file being received (freed)
+ * @param info          Size and timestamp of the file
+ * @param how           OUTPUT_*
+ *
+ * @return   1 if OUTPUT_DONE and OK
+ * @return   0 if OUTPUT_FAIL or OUTPUT_KEEP
+ * @return  -2 on file-system error (with OUTPUT_DONE the file is dropped)
+ */
+int output_close(struct output *o, const struct proto_info *info, int how);
+
+/**
+ * @brief Writes the files of at least 'min' bytes with O_DIRECT, not through
+ *        the page cache (where the file system supports it)
+ *
+ * @param min           min file size, 0 for never (default)
+ */
+void output_direct(uint64_t min);
+
+/**
+ * @brief Streams the files received to a descriptor instead of writing them
+ *        on disk: each one preceded by the line "<size> <timestamp>
+ *        <filename>\n", with splice() (no copy through the client) if it is
+ *        a pipe and the checksum is not needed
+ *
+ * @param fd            descriptor (e.g. standard output), -1 for none (default)
+ */
+void output_stream(int fd);
+
+/**
+ * @brief Marks a received file as complete: removes resume info and sets its
+ *        timestamp to the server's one, so that CGET can tell if it changed
+ *
+ * @param filename      Name of the file
+ * @param info          Size and timestamp of the file
+ */
+void output_done(const char* filename, const struct proto_info *info);
+
+/**
+ * @brief Checks if a previous transfer of a file was interrupted
+ *
+ * @param filename      Name of the file
+ * @param info          Size and timestamp of the file being transferred (output)
+ * @param offset        Bytes already transferred (output)
+ *
+ * @return  1 if transfer can be resumed
+ * @return  0 otherwise
+ */
+int resume_check(const char *filename,
+                 struct proto_info *info,
+                 uint64_t *offset);
+
+/**
+ * @brief Requests files with the negotiated extensions: in batches with MGET,
+ *        over MUX streams or pipelined GET
+ *
+ * NOTE: exits on error
+ *
+ * @param c             connection
+ * @param files         filenames to request
+ * @param nfiles        nr. of filenames
+ * @param window        max nr. of outstanding requests, 0 for default
+ */
+void fetch_files_any(struct conn *c, char **files, int nfiles, int window);
+
+/**
+ * @brief Max nr. of outstanding requests on a connection
+ *
+ * @param c             connection (negotiated)
+ * @param window        requested window, 0 for default
+ *
+ * @return  the window (32 with MUX, 1 otherwise, if not requested)
+ */
+int conn_window(const struct conn *c, int window);
+
+/**
+ * @brief Requests files over many connections at once, each one fetching
+ *        the next files of a shared list as soon as it is done with its own
+ *        (the last files are taken one at a time, so that a large file does
+ *        not keep the others waiting while connections are idle)
+ *
+ * The connections are spread over the servers given (mirrors with the same
+ * files): a lost connection gives the files of its batch not received yet
+ * back to the others, and is not opened again.
+ *
+ * NOTE: the calling thread serves a connection too. Exits if every
+ *       connection is lost with files left.
+ *
+ * @param cfgs          servers (and extensions)
+ * @param ncfgs         nr. of servers
+ * @param files         filenames to request
+ * @param nfiles        nr. of filenames
+ * @param m             manifest the filenames are read from instead (in
+ *                      batches, as the connections take them), NULL for none
+ * @param nconns        nr. of connections (max if adaptive)
+ * @param adaptive      the connections open and their window (if not
+ *                      requested) follow the goodput (AIMD): one more of each
+ *                      while it grows, half of them when a connection is lost
+ *                      or the latency rises
+ */
+void fetch_files_jobs(const struct conn_cfg *cfgs, int ncfgs, char **files, int nfiles, struct manifest *m,
+					  int nconns, int adaptive);
+
+/**
+ * @brief Marks a file of the batch of the calling thread's connection as
+ *        received, not to be given back if the connection is lost (-j), and
+ *        counts its bytes (-A); a file already marked is not counted again
+ *
+ * @param filename      filename, as in the batch
+ * @param bytes         bytes received
+ */
+void job_done(const char *filename, uint64_t bytes);
+
+/**
+ * @brief Opens a manifest: a filename per line (leading and trailing spaces
+ *        are trimmed, empty lines skipped)
+ *
+ * @param m             manifest
+ * @param path          its path, "-" for standard input
+ *
+ * @return  0 if OK
+ * @return -1 if it cannot be opened
+ */
+int manifest_open(struct manifest *m, const char *path);
+
+/**
+ * @brief Reads the next filenames of a manifest (a filename too long is
+ *        reported and skipped)
+ *
+ * NOTE: not thread-safe, a manifest shared by connections is read holding
+ *       a lock
+ *
+ * @param m             manifest
+ * @param files         filenames read (output)
+ * @param names         room for them: 'max' * MANIFEST_NAME bytes
+ * @param max           max filenames to read
+ *
+ * @return  nr. of filenames read
+ * @return  0 at the end of the manifest (or on error reading it)
+ */
+int manifest_read(struct manifest *m, char **files, char *names, int max);
+
+/**
+ * @brief Closes a manifest
+ *
+ * @param m             manifest
+ */
+void manifest_close(struct manifest *m);
+
+/**
+ * @brief Requests the files of a manifest, MANIFEST_BATCH at a time, so the
+ *        whole list is never in memory
+ *
+ * NOTE: exits on error
+ *
+ * @param c             connection (negotiated)
+ * @param m             manifest
+ * @param window        requested window, 0 for default
+ */
+void fetch_manifest(struct conn *c, struct manifest *m, int window);
+
+/**
+ * @brief Trims leading and trailing spaces of a string, in place
+ *
+ * @param str           string
+ * @param slen          its length
+ *
+ * @return  the string
+ */
+char *str_trim(char *str, const size_t slen);
+
+/**
+ * @brief Runs a worker for each connection, in its own thread, and waits for
+ *        all of them
+ *
+ * NOTE: the calling thread runs one of them, if some thread cannot be started
+ *       the work is done by the others
+ *
+ * @param worker        thread function, opens and serves a connection
+ * @param arg           its argument, shared by the workers
+ * @param nconns        nr. of connections
+ */
+void run_conns(void *(*worker)(void *), void *arg, int nconns);
+
+/**
+ * @brief Requests files in ranges of 'stripe' bytes with PGET, spread over
+ *        many connections: the first range of a file tells its size, the
+ *        others are requested by any connection, written in place into
+ *        "<filename>.part" (allocated at once), renamed when complete
+ *
+ * NOTE: the ranges of the files started are requested before the next file,
+ *       so all the connections fetch a large file. A file that changes on
+ *       the server while fetched is discarded. Exits on error.
+ *
+ * @param cfg           server and extensions (FEAT_RANGE, not FEAT_MUX)
+ * @param files         filenames to request
+ * @param nfiles        nr. of filenames
+ * @param nconns        nr. of connections
+ * @param stripe        range length
+ */
+void fetch_files_striped(const struct conn_cfg *cfg, char **files, int nfiles, int nconns, uint64_t stripe);
+
+/**
+ * @brief Requests files with GET (RGET) over MUX streams, keeping up to
+ *        'window' requests in flight. Replies are written as they arrive,
+ *        interleaved.
+ *
+ * NOTE: a missing file does not close the connection. Exits on error.
+ *
+ * @param c             connection (FEAT_MUX negotiated)
+ * @param files         filenames to request
+ * @param nfiles        nr. of filenames
+ * @param window        max nr. of outstanding requests
+ */
+void fetch_files_mux(struct conn *c, char **files, int nfiles, int window);
+
+/**
+ * @brief Lists directories with LIST and prints their manifests, one request
+ *        at a time
+ *
+ * NOTE: a missing directory does not close the connection with NERR. Exits
+ *       on error.
+ *
+ * @param c             connection (FEAT_LIST negotiated, not FEAT_MUX)
+ * @param paths         directories or patterns to list
+ * @param npaths        nr. of paths
+ */
+void list_dirs(struct conn *c, char **paths, int npaths);
+
+/**
+ * @brief Reads the status of a LIST or BNDL reply from a buffered stream of
+ *        the socket
+ *
+ * NOTE: exits on "-ERR" or wrong data
+ *
+ * @param c             connection
+ * @param in            socket stream
+ * @param path          path requested (for messages)
+ *
+ * @return  1 if "+OK", the reply follows
+ * @return  0 if "-NOK" (NERR), the error was printed
+ */
+int read_stream_status(struct conn *c, FILE *in, const char *path);
+
+/**
+ * @brief Fetches directory trees with BNDL, one request at a time: each
+ *        archive is unpacked while received, into a local directory with
+ *        the name requested
+ *
+ * NOTE: paths received are checked, none can end out of the directory, and
+ *       local symbolic links are not followed for the files written. Files
+ *       with a wrong checksum (CRC) are removed. Exits on error.
+ *
+ * @param c             connection (FEAT_BNDL negotiated, not FEAT_MUX)
+ * @param dirs          directories to fetch
+ * @param ndirs         nr. of directories
+ */
+void bundle_dirs(struct conn *c, char **dirs, int ndirs);
+
+/**
+ * @brief Follows growing files with FGET, one after the other: the bytes
+ *        appended on the server are appended to the local copies as they
+ *        arrive. SIGINT sends STOP and ends after the file being followed.
+ *
+ * NOTE: a local copy is continued from its size. Exits on error.
+ *
+ * @param c             connection (FEAT_FOLLOW negotiated, not FEAT_MUX)
+ * @param files         filenames to follow
+ * @param nfiles        nr. of filenames
+ * @param idle          each file ends after 'idle' ms without appends (0 never)
+ */
+void follow_files(struct conn *c, char **files, int nfiles, uint32_t idle);
+
+/**
+ * @brief Prints info about a transferred file
+ *
+ * @param filename      Name of the file
+ * @param info          Size and timestamp of the file
+ */
+void print_file_info(const char *filename, const struct proto_info *info);
+
+/**
+ * @brief Prints that a file was not transferred since not modified (CGET)
+ *
+ * @param filename      Name of the file
+ */
+void print_not_modified(const char *filename);
+
+/**
+ * @brief Reads the rest of an error reply (after '-'): "-ERR" or "-NOK" (NERR)
+ *
+ * NOTE: exits on error
+ *
+ * @param c             connection
+ *
+ * @return  the status of a "-NOK" reply (PROTO_ST_*), the connection goes on
+ * @return -1 on "-ERR", left in c->rbuf
+ */
+int read_srv_err(struct conn *c);
+
+/**
+ * @brief Reports a "-ERR" reply (read by read_srv_err()) and exits
+ *
+ * NOTE: the server closes the connection after an error: the requests still
+ *       in the pipeline will never be answered
+ *
+ * @param c             connection
+ * @param filename      file the error refers to (NULL if not a file request)
+ * @param pending       nr. of requests still waiting for reply
+ */
+void die_from_srv_err(struct conn *c, const char *filename, int pending);
+
+/**
+ * @brief Closes connection and exits (or, in a thread that called
+ *        die_recover(), jumps back to it)
+ *
+ * @param sockfd        socket
+ * @param buf           buffer to be freed (may be NULL)
+ */
+void die_from_err(int sockfd, uint8_t* buf);
+
+/**
+ * @brief Makes die_from_err() of the calling thread jump to 'env' instead of
+ *        exiting: the connection is lost, not the others (-j)
+ *
+ * NOTE: what the functions left were holding (buffers, files being received)
+ *       is not freed, the files can be received again
+ *
+ * @param env           where to jump (set with setjmp()), NULL to exit
+ */
+void die_recover(jmp_buf *env);
+
+#endif
@@ -0,0 +1,264 @@
+/** ---------------------------------------------------------------------------
+ * Client1 - Directory trees in one archive (BNDL)
+ *
+ * @author dcr
+ * ----------------------------------------------------------------------------
+ */
+#define _GNU_SOURCE          // O_NOFOLLOW, O_CLOEXEC
+#define _FILE_OFFSET_BITS 64 // files > 2GB on 32-bit systems
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>     // dup(), unlink()
+#include <errno.h>
+#include <fcntl.h>      // open()
+#include <limits.h>     // PATH_MAX
+#include <inttypes.h>   // PRIu64
+#include <sys/stat.h>   // mkdir(), futimens()
+
+#include "../error.h"
+#include "../mylibsock.h"
+#include "../myproto.h"
+#include "../mycrc.h"
+#include "client1.h"
+
+#define BNDL_STREAM_BUF	(1 << 18) // archive read buffer: many small files per read()
+
+static int unpack(struct conn *c, FILE *in, const char *root);
+static int unpack_file(struct conn *c, FILE *in, char *path, const struct proto_info *info);
+static int safe_path(const char *path);
+static int make_dirs(char *path);
+
+/* archive being unpacked */
+static uint64_t nfiles = 0;
+static uint64_t ndirs  = 0;
+static uint64_t nbytes = 0;
+
+
+void
+bundle_dirs(struct conn *c, char **dirs, int ndir)
+{
+	char req[REQ_MAX];
+	FILE *in = NULL;
+	int  len = 0;
+	int  i   = 0;
+
+	/* NOTE: one BNDL at a time, nothing follows an archive: it can be read buffered */
+	if ( ( in = fdopen(dup(c->sockfd), "r") ) == NULL ||
+		 setvbuf(in, NULL, _IOFBF, BNDL_STREAM_BUF) != 0 ) {
+		err_ret("ERROR: could not open socket stream");
+		die_from_err(c->sockfd, c->rbuf);
+	}
+
+	for ( i = 0; i < ndir; i++ ) {
+
+		len = snprintf(req, sizeof(req), "BNDL %s\r\n", dirs[i]);
+		if ( ( Writen(c->sockfd, req, len) ) < 0 )
+			die_from_err(c->sockfd, c->rbuf);
+
+		if ( !read_stream_status(c, in, dirs[i]) )
+			continue;
+
+		if ( ( mkdir(dirs[i], 0777) < 0 ) && ( errno != EEXIST ) )
+			err_ret("ERROR: could not create directory \"%s\"", dirs[i]); // its entries fail too
+
+		nfiles = ndirs = nbytes = 0;
+		if ( unpack(c, in, dirs[i]) < 0 ) {
+			err_msg("ERROR: wrong data format received from server.");
+			die_from_err(c->sockfd, c->rbuf);
+		}
+
+		printf("Received \"%s\": %"PRIu64" files, %"PRIu64" directories, %"PRIu64" bytes.\n",
+			   dirs[i], nfiles, ndirs, nbytes);
+	}
+
+	fclose(in);
+}
+
+
+/**
+ * @brief Unpacks the entries of an archive under 'root', up to its end
+ *
+ * @return  0 if OK
+ * @return -1 on error (wrong data or connection closed)
+ */
+static int
+unpack(struct conn *c, FILE *in, const char *root)
+{
+	struct proto_info info;
+	uint8_t hdr[PROTO_INFO_LEN_X64];
+	char    name[PATH_MAX];
+	char    path[PATH_MAX];
+	int     ilen = proto_info_len(c->features);
+	int     type = 0;
+	int     len  = 0;
+
+	for ( ; ; ) {
+
+		if ( fread(hdr, 1, 1, in) < 1 )
+			return -1;
+		if ( ( type = hdr[0] ) == PROTO_BNDL_END )
+			return 0;
+
+		if ( ( ( type != PROTO_BNDL_FILE ) && ( type != PROTO_BNDL_DIR ) ) || ( fread(hdr, 1, 2, in) < 2 ) )
+			return -1;
+
+		len = ( hdr[0] << 8 ) | hdr[1];
+		if ( ( len == 0 ) || ( len >= (int) sizeof(name) ) || ( fread(name, 1, len, in) < (size_t) len ) ||
+			 ( fread(hdr, 1, ilen, in) < (size_t) ilen ) )
+			return -1;
+		name[len] = '\0';
+		proto_get_info(hdr, &info, c->features);
+
+		/* NOTE: the server is not trusted, the archive stays under 'root' */
+		if ( ( len != (int) strlen(name) ) || !safe_path(name) )
+			return -1;
+
+		if ( snprintf(path, sizeof(path), "%s/%s", root, name) >= (int) sizeof(path) ) {
+			err_msg("ERROR: path too long: \"%s/%s\", not saved.", root, name);
+			path[0] = '\0';
+		}
+
+		if ( type == PROTO_BNDL_DIR ) {
+			if ( ( path[0] != '\0' ) && ( mkdir(path, 0777) < 0 ) && ( errno != EEXIST ) &&
+				 ( ( errno != ENOENT ) || ( make_dirs(path) < 0 ) || ( mkdir(path, 0777) < 0 ) ) )
+				err_ret("ERROR: could not create directory \"%s\"", path);
+			++ndirs;
+			continue;
+		}
+
+		if ( unpack_file(c, in, path, &info) < 0 )
+			return -1;
+	}
+}
+
+
+/**
+ * @brief Writes the data of a file entry (skipped if 'path' is empty or the
+ *        file cannot be created)
+ *
+ * @return  0 if OK
+ * @return -1 on connection error
+ */
+static int
+unpack_file(struct conn *c, FILE *in, char *path, const struct proto_info *info)
+{
+	struct timespec times[2];
+	uint8_t  trailer[PROTO_CRC_LEN];
+	uint64_t left = info->size;
+	uint32_t crc  = 0;
+	int      fd   = -1;
+	int      ok   = 1;
+	size_t   n    = 0;
+
+	/* NOTE: an existing symbolic link is not followed, parents are created if needed */
+	if ( path[0] != '\0' ) {
+		fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0666);
+		if ( ( fd < 0 ) && ( errno == ENOENT ) && ( make_dirs(path) == 0 ) )
+			fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0666);
+		if ( fd < 0 )
+			err_ret("ERROR: could not open file \"%s\"", path);
+	}
+	ok = ( fd >= 0 );
+
+	for ( ; left > 0; left -= n ) {
+		n = ( left < (uint64_t) c->rcvbuflen ? left : (uint64_t) c->rcvbuflen );
+		if ( fread(c->rbuf, 1, n, in) < n ) {
+			if ( fd >= 0 )
+				close(fd);
+			return -1;
+		}
+
+		if ( c->features & FEAT_CRC )
+			crc = crc32c(crc, c->rbuf, n);
+
+		if ( ok && ( writen(fd, c->rbuf, n) ) < 0 ) {
+			err_ret("ERROR: cannot write file \"%s\"", path);
+			ok = 0;
+		}
+	}
+
+	if ( ( c->features & FEAT_CRC ) && ( fread(trailer, 1, PROTO_CRC_LEN, in) < PROTO_CRC_LEN ) ) {
+		if ( fd >= 0 )
+			close(fd);
+		return -1;
+	}
+
+	if ( fd < 0 )
+		return 0;
+
+	if ( ok && ( c->features & FEAT_CRC ) )
+		ok = crc_match(path, trailer, crc);
+
+	if ( ok ) {
+		times[0].tv_sec  = 0;
+		times[0].tv_nsec = UTIME_OMIT; // access time unchanged
+		times[1].tv_sec  = info->ts;
+		times[1].tv_nsec = ( info->ts_ns == PROTO_NS_ANY ? 0 : info->ts_ns );
+		if ( futimens(fd, times) < 0 )
+			err_ret("WARNING: could not set timestamp of \"%s\"", path);
+	}
+
+	close(fd);
+
+	if ( !ok ) {
+		unlink(path);
+		return 0;
+	}
+
+	++nfiles;
+	nbytes += info->size;
+	return 0;
+}
+
+
+/**
+ * @brief Checks a path received: relative, no empty, "." or ".." components
+ *
+ * @return  1 if safe
+ * @return  0 otherwise
+ */
+static int
+safe_path(const char *path)
+{
+	const char *p = path;
+	const char *slash = NULL;
+	size_t len = 0;
+
+	for ( ; ; p = slash + 1 ) {
+		slash = strchr(p, '/');
+		len   = ( slash != NULL ? (size_t) (slash - p) : strlen(p) );
+
+		if ( ( len == 0 ) || ( ( len == 1 ) && ( p[0] == '.' ) ) ||
+			 ( ( len == 2 ) && ( p[0] == '.' ) && ( p[1] == '.' ) ) )
+			return 0;
+
+		if ( slash == NULL )
+			return 1;
+	}
+}
+
+
+/**
+ * @brief Creates the missing parent directories of a path
+ *
+ * @return  0 if OK
+ * @return -1 on error
+ */
+static int
+make_dirs(char *path)
+{
+	char *p = path;
+
+	for ( p = strchr(path + 1, '/'); p != NULL; p = strchr(p + 1, '/') ) {
+		*p = '\0';
+		if ( ( mkdir(path, 0777) < 0 ) && ( errno != EEXIST ) ) {
+			*p = '/';
+			return -1;
+		}
+		*p = '/';
+	}
+
+	return 0;
+}
@@ -0,0 +1,333 @@
+/** ---------------------------------------------------------------------------
+ * Client1 - Connection management
+ *
+ * @author dcr
+ * ----------------------------------------------------------------------------
+ */
+#define _FILE_OFFSET_BITS 64 // files > 2GB on 32-bit systems
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <inttypes.h>   // PRIyXX
+#include <sys/stat.h>   // stat()
+#include <sys/types.h>  // getsockopt()
+#include <sys/socket.h> // getsockopt()
+#include <sys/select.h> // fd_set
+
+#include "../error.h"
+#include "../mylibsock.h"
+#include "../mylibtcp.h"
+#include "../myproto.h"
+#include "../mydelta.h"
+#include "client1.h"
+
+#define SO_RCVBUF_MAX   (8120)       // above 8120 gains in performance are negligible
+
+static int get_SO_RCVBUF(int sock);
+
+
+void
+conn_open(struct conn *c, const char *host, const char *serv)
+{
+	c->host     = host;
+	c->serv     = serv;
+	c->features = 0;
+	c->nstreams = 0;
+	memset(&(c->xfer), 0, sizeof(struct conn_xfer));
+
+	/* create socket and connect to server */
+	/* NOTE: the addresses returned by getaddrinfo() are raced, each one is
+	 * given up after 5s (see mylibtcp.c) */
+	if ( ( c->sockfd = tcp_try_connect(host, serv) ) < 0 )
+		die_from_err(c->sockfd, NULL);
+
+	/* get socket receive buffer length */
+	c->rcvbuflen = get_SO_RCVBUF(c->sockfd);
+
+	/* prepare receive buffer */
+	if ( ( c->rbuf = calloc(c->rcvbuflen, sizeof(uint8_t)) ) == NULL ) {
+		err_ret("ERROR: could not allocate receive buffer");
+		die_from_err(c->sockfd, NULL);
+	}
+}
+
+
+void
+conn_negotiate(struct conn *c, unsigned int feats)
+{
+	char buf[PROTO_LINE_MAX+1];
+	char *port = NULL;
+	int  slen = 0;
+	int  hops = 0;
+	int  n    = 0;
+
+	if ( feats == 0 )
+		return;
+
+	/* NOTE: after REDIR_HOPS_MAX redirects REDIR is not offered, the server must serve us */
+	for ( hops = 0; ; hops++ ) {
+		if ( hops == REDIR_HOPS_MAX )
+			feats &= ~FEAT_REDIR;
+
+		/* prepare request: "FEAT" + tokens + CR LF */
+		memcpy(buf, "FEAT", 4);
+		if ( ( n = proto_fmt_feats(buf+4, sizeof(buf)-6, feats) ) < 0 )
+			die_from_err(c->sockfd, c->rbuf); // shouldn't really happen
+		memcpy(buf+4+n, "\r\n", 2);
+		slen = n+6;
+
+		if ( ( Writen(c->sockfd, buf, slen) ) < 0 )
+			die_from_err(c->sockfd, c->rbuf);
+
+		if ( ( Readn(c->sockfd, buf, 1) ) <= 0 )
+			die_from_err(c->sockfd, c->rbuf);
+
+		switch ( buf[0] ) {
+
+			case '+': // [O][K] + tokens + [\r][\n]
+
+				if ( ( read_line(c->sockfd, buf, sizeof(buf)) ) < 2 || strncmp(buf, "OK", 2) != 0 ) {
+					err_msg("ERROR: wrong data format received from server.");
+					die_from_err(c->sockfd, c->rbuf);
+				}
+				c->features = proto_parse_feats(buf+2) & feats;
+				return;
+
+			case '-': // plain protocol server, connection closed: reconnect
+
+				Readn(c->sockfd, buf, 5); // [E][R][R][\r][\n]
+				close(c->sockfd);
+				free(c->rbuf);
+				conn_open(c, c->host, c->serv);
+				return;
+
+			case '>': // busy server, connection closed: connect to the peer [host] [port] [\r][\n]
+
+				if ( !(feats & FEAT_REDIR) || ( read_line(c->sockfd, buf, sizeof(buf)) ) < 3 ||
+					 ( port = strrchr(buf, ' ') ) == NULL || ( port == buf ) || ( port[1] == '\0' ) ||
+					 ( port - buf >= (int) sizeof(c->rhost) ) || ( strlen(port+1) >= sizeof(c->rserv) ) ) {
+					err_msg("ERROR: wrong data format received from server.");
+					die_from_err(c->sockfd, c->rbuf);
+				}
+				*port = '\0';
+				printf("Redirected by %s %s to %s %s.\n", c->host, c->serv, buf, port+1);
+				strcpy(c->rhost, buf);
+				strcpy(c->rserv, port+1);
+
+				close(c->sockfd);
+				free(c->rbuf);
+				conn_open(c, c->rhost, c->rserv);
+				break;
+
+			default:
+				err_msg("ERROR: wrong data format received from server.");
+				die_from_err(c->sockfd, c->rbuf);
+				break;
+		}
+	}
+}
+
+
+void
+conn_set_prio(struct conn *c, int prio)
+{
+	char buf[16];
+	int  slen = 0;
+
+	if ( !(c->features & FEAT_PRIO) ) {
+		err_msg("WARNING: server does not support PRIO, requests sent without priority.");
+		return;
+	}
+
+	slen = snprintf(buf, sizeof(buf), "PRIO %d\r\n", prio);
+	if ( ( Writen(c->sockfd, buf, slen) ) < 0 )
+		die_from_err(c->sockfd, c->rbuf);
+}
+
+
+void
+conn_start(struct conn *c, const struct conn_cfg *cfg)
+{
+	conn_open(c, cfg->host, cfg->serv);
+
+	/* NOTE: plain servers make us reconnect, no features (-P) skips negotiation */
+	conn_negotiate(c, cfg->feats);
+	if ( ( cfg->prio >= 0 ) && ( cfg->feats != 0 ) )
+		conn_set_prio(c, cfg->prio);
+}
+
+
+void
+conn_close(struct conn *c)
+{
+	char buf[7];
+	int  slen = 0;
+
+	/* send "QUIT" message to server */
+	if ( ( slen = snprintf(buf, 7, "QUIT\r\n") ) < 0 )
+		err_msg("ERROR: snprintf error."); // shouldn't really happen
+	else if ( ( Writen(c->sockfd, buf, slen) ) < 0 )
+			die_from_err(c->sockfd, c->rbuf);
+
+	close(c->sockfd);
+	free(c->rbuf);
+	c->rbuf = NULL;
+}
+
+
+void
+conn_abort(struct conn *c)
+{
+	if ( c->xfer.close != NULL )
+		c->xfer.close(c->xfer.files, c->xfer.nfiles);
+
+	conn_xfer_end(c);
+}
+
+
+void
+conn_xfer_end(struct conn *c)
+{
+	int i = 0;
+
+	for ( i = 0; i < XFER_BUFS; i++ )
+		free(c->xfer.bufs[i]);
+
+	memset(&(c->xfer), 0, sizeof(struct conn_xfer));
+}
+
+
+int
+conn_request(struct conn *c, const char *filename, char *buf, int buflen, struct creq *req)
+{
+	struct proto_info info = { 0, 0, PROTO_NS_ANY }; // local copy
+	struct proto_info rinfo; // resume: expected size and timestamp
+	struct stat sfile;
+	uint64_t offset = 0;
+	char ts[32]; // "<seconds>[.<nanoseconds>]"
+	int  local = 0;
+	int  n = 0;
+
+	req->type    = REQ_GET;
+	req->block   = 0;
+	req->nblocks = 0;
+
+	local = ( ( stat(filename, &sfile) == 0 ) && S_ISREG(sfile.st_mode) );
+	if ( local ) {
+		/* local copy has the server's timestamp (see output_done()) */
+		info.size  = sfile.st_size;
+		info.ts    = sfile.st_mtim.tv_sec;
+		info.ts_ns = ( c->features & FEAT_X64 ? (uint32_t) sfile.st_mtim.tv_nsec : PROTO_NS_ANY );
+	}
+
+	/* resume interrupted transfers */
+	if ( ( c->features & FEAT_REST ) && ( resume_check(filename, &rinfo, &offset) ) ) {
+		req->type = REQ_REST;
+		info      = rinfo;
+	}
+
+	else if ( local && ( c->features & FEAT_DELTA ) && ( info.size >= DELTA_MIN ) ) {
+		req->block   = delta_block_size(info.size);
+		req->nblocks = info.size / req->block;
+		if ( req->nblocks <= DELTA_BLOCKS_MAX )
+			req->type = REQ_DELTA;
+	}
+
+	if ( ( req->type == REQ_GET ) && local && ( c->features & FEAT_COND ) )
+		req->type = REQ_COND;
+
+	if ( req->type != REQ_GET ) {
+		if ( info.ts_ns == PROTO_NS_ANY )
+			snprintf(ts, sizeof(ts), "%"PRIu64, info.ts);
+		else
+			snprintf(ts, sizeof(ts), "%"PRIu64".%09"PRIu32, info.ts, info.ts_ns);
+	}
+
+	switch ( req->type ) {
+		case REQ_REST:
+			n = snprintf(buf, buflen, "RGET %"PRIu64" %"PRIu64" %s %s\r\n", offset, info.size, ts, filename);
+			break;
+		case REQ_COND:
+			n = snprintf(buf, buflen, "CGET %"PRIu64" %s %s\r\n", info.size, ts, filename);
+			break;
+		case REQ_DELTA:
+			n = snprintf(buf, buflen, "DGET %"PRIu64" %s %"PRIu32" %s\r\n", info.size, ts, req->block, filename);
+			break;
+		default:
+			n = snprintf(buf, buflen, "GET %s\r\n", filename);
+			break;
+	}
+
+	return ( ( n < 0 || n >= buflen ) ? -1 : n );
+}
+
+
+int
+conn_send_sigs(struct conn *c, const char *filename, const struct creq *req)
+{
+	uint8_t *sigs = NULL;
+	FILE    *fp   = NULL;
+	int     ret   = -1;
+
+	if ( req->nblocks == 0 )
+		return 0;
+
+	if ( ( sigs = malloc(req->nblocks * DELTA_SIG_LEN) ) == NULL ) {
+		err_ret("ERROR: could not allocate signatures buffer");
+		return -1;
+	}
+
+	if ( ( fp = fopen(filename, "rb") ) == NULL )
+		err_ret("ERROR: could not open file \"%s\"", filename);
+	else if ( delta_signatures(fp, req->block, req->nblocks, sigs) < 0 )
+		err_msg("ERROR: could not read file \"%s\".", filename);
+	else if ( Writen(c->sockfd, sigs, req->nblocks * DELTA_SIG_LEN) >= 0 )
+		ret = 0;
+
+	if ( fp != NULL )
+		fclose(fp);
+	free(sigs);
+	return ret;
+}
+
+
+int
+read_line(int sockfd, char *buf, int buflen)
+{
+	int len = 0;
+
+	for ( len = 0; len < buflen - 1; len++ ) {
+		if ( ( Readn(sockfd, buf+len, 1) ) <= 0 )
+			return -1;
+
+		if ( ( len > 0 ) && ( buf[len-1] == '\r' ) && ( buf[len] == '\n' ) ) {
+			buf[len-1] = '\0';
+			return len-1;
+		}
+	}
+
+	return -1; // line too long
+}
+
+
+static int
+get_SO_RCVBUF(int sock)
+{
+	int 	  opt_rbl = SO_RCVBUF_MAX;	// socket receive buffer length
+	socklen_t opt_len = 0;				// option lenght
+
+#ifdef SO_RCVBUF
+	opt_len = sizeof(opt_rbl);
+	if ( ( getsockopt(sock, SOL_SOCKET, SO_RCVBUF, &opt_rbl, &opt_len) ) < 0 ) {
+		err_ret("ERROR: could not get socket options");
+		close(sock);
+		exit(1);
+	}
+#else
+	opt_rbl = SO_RCVBUF_MAX;
+#endif // SO_RCVBUF
+
+	return opt_rbl;
+}
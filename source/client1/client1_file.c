@@ -0,0 +1,818 @@
+/** ---------------------------------------------------------------------------
+ * Client1 - Files management
+ *
+ * @author dcr
+ * ----------------------------------------------------------------------------
+ */
+#define _GNU_SOURCE          // fallocate(), O_DIRECT, splice()
+#define _FILE_OFFSET_BITS 64 // files > 2GB on 32-bit systems
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>     // memcpy()
+#include <errno.h>      // errno
+#include <inttypes.h>   // SCNyXX
+#include <limits.h>     // PATH_MAX
+#include <sys/time.h>   // timeval
+#include <sys/types.h>
+#include <fcntl.h>      // open(), fallocate(), AT_FDCWD
+#include <sys/stat.h>   // stat(), utimensat()
+#include <sys/select.h> // fd_set
+#include <poll.h>
+#include <arpa/inet.h>  // ntohl()
+
+#include "../error.h"
+#include "../mylibsock.h"
+#include "../mydelta.h"
+#include "../mycrc.h"
+#include "client1.h"
+
+#define SEL_TIMEOUT     (5)          // select() timeout
+#define SEL_ATTEMPTS    (2)          // after SEL_ATTEMPTS select() timeouts client closes connection
+#define RESUME_SUFFIX   ".resume"    // resume info file: "<filename>.resume"
+
+static int resume_name(const char *filename, char *buf);
+static void resume_save(const char *filename, const struct proto_info *info);
+static void resume_clear(const char *filename);
+static int recv_file(const int sockfd, struct output *o, FILE *fp, const char *filename, uint64_t size,
+					 const int buf_size, uint32_t *crc);
+static int output_flush(struct output *o);
+static int output_put(struct output *o, const uint8_t *buf, size_t len);
+static void *output_writer(void *arg);
+static int output_join(struct output *o, int drop);
+static int stream_file(const int sockfd, const char *filename, const struct proto_info *info, const int buf_size,
+					   const int crc);
+
+#define STREAM_SPLICE   (1 << 16)    // bytes moved by a splice() at most (a pipe buffer)
+
+static uint64_t direct_min = 0; // files written with O_DIRECT (0 for none)
+static int stream_fd   = -1;    // files streamed here instead (-1 for none)
+static int stream_pipe = 0;     // stream_fd is a pipe: splice() from the socket
+static int crc_bad     = 0;     // a file was discarded: its checksum did not match
+
+
+ssize_t
+download_file(const int sockfd,
+			  const char* filename,
+			  const struct proto_info *info,
+			  const uint64_t offset,
+			  const int buf_size,
+			  const int crc)
+{
+	uint8_t  trailer[PROTO_CRC_LEN];
+	uint32_t sum = 0; // checksum of the file
+	struct output *o = NULL;
+	int  ret = 0;
+
+	if ( (filename == NULL) || (buf_size == 0) || (offset > info->size) ) {
+		err_msg("ERROR: wrong parameters.");
+		return -1;
+	}
+
+	if ( stream_fd >= 0 )
+		return stream_file(sockfd, filename, info, buf_size, crc);
+
+	/* a resumed file is checked whole */
+	if ( ( o = output_open(filename, info, offset, ( crc ? &sum : NULL )) ) == NULL )
+		return -2;
+
+	/* NOTE: an interrupted transfer is kept, to be resumed */
+	if ( ( ret = recv_file(sockfd, o, NULL, filename, info->size - offset, buf_size, ( crc ? &sum : NULL )) ) < 0 ) {
+		output_close(o, info, OUTPUT_KEEP);
+		return ret;
+	}
+
+	if ( crc ) {
+		if ( ( Readn(sockfd, trailer, PROTO_CRC_LEN) ) <= 0 ) {
+			output_close(o, info, OUTPUT_KEEP);
+			return -1;
+		}
+
+		if ( !crc_match(filename, trailer, sum) )
+			return output_close(o, info, OUTPUT_FAIL);
+	}
+
+	return output_close(o, info, OUTPUT_DONE);
+}
+
+
+ssize_t
+download_delta(const int sockfd,
+			   const char* filename,
+			   const struct proto_info *info,
+			   const uint32_t block,
+			   const uint64_t delta_len,
+			   const int buf_size,
+			   const int crc)
+{
+	uint8_t trailer[PROTO_CRC_LEN];
+	FILE *delta = NULL;
+	int  ret    = 0;
+
+	if ( ( delta = tmpfile() ) == NULL ) {
+		err_ret("ERROR: could not create delta file");
+		return -2;
+	}
+
+	if ( ( ret = recv_file(sockfd, NULL, delta, filename, delta_len, buf_size, NULL) ) > 0 &&
+		 crc && ( Readn(sockfd, trailer, PROTO_CRC_LEN) ) <= 0 )
+		ret = -1;
+
+	if ( ret > 0 )
+		ret = patch_file(filename, delta, info, block, ( crc ? trailer : NULL ));
+
+	fclose(delta);
+	return ret;
+}
+
+
+int
+patch_file(const char* filename,
+		   FILE *delta,
+		   const struct proto_info *info,
+		   const uint32_t block,
+		   const uint8_t *trailer)
+{
+	char part[PATH_MAX];
+	FILE *basis = NULL;
+	FILE *out   = NULL;
+	uint64_t written = 0;
+	uint32_t sum     = 0;
+	int  ret = 0;
+
+	if ( snprintf(part, PATH_MAX, "%s"PART_SUFFIX, filename) >= PATH_MAX ) {
+		err_msg("ERROR: filename too long: \n\"%s\".", filename);
+		return -2;
+	}
+
+	if ( ( basis = fopen(filename, "rb") ) == NULL || ( out = fopen(part, "wb") ) == NULL ) {
+		err_ret("ERROR: could not open file \"%s\"", ( basis == NULL ? filename : part ));
+		if ( basis != NULL )
+			fclose(basis);
+		return -2;
+	}
+
+	rewind(delta);
+	ret = delta_apply(delta, basis, out, block, &written);
+
+	fclose(basis);
+	if ( ( fclose(out) == EOF ) && ( ret == 0 ) )
+		ret = -2;
+
+	if ( ( ret == -1 ) || ( ( ret == 0 ) && ( written != info->size ) ) ) {
+		err_msg("ERROR: wrong delta received for \"%s\".", filename);
+		ret = -1;
+	} else if ( ret == -2 )
+		err_ret("ERROR: cannot write file\"%s\"", part);
+
+	/* a rebuilt file that does not match is dropped, the local copy is kept */
+	if ( ( ret == 0 ) && ( trailer != NULL ) ) {
+		if ( file_crc(part, info->size, &sum) < 0 )
+			ret = -2;
+		else if ( !crc_match(filename, trailer, sum) ) {
+			unlink(part);
+			return 0;
+		}
+	}
+
+	if ( ( ret == 0 ) && ( rename(part, filename) < 0 ) ) {
+		err_ret("ERROR: could not replace file \"%s\"", filename);
+		ret = -2;
+	}
+
+	if ( ret < 0 ) {
+		unlink(part);
+		return ret;
+	}
+
+	output_done(filename, info);
+	return 1;
+}
+
+
+int
+crc_match(const char *filename, const uint8_t *trailer, uint32_t crc)
+{
+	uint32_t v = 0;
+
+	memcpy(&v, trailer, PROTO_CRC_LEN);
+	if ( ntohl(v) == crc )
+		return 1;
+
+	__atomic_store_n(&crc_bad, 1, __ATOMIC_RELAXED); // NOTE: set by any connection thread
+	err_msg("ERROR: checksum mismatch for \"%s\" (%08" PRIx32 " instead of %08" PRIx32 "), file discarded.",
+			filename, crc, ntohl(v));
+	return 0;
+}
+
+
+int
+crc_failed(void)
+{
+	return __atomic_load_n(&crc_bad, __ATOMIC_RELAXED);
+}
+
+
+int
+file_crc(const char *filename, uint64_t len, uint32_t *crc)
+{
+	FILE *fp  = NULL;
+	int   ret = 0;
+
+	if ( ( fp = fopen(filename, "rb") ) == NULL ) {
+		err_ret("ERROR: could not open file \"%s\"", filename);
+		return -1;
+	}
+
+	if ( ( ret = crc32c_file(fp, len, crc) ) < 0 )
+		err_msg("ERROR: cannot read file \"%s\".", filename);
+
+	fclose(fp);
+	return ret;
+}
+
+
+/**
+ * @brief Receives 'size' bytes from socket and writes them on the output 'o'
+ *        or the stream 'fp' (a delta), updating their checksum if 'crc' is
+ *        not NULL
+ *
+ * @return   1 if OK
+ * @return  -1 on error
+ * @return  -2 on file-system error
+ */
+static int
+recv_file(const int sockfd,
+		  struct output *o,
+		  FILE *fp,
+		  const char *filename,
+		  uint64_t size,
+		  const int buf_size,
+		  uint32_t *crc)
+{
+	uint8_t	*buf    = NULL;
+	uint64_t bytesToBeRead = size;
+	int buflen = ( ( bytesToBeRead > ((uint64_t) buf_size) ) ? (uint64_t) buf_size : bytesToBeRead );
+
+	int n      = 0;
+	int rbytes = 0; // read bytes
+
+	int err		 = 0;
+	int sys_err  = 0;
+	int attempts = 0;
+
+	struct timeval tv;
+	fd_set rset;
+
+
+	/* prepare buffer */
+	if ( ( buf = calloc(( buflen > 0 ? buflen : 1 ), sizeof(uint8_t)) ) == NULL ) { // note: if (buflen > SIZE_MAX) malloc returns NULL
+		err_ret("ERROR: could not allocate buffer");
+		return -2;
+	}
+
+	FD_ZERO(&rset);
+	sys_err  = 0;
+	attempts = 0;
+	rbytes   = 0;
+	while ( ( bytesToBeRead > 0 ) && ( attempts < SEL_ATTEMPTS ) ) {
+
+		/* select setup */
+		FD_SET(sockfd, &rset);
+		tv.tv_sec  = SEL_TIMEOUT;
+		tv.tv_usec = 0;
+
+		err = Select(sockfd + 1, &rset, NULL, NULL, &tv);
+		if ( err < 0 )
+			break; // select error, (bytesToBeRead  still > 0, function returns error)
+		if ( err == 0 ) {
+			++attempts;
+			continue; // select timeout, can occur max #SEL_ATTEMPTS times
+		}
+
+		if ( FD_ISSET(sockfd, &rset) ) {
+
+			/* check how much to read */
+			n      = ( ( bytesToBeRead > ((uint64_t) buflen) ) ? (uint64_t) buflen : bytesToBeRead ); // NOTE: buflen is always < INT_MAX
+			rbytes = 0;
+
+			/* read bytes from socket */
+			if ( ( rbytes = Readn(sockfd, buf, n) ) <= 0 )
+				break; // bytesToBeRead will be > 0 and function will return -1
+
+			/* write bytes on file (in batches) or delta */
+			if ( ( o != NULL ) && ( output_write(o, buf, rbytes) < 0 ) ) {
+				sys_err = 1;
+				break;
+			}
+			if ( ( fp != NULL ) && ( fwrite(buf, sizeof(uint8_t), rbytes, fp) ) < (size_t) rbytes ) {
+				err_ret("ERROR: cannot write file\"%s\"", filename);
+				sys_err = 1;
+				break;
+			}
+
+			if ( crc != NULL )
+				*crc = crc32c(*crc, buf, rbytes);
+
+			bytesToBeRead -= rbytes; // update remaining bytes to be transferred
+			attempts       = 0;      // reset attempts
+		}
+	}
+
+	free(buf);
+
+	if ( attempts == SEL_ATTEMPTS )
+		err_msg("ERROR: server is taking too much time to reply.");
+
+	if ( sys_err )
+		return -2;
+
+	if ( bytesToBeRead > 0 )
+		return -1;
+
+	return 1;
+}
+
+
+struct output *
+output_open(const char* filename,
+			const struct proto_info *info,
+			const uint64_t offset,
+			uint32_t *crc)
+{
+	struct output *o = NULL;
+	uint64_t left  = info->size - offset;
+	int      flags = O_WRONLY | O_CREAT | O_CLOEXEC | ( offset > 0 ? 0 : O_TRUNC );
+	int      nbuf  = ( left > OUTPUT_BATCH ? OUTPUT_RING : 1 );
+
+	if ( ( o = calloc(1, sizeof(struct output)) ) == NULL ) {
+		err_ret("ERROR: could not allocate buffer");
+		return NULL;
+	}
+	o->filename = filename;
+	o->fd       = -1;
+
+	if ( snprintf(o->part, PATH_MAX, "%s"PART_SUFFIX, filename) >= PATH_MAX ) {
+		err_msg("ERROR: filename too long: \n\"%s\".", filename);
+		goto fail;
+	}
+
+	/* a resumed file is continued in its part */
+	if ( ( crc != NULL ) && ( offset > 0 ) && ( file_crc(o->part, offset, crc) < 0 ) )
+		goto fail;
+
+	/* NOTE: O_DIRECT from an aligned offset only, and if the file system supports it */
+	o->direct = ( ( direct_min > 0 ) && ( info->size >= direct_min ) && ( offset % OUTPUT_ALIGN == 0 ) );
+	if ( o->direct && ( ( o->fd = open(o->part, flags | O_DIRECT, 0666) ) < 0 ) )
+		o->direct = 0;
+
+	if ( ( o->fd < 0 ) && ( o->fd = open(o->part, flags, 0666) ) < 0 ) {
+		err_ret("ERROR: could not open file \"%s\"", o->part);
+		goto fail;
+	}
+
+	if ( ( offset > 0 ) && ( lseek(o->fd, offset, SEEK_SET) < 0 ) ) {
+		err_ret("ERROR: could not seek file \"%s\"", o->part);
+		goto fail;
+	}
+
+	/* blocks of the whole file at once: not fragmented, no "disk full" halfway */
+	if ( ( left > 0 ) && ( fallocate(o->fd, FALLOC_FL_KEEP_SIZE, offset, left) < 0 ) &&
+		 ( errno != EOPNOTSUPP ) && ( errno != ENOSYS ) ) {
+		err_ret("ERROR: could not allocate file \"%s\"", o->part);
+		goto fail;
+	}
+
+	/* a small file needs no more than its size (whole blocks) */
+	o->cap = ( left < OUTPUT_BATCH ? ( left / OUTPUT_ALIGN + 1 ) * OUTPUT_ALIGN : OUTPUT_BATCH );
+	if ( ( errno = posix_memalign((void **) &(o->buf), OUTPUT_ALIGN, nbuf * o->cap) ) != 0 ) {
+		err_ret("ERROR: could not allocate buffer");
+		o->buf = NULL;
+		goto fail;
+	}
+
+	/* NOTE: the disk is written while the next batches are received, if the thread can be started */
+	if ( nbuf > 1 ) {
+		o->ring = o->buf;
+		pthread_mutex_init(&(o->lock), NULL);
+		pthread_cond_init(&(o->cond), NULL);
+		if ( ( errno = pthread_create(&(o->writer), NULL, output_writer, o) ) != 0 ) {
+			err_ret("WARNING: could not start writer of \"%s\"", o->part);
+			pthread_mutex_destroy(&(o->lock));
+			pthread_cond_destroy(&(o->cond));
+			o->ring = NULL;
+		}
+	}
+
+	/* if the transfer is interrupted, next run can resume it */
+	if ( ( offset == 0 ) && ( info->size >= RESUME_MIN ) )
+		resume_save(filename, info);
+
+	return o;
+
+fail:
+	if ( o->fd >= 0 ) {
+		close(o->fd);
+		if ( offset == 0 )
+			unlink(o->part);
+	}
+	free(o);
+	return NULL;
+}
+
+
+int
+output_write(struct output *o, const uint8_t *buf, size_t len)
+{
+	size_t n = 0;
+
+	for ( ; len > 0; buf += n, len -= n ) {
+		n = ( len < o->cap - o->len ? len : o->cap - o->len );
+		memcpy(o->buf + o->len, buf, n);
+		o->len += n;
+
+		if ( ( o->len == o->cap ) && ( output_flush(o) < 0 ) )
+			return -2;
+	}
+
+	return 0;
+}
+
+
+int
+output_close(struct output *o, const struct proto_info *info, int how)
+{
+	int ret = ( how == OUTPUT_DONE ? 1 : 0 );
+
+	if ( ( how != OUTPUT_FAIL ) && ( output_flush(o) < 0 ) )
+		ret = -2;
+
+	if ( ( o->ring != NULL ) && ( output_join(o, ( how == OUTPUT_FAIL )) < 0 ) && ( how != OUTPUT_FAIL ) )
+		ret = -2;
+
+	if ( ( close(o->fd) < 0 ) && ( how != OUTPUT_FAIL ) && ( ret >= 0 ) ) {
+		err_ret("ERROR: cannot write file \"%s\"", o->part);
+		ret = -2;
+	}
+
+	if ( ( how == OUTPUT_DONE ) && ( ret > 0 ) && ( rename(o->part, o->filename) < 0 ) ) {
+		err_ret("ERROR: could not replace file \"%s\"", o->filename);
+		ret = -2;
+	}
+
+	/* NOTE: a file that could not be completed is not resumed either */
+	if ( ( how == OUTPUT_FAIL ) || ( ( how == OUTPUT_DONE ) && ( ret < 0 ) ) ) {
+		resume_clear(o->filename);
+		unlink(o->part);
+	} else if ( how == OUTPUT_DONE )
+		output_done(o->filename, info);
+
+	free(( o->ring != NULL ? o->ring : o->buf ));
+	free(o);
+	return ret;
+}
+
+
+void
+output_direct(uint64_t min)
+{
+	direct_min = min;
+}
+
+
+void
+output_stream(int fd)
+{
+	struct stat st;
+
+	stream_fd   = fd;
+	stream_pipe = ( ( fd >= 0 ) && ( fstat(fd, &st) == 0 ) && S_ISFIFO(st.st_mode) );
+}
+
+
+void
+output_done(const char* filename, const struct proto_info *info)
+{
+	struct timespec times[2];
+
+	resume_clear(filename);
+
+	times[0].tv_sec  = 0;
+	times[0].tv_nsec = UTIME_OMIT; // access time unchanged
+	times[1].tv_sec  = info->ts;
+	times[1].tv_nsec = ( info->ts_ns == PROTO_NS_ANY ? 0 : info->ts_ns );
+
+	if ( utimensat(AT_FDCWD, filename, times, 0) < 0 )
+		err_ret("WARNING: could not set timestamp of \"%s\"", filename);
+}
+
+
+int
+resume_check(const char *filename,
+			 struct proto_info *info,
+			 uint64_t *offset)
+{
+	char rname[PATH_MAX];
+	char part[PATH_MAX];
+	struct stat sfile;
+	FILE *fp = NULL;
+	int  n   = 0;
+
+	if ( resume_name(filename, rname) < 0 )
+		return 0;
+
+	if ( ( fp = fopen(rname, "r") ) == NULL )
+		return 0; // no partial transfer
+
+	n = fscanf(fp, "%"SCNu64" %"SCNu64" %"SCNu32, &(info->size), &(info->ts), &(info->ts_ns));
+	fclose(fp);
+
+	if ( n == 2 )
+		info->ts_ns = PROTO_NS_ANY; // saved by a client without 64-bit timestamps
+
+	/* NOTE: the bytes received are in the part of the file */
+	if ( ( n < 2 ) || ( snprintf(part, PATH_MAX, "%s"PART_SUFFIX, filename) >= PATH_MAX ) ||
+		 ( stat(part, &sfile) < 0 ) || ( (uint64_t) sfile.st_size >= info->size ) )
+		return 0; // missing or already complete file, request it whole
+
+	*offset = sfile.st_size;
+	return 1;
+}
+
+
+/**
+ * @brief Builds resume info filename
+ *
+ * @return  0 if OK
+ * @return -1 if name is too long
+ */
+static int
+resume_name(const char *filename, char *buf)
+{
+	int n = snprintf(buf, PATH_MAX, "%s"RESUME_SUFFIX, filename);
+
+	return ( ( n < 0 || n >= PATH_MAX ) ? -1 : 0 );
+}
+
+
+/**
+ * @brief Writes the batch filled, or hands it to the writer thread (waiting
+ *        while all the batches are full)
+ *
+ * @return   0 if OK
+ * @return  -2 on file-system error
+ */
+static int
+output_flush(struct output *o)
+{
+	int err = 0;
+
+	if ( o->ring == NULL ) {
+		err = output_put(o, o->buf, o->len);
+		o->len = 0;
+		return err;
+	}
+
+	pthread_mutex_lock(&(o->lock));
+
+	if ( o->len > 0 ) {
+		o->lens[o->head] = o->len;
+		o->head = ( o->head + 1 ) % OUTPUT_RING;
+		++(o->full);
+		pthread_cond_broadcast(&(o->cond));
+	}
+
+	/* the next batch is the oldest one until it is written */
+	while ( o->full == OUTPUT_RING )
+		pthread_cond_wait(&(o->cond), &(o->lock));
+	err = o->err;
+
+	pthread_mutex_unlock(&(o->lock));
+
+	o->buf = o->ring + o->head * o->cap;
+	o->len = 0;
+	return ( err ? -2 : 0 );
+}
+
+
+/**
+ * @brief Writes a batch, whole blocks with O_DIRECT (the last ones of the
+ *        file without it)
+ *
+ * @return   0 if OK
+ * @return  -2 on file-system error
+ */
+static int
+output_put(struct output *o, const uint8_t *buf, size_t len)
+{
+	int flags = 0;
+
+	if ( o->direct && ( len % OUTPUT_ALIGN != 0 ) ) {
+		if ( ( ( flags = fcntl(o->fd, F_GETFL) ) < 0 ) || ( fcntl(o->fd, F_SETFL, flags & ~O_DIRECT) < 0 ) ) {
+			err_ret("ERROR: cannot write file \"%s\"", o->part);
+			return -2;
+		}
+		o->direct = 0;
+	}
+
+	if ( ( len > 0 ) && ( writen(o->fd, buf, len) < 0 ) ) {
+		err_ret("ERROR: cannot write file \"%s\"", o->part);
+		return -2;
+	}
+
+	return 0;
+}
+
+
+/**
+ * @brief Writer thread: writes the batches in the order they were filled,
+ *        until the end of the file (after an error they are discarded)
+ */
+static void *
+output_writer(void *arg)
+{
+	struct output *o = arg;
+	uint8_t *buf = NULL;
+	size_t   len = 0;
+	int      err = 0;
+
+	pthread_mutex_lock(&(o->lock));
+
+	for ( ; ; ) {
+		while ( ( o->full == 0 ) && !o->end )
+			pthread_cond_wait(&(o->cond), &(o->lock));
+		if ( o->full == 0 )
+			break;
+
+		buf = o->ring + ( ( o->head - o->full + OUTPUT_RING ) % OUTPUT_RING ) * o->cap;
+		len = o->lens[( o->head - o->full + OUTPUT_RING ) % OUTPUT_RING];
+		err = o->err;
+
+		/* NOTE: the receiver does not touch a batch until it is written */
+		pthread_mutex_unlock(&(o->lock));
+		if ( !err )
+			err = output_put(o, buf, len);
+		pthread_mutex_lock(&(o->lock));
+
+		if ( err )
+			o->err = 1;
+		--(o->full);
+		pthread_cond_broadcast(&(o->cond));
+	}
+
+	pthread_mutex_unlock(&(o->lock));
+	return NULL;
+}
+
+
+/**
+ * @brief Waits for the writer thread to write the batches left ('drop': to
+ *        discard them) and to end
+ *
+ * @return   0 if OK
+ * @return  -2 on file-system error
+ */
+static int
+output_join(struct output *o, int drop)
+{
+	pthread_mutex_lock(&(o->lock));
+	if ( drop )
+		o->err = 1;
+	o->end = 1;
+	pthread_cond_broadcast(&(o->cond));
+	pthread_mutex_unlock(&(o->lock));
+
+	pthread_join(o->writer, NULL);
+	pthread_mutex_destroy(&(o->lock));
+	pthread_cond_destroy(&(o->cond));
+
+	return ( o->err && !drop ? -2 : 0 );
+}
+
+
+/**
+ * @brief Streams a file to stream_fd after its header line: moved from the
+ *        socket with splice() to a pipe, otherwise (or to compute its
+ *        checksum) read and written
+ *
+ * @return   1 if OK
+ * @return   0 if the checksum does not match (already streamed)
+ * @return  -1 on error
+ * @return  -2 on error writing the stream
+ */
+static int
+stream_file(const int sockfd, const char *filename, const struct proto_info *info, const int buf_size,
+			const int crc)
+{
+	char     hdr[REQ_MAX + 48];
+	uint8_t  trailer[PROTO_CRC_LEN];
+	uint8_t  *buf = NULL;
+	uint64_t left = info->size;
+	uint32_t sum  = 0;
+	struct pollfd pfd;
+	ssize_t  n    = 0;
+
+	n = snprintf(hdr, sizeof(hdr), "%"PRIu64" %"PRIu64" %s\n", info->size, info->ts, filename);
+	if ( writen(stream_fd, hdr, n) < 0 ) {
+		err_ret("ERROR: cannot write output stream");
+		return -2;
+	}
+
+	if ( ( !stream_pipe || crc ) && ( buf = malloc(buf_size) ) == NULL ) {
+		err_ret("ERROR: could not allocate buffer");
+		return -2;
+	}
+
+	pfd.fd     = sockfd;
+	pfd.events = POLLIN;
+
+	for ( ; left > 0; left -= n ) {
+
+		/* as with files, a server that sends nothing for long is given up */
+		if ( ( n = poll(&pfd, 1, SEL_TIMEOUT * SEL_ATTEMPTS * 1000) ) <= 0 ) {
+			if ( ( n < 0 ) && ( errno == EINTR ) ) {
+				n = 0;
+				continue;
+			}
+			if ( n == 0 )
+				err_msg("ERROR: server is taking too much time to reply.");
+			break;
+		}
+
+		if ( buf == NULL ) {
+			n = splice(sockfd, NULL, stream_fd, NULL, ( left < STREAM_SPLICE ? left : STREAM_SPLICE ),
+					   SPLICE_F_MOVE | SPLICE_F_MORE);
+			if ( ( n < 0 ) && ( errno == EINTR ) ) {
+				n = 0;
+				continue;
+			}
+			if ( n <= 0 )
+				break; // connection closed, or the stream (not told apart: both end the client)
+			continue;
+		}
+
+		if ( ( n = Readn(sockfd, buf, ( left < (uint64_t) buf_size ? left : (uint64_t) buf_size )) ) <= 0 )
+			break;
+
+		if ( crc )
+			sum = crc32c(sum, buf, n);
+
+		if ( writen(stream_fd, buf, n) < 0 ) {
+			err_ret("ERROR: cannot write output stream");
+			free(buf);
+			return -2;
+		}
+	}
+
+	free(buf);
+
+	if ( left > 0 )
+		return -1;
+
+	if ( crc && ( Readn(sockfd, trailer, PROTO_CRC_LEN) ) <= 0 )
+		return -1;
+
+	return ( crc && !crc_match(filename, trailer, sum) ? 0 : 1 );
+}
+
+
+/**
+ * @brief Saves size and timestamp of the file being transferred
+ *
+ * NOTE: resuming is best-effort, errors are only reported
+ */
+static void
+resume_save(const char *filename, const struct proto_info *info)
+{
+	char rname[PATH_MAX];
+	FILE *fp = NULL;
+
+	if ( resume_name(filename, rname) < 0 )
+		return;
+
+	if ( ( fp = fopen(rname, "w") ) == NULL ) {
+		err_ret("WARNING: could not save resume info \"%s\"", rname);
+		return;
+	}
+
+	fprintf(fp, "%"PRIu64" %"PRIu64" %"PRIu32"\n", info->size, info->ts, info->ts_ns);
+	if ( fclose(fp) == EOF )
+		err_ret("WARNING: could not save resume info \"%s\"", rname);
+}
+
+
+/**
+ * @brief Removes resume info of a completed transfer
+ */
+static void
+resume_clear(const char *filename)
+{
+	char rname[PATH_MAX];
+
+	if ( resume_name(filename, rname) < 0 )
+		return;
+
+	if ( ( unlink(rname) < 0 ) && ( errno != ENOENT ) )
+		err_ret("WARNING: could not remove resume info \"%s\"", rname);
+}
@@ -0,0 +1,191 @@
+/** ---------------------------------------------------------------------------
+ * Client1 - Growing files (FOLLOW)
+ *
+ * @author dcr
+ * ----------------------------------------------------------------------------
+ */
+#define _FILE_OFFSET_BITS 64 // files > 2GB on 32-bit systems
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>     // ftruncate()
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <inttypes.h>   // PRIu64
+#include <arpa/inet.h>  // ntohl()
+#include <sys/stat.h>   // stat()
+
+#include "../error.h"
+#include "../mylibsock.h"
+#include "../mysignal.h"
+#include "../myproto.h"
+#include "client1.h"
+
+#define STOP_POLL_MS	(200) // SIGINT is checked this often while waiting
+
+static volatile sig_atomic_t stop = 0; // SIGINT: STOP the file being followed
+
+static void handle_SIGINT(int sig);
+static int follow_file(struct conn *c, const char *filename, uint32_t idle, int *stop_sent);
+static int wait_data(struct conn *c, int *stop_sent);
+
+static const char *reasons[] = { "limit reached", "idle", "stopped", "file truncated or removed" };
+
+
+void
+follow_files(struct conn *c, char **files, int nfiles, uint32_t idle)
+{
+	int stop_sent = 0;
+	int i = 0;
+
+	Signal(SIGINT, handle_SIGINT);
+
+	for ( i = 0; ( i < nfiles ) && !stop_sent; i++ ) {
+		if ( follow_file(c, files[i], idle, &stop_sent) < 0 )
+			die_from_err(c->sockfd, c->rbuf);
+	}
+
+	Signal(SIGINT, SIG_DFL);
+}
+
+
+/**
+ * @brief Follows a file: appends its chunks to the local copy (from its
+ *        size) until the end of the reply
+ *
+ * @return  0 if OK (also if the server replied an error about the file)
+ * @return -1 on error
+ */
+static int
+follow_file(struct conn *c, const char *filename, uint32_t idle, int *stop_sent)
+{
+	struct proto_info info;
+	struct stat st;
+	char     req[REQ_MAX];
+	uint8_t  *rbuf   = c->rbuf;
+	uint64_t offset  = 0;
+	uint64_t got     = 0;    // bytes received
+	uint32_t len     = 0;    // chunk length
+	int      hlen    = 4 + proto_info_len(c->features) + proto_off_len(c->features);
+	int      n       = 0;
+	FILE     *fp     = NULL;
+
+	/* the local copy is continued */
+	if ( stat(filename, &st) == 0 )
+		offset = st.st_size;
+
+	n = snprintf(req, sizeof(req), "FGET %"PRIu64" 0 %"PRIu32" %s\r\n", offset, idle, filename);
+	if ( ( n >= (int) sizeof(req) ) || ( Writen(c->sockfd, req, n) ) < 0 )
+		return -1;
+
+	if ( ( wait_data(c, stop_sent) < 0 ) || ( Readn(c->sockfd, rbuf, 1) ) <= 0 )
+		return -1;
+
+	if ( rbuf[0] == '-' ) {
+		if ( ( n = read_srv_err(c) ) < 0 )
+			die_from_srv_err(c, filename, 0);
+		err_msg("ERROR: server returned error for \"%s\": %s", filename, proto_strstatus(n));
+		return 0;
+	}
+
+	if ( ( rbuf[0] != '+' ) || ( Readn(c->sockfd, rbuf, hlen) ) <= 0 ) { // [O][K][\r][\n] + info + offset
+		err_msg("ERROR: wrong data format received from server.");
+		return -1;
+	}
+	proto_get_info(rbuf+4, &info, c->features);
+	proto_get_off(rbuf+4+proto_info_len(c->features), &offset, c->features);
+
+	/* NOTE: a file truncated on the server is received again from its start */
+	if ( ( fp = fopen(filename, ( offset > 0 ? "r+b" : "wb" )) ) == NULL ||
+		 ( ftruncate(fileno(fp), offset) < 0 ) || ( fseeko(fp, offset, SEEK_SET) < 0 ) ) {
+		err_ret("ERROR: could not open file \"%s\"", filename);
+		if ( fp != NULL )
+			fclose(fp);
+		return -1;
+	}
+
+	for ( ; ; ) {
+		if ( ( wait_data(c, stop_sent) < 0 ) || ( Readn(c->sockfd, &len, PROTO_CHUNK_HDR) ) <= 0 )
+			goto conn_err;
+
+		if ( ( len = ntohl(len) ) == 0 )
+			break; // end of reply
+
+		/* chunk, written as soon as received */
+		for ( ; len > 0; len -= n ) {
+			n = ( len < (uint32_t) c->rcvbuflen ? (int) len : c->rcvbuflen );
+			if ( ( Readn(c->sockfd, rbuf, n) ) <= 0 )
+				goto conn_err;
+			if ( fwrite(rbuf, 1, n, fp) < (size_t) n ) {
+				err_ret("ERROR: cannot write file\"%s\"", filename);
+				fclose(fp);
+				return -1;
+			}
+			got += n;
+		}
+
+		if ( fflush(fp) == EOF ) {
+			err_ret("ERROR: cannot write file\"%s\"", filename);
+			fclose(fp);
+			return -1;
+		}
+	}
+
+	fclose(fp);
+
+	if ( ( Readn(c->sockfd, rbuf, 1) ) <= 0 ) // [R]
+		goto conn_err;
+
+	printf("Followed \"%s\": %"PRIu64" bytes received from offset %"PRIu64" (%s).\n", filename, got, offset,
+		   ( rbuf[0] <= PROTO_FOLLOW_GONE ? reasons[rbuf[0]] : "unknown reason" ));
+	return 0;
+
+conn_err:
+	err_msg("ERROR: connection closed following \"%s\".", filename);
+	fclose(fp);
+	return -1;
+}
+
+
+/**
+ * @brief Waits for data from server, sending STOP once if interrupted (SIGINT)
+ *
+ * @return  0 if OK
+ * @return -1 on error
+ */
+static int
+wait_data(struct conn *c, int *stop_sent)
+{
+	struct pollfd pfd;
+	int n = 0;
+
+	pfd.fd     = c->sockfd;
+	pfd.events = POLLIN;
+
+	for ( ; ; ) {
+		if ( stop && !(*stop_sent) ) {
+			if ( ( Writen(c->sockfd, "STOP\r\n", 6) ) < 0 )
+				return -1;
+			*stop_sent = 1;
+		}
+
+		/* NOTE: timeout, SIGINT may come just before poll() */
+		if ( ( n = poll(&pfd, 1, STOP_POLL_MS) ) > 0 )
+			return 0;
+
+		if ( ( n < 0 ) && ( errno != EINTR ) ) {
+			err_ret("ERROR: poll failed");
+			return -1;
+		}
+	}
+}
+
+
+static void
+handle_SIGINT(int sig)
+{
+	(void) sig;
+	stop = 1;
+}
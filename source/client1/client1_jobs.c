@@ -0,0 +1,513 @@
+/** ---------------------------------------------------------------------------
+ * Client1 - Parallel transfers over many connections and servers (-j, -M, -A)
+ *
+ * @author dcr
+ * ----------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <time.h>       // clock_gettime()
+
+#include "../error.h"
+#include "../myproto.h"
+#include "client1.h"
+
+#define JOBS_SPLIT	(2) // a batch takes at most 1 / (JOBS_SPLIT * nconns) of the files left
+
+/* adaptive concurrency (-A): additive increase, multiplicative decrease */
+#define AIMD_INTERVAL_US	(250000) // goodput and latency measured over this time at least
+#define AIMD_GAIN			(1.05) // goodput must grow this much for one more connection and request
+#define AIMD_LAT_RISE		(2)   // latency this many times the lowest measured: back off...
+#define AIMD_LAT_SLACK_US	(5000) // ...if longer by this much at least (not noise)
+#define AIMD_WINDOW_START	(4)   // requests in flight per connection, to begin with
+#define AIMD_WINDOW_MAX		(128)
+
+/* file of a lost connection, to be fetched by another one */
+struct job_retry {
+	char             *name;
+	struct job_retry *next;
+};
+
+/* files shared by the connections */
+struct job_queue {
+	const struct conn_cfg *cfgs;  // servers, the connections are spread over them
+	int             ncfgs;
+	char            **files;
+	int             nfiles;
+	struct manifest *m;       // files read from here instead, NULL for none
+	int             next;     // first file not taken yet
+	int             nconns;
+	int             started;  // connections started
+	int             busy;     // batches being fetched: their files may be given back
+	struct job_retry *retry;  // files given back, taken first
+	struct job_retry *last;
+	struct job_retry *used;   // files given back and taken again (freed at the end)
+	int             running;  // connections open (or being opened)
+	int             limit;    // max connections open now (nconns if not adaptive)
+	int             window;   // adaptive: requests in flight per connection now, 0 for the requested one
+	/* adaptive: measures of the current interval */
+	int             adaptive;
+	uint64_t        since;    // start (us)
+	uint64_t        bytes;    // received
+	uint64_t        lat_sum;  // latency of the batches: time to their first file
+	int             lat_n;
+	uint64_t        lat_min;  // lowest average latency of an interval
+	int             lost;     // connections lost
+	double          rate;     // goodput of the previous interval (bytes/s)
+	pthread_mutex_t lock;
+	pthread_cond_t  cond;     // a batch done or given back, a connection closed or allowed
+};
+
+/* batch of a connection */
+struct job_batch {
+	struct conn     conn;     // the connection (kept here, see conn_abort())
+	char            **files;
+	char            *done;    // files received (or not modified)
+	int             n;        // 0 if none is held
+	char            **own;    // manifest or files given back: files of the batch
+	char            *names;   // manifest: their names
+	uint64_t        t0;       // requested (us)
+	uint64_t        first;    // first file received (us), 0 if none yet
+	uint64_t        bytes;    // received
+	int             open;     // the connection is counted in running
+};
+
+static __thread struct job_batch *cur = NULL; // batch of the connection of this thread
+
+static void *job_worker(void *arg);
+static int job_take(struct job_queue *q, struct conn *c, int window, int *w, char **own, char *names,
+					char ***batch);
+static void job_end(struct job_queue *q, struct job_batch *b, const struct conn_cfg *cfg, int lost);
+static int job_wait(struct job_queue *q, struct job_batch *b);
+static int job_park(struct job_queue *q, struct job_batch *b, int done);
+static int job_left(const struct job_queue *q);
+static void job_aimd(struct job_queue *q, uint64_t now);
+static uint64_t now_us(void);
+
+
+void
+fetch_files_jobs(const struct conn_cfg *cfgs, int ncfgs, char **files, int nfiles, struct manifest *m, int nconns,
+				 int adaptive)
+{
+	struct job_queue q;
+	struct job_retry *r = NULL;
+	int left = 0;
+
+	/* NOTE: no more connections than files, one is opened anyway (as without -j) */
+	if ( ( m == NULL ) && ( nconns > nfiles ) )
+		nconns = ( nfiles > 0 ? nfiles : 1 );
+
+	memset(&q, 0, sizeof(q));
+	q.cfgs   = cfgs;
+	q.ncfgs  = ncfgs;
+	q.files  = files;
+	q.nfiles = nfiles;
+	q.m      = m;
+	q.nconns = nconns;
+	q.limit  = nconns;
+
+	/* NOTE: adaptive, one connection per server to begin with, the others wait to be allowed */
+	if ( adaptive ) {
+		q.adaptive = 1;
+		q.limit    = ( ncfgs < nconns ? ncfgs : nconns );
+		q.window   = ( cfgs[0].window > 0 ? 0 : AIMD_WINDOW_START );
+		q.since    = now_us();
+	}
+	pthread_mutex_init(&(q.lock), NULL);
+	pthread_cond_init(&(q.cond), NULL);
+
+	run_conns(job_worker, &q, nconns);
+
+	/* files left only if every connection was lost */
+	left = ( q.retry != NULL ) || ( q.next < q.nfiles ) || ( ( m != NULL ) && !feof(m->fp) );
+
+	for ( r = q.used; r != NULL; r = q.used ) {
+		q.used = r->next;
+		free(r->name);
+		free(r);
+	}
+	pthread_mutex_destroy(&(q.lock));
+	pthread_cond_destroy(&(q.cond));
+
+	if ( left )
+		err_quit("ERROR: all connections lost, files left not fetched.");
+}
+
+
+void
+job_done(const char *filename, uint64_t bytes)
+{
+	int i = 0;
+
+	if ( cur == NULL )
+		return;
+
+	for ( i = 0; i < cur->n; i++ ) {
+		if ( cur->files[i] == filename ) {
+			if ( cur->done[i] )
+				return; // counted already (MUX: when completed, then when printed)
+			cur->done[i] = 1;
+			break;
+		}
+	}
+
+	if ( cur->first == 0 )
+		cur->first = now_us();
+	cur->bytes += bytes;
+}
+
+
+void
+run_conns(void *(*worker)(void *), void *arg, int nconns)
+{
+	pthread_t *tids = NULL;
+	int n  = 0; // threads started
+	int rc = 0;
+
+	if ( ( tids = calloc(nconns, sizeof(pthread_t)) ) == NULL )
+		err_sys("ERROR: could not allocate threads");
+
+	/* the work is shared by the connections opened, even if some could not be */
+	for ( n = 0; n < nconns - 1; n++ ) {
+		if ( ( rc = pthread_create(&(tids[n]), NULL, worker, arg) ) != 0 ) {
+			err_msg("WARNING: could not start connection %d: %s", n + 2, strerror(rc));
+			break;
+		}
+	}
+
+	worker(arg);
+
+	while ( n > 0 )
+		pthread_join(tids[--n], NULL);
+
+	free(tids);
+}
+
+
+/**
+ * @brief Serves a connection: fetches batches of files from the queue until
+ *        it is empty. If the connection is lost, the files of its batch not
+ *        received yet are given back to the others.
+ */
+static void *
+job_worker(void *arg)
+{
+	struct job_queue *q = arg;
+	const struct conn_cfg *cfg = NULL;
+	struct job_batch *b = NULL;
+	jmp_buf env;
+	char **batch = NULL;
+	int  n = 0;
+	int  w = 0;  // window of the batch
+
+	/* round robin over the servers */
+	pthread_mutex_lock(&(q->lock));
+	cfg = q->cfgs + ( q->started++ % q->ncfgs );
+	pthread_mutex_unlock(&(q->lock));
+
+	if ( ( b = calloc(1, sizeof(struct job_batch)) ) == NULL ||
+		 ( b->done = malloc(MANIFEST_BATCH) ) == NULL ||
+		 ( b->own = calloc(MANIFEST_BATCH, sizeof(char *)) ) == NULL ||
+		 ( ( q->m != NULL ) && ( b->names = malloc(MANIFEST_BATCH * MANIFEST_NAME) ) == NULL ) )
+		err_sys("ERROR: could not allocate files list");
+
+	/* NOTE: only memory is used after the jump, the connection is already closed */
+	if ( setjmp(env) != 0 ) {
+		die_recover(NULL);
+		cur = NULL;
+		conn_abort(&(b->conn)); // files being received kept to be resumed
+		job_end(q, b, cfg, 1);
+		goto end;
+	}
+	die_recover(&env);
+	cur = b;
+
+	/* NOTE: a connection over the limit (-A) is closed, and opened again when allowed */
+	while ( job_wait(q, b) ) {
+
+		conn_start(&(b->conn), cfg);
+
+		/* the faster connections take more batches */
+		do {
+			if ( ( n = job_take(q, &(b->conn), cfg->window, &w, b->own, b->names, &batch) ) == 0 )
+				break;
+
+			b->files = batch;
+			b->n     = n;
+			b->t0    = now_us();
+			b->first = 0;
+			b->bytes = 0;
+			memset(b->done, 0, n);
+
+			fetch_files_any(&(b->conn), batch, n, w);
+
+			job_end(q, b, cfg, 0);
+		} while ( !job_park(q, b, 0) );
+
+		if ( n == 0 )
+			job_park(q, b, 1);
+		conn_close(&(b->conn));
+		if ( n == 0 )
+			break;
+	}
+
+	die_recover(NULL);
+	cur = NULL;
+
+end:
+	free(b->names);
+	free(b->own);
+	free(b->done);
+	free(b);
+	return NULL;
+}
+
+
+/**
+ * @brief Takes the next batch of files: first the ones given back by lost
+ *        connections, then the fewer are left, the smaller it is (from a
+ *        manifest, whose length is unknown, up to a window of files are read
+ *        into 'own' and 'names'). While none is left, waits for the batches
+ *        being fetched, their files may be given back.
+ *
+ * @param window        requested window, 0 for default ('w': the one to be
+ *                      used, adaptive with -A)
+ *
+ * @return  nr. of files taken (in 'batch')
+ * @return  0 if none is left
+ */
+static int
+job_take(struct job_queue *q, struct conn *c, int window, int *w, char **own, char *names, char ***batch)
+{
+	struct job_retry *r = NULL;
+	int max = 0;
+	int n   = 0;
+
+	pthread_mutex_lock(&(q->lock));
+
+	/* a MGET reply is one batch, otherwise a window is kept full */
+	*w  = ( q->window > 0 ? q->window : window );
+	max = ( c->features & FEAT_MGET ? MGET_MAX : conn_window(c, *w) );
+	if ( max > MANIFEST_BATCH )
+		max = MANIFEST_BATCH;
+
+	for ( ; ; ) {
+		if ( q->retry != NULL ) {
+			for ( n = 0; ( n < max ) && ( ( r = q->retry ) != NULL ); n++ ) {
+				q->retry = r->next;
+				r->next  = q->used;
+				q->used  = r;
+				own[n]   = r->name;
+			}
+			*batch = own;
+		} else if ( q->m != NULL ) {
+			n = manifest_read(q->m, own, names, max);
+			*batch = own;
+		} else {
+			n = ( q->nfiles - q->next ) / ( JOBS_SPLIT * q->limit );
+			if ( n > max )
+				n = max;
+			if ( n < 1 )
+				n = 1;
+			if ( n > q->nfiles - q->next )
+				n = q->nfiles - q->next;
+
+			*batch   = q->files + q->next;
+			q->next += n;
+		}
+
+		if ( ( n > 0 ) || ( q->busy == 0 ) )
+			break;
+
+		pthread_cond_wait(&(q->cond), &(q->lock));
+	}
+
+	if ( n > 0 )
+		++(q->busy);
+
+	pthread_mutex_unlock(&(q->lock));
+	return n;
+}
+
+
+/**
+ * @brief Ends the batch of a connection, if any: when the connection is
+ *        lost, the files not received are given back (and the connection is
+ *        not counted as open anymore, if it still was)
+ */
+static void
+job_end(struct job_queue *q, struct job_batch *b, const struct conn_cfg *cfg, int lost)
+{
+	struct job_retry *r = NULL;
+	uint64_t now = 0;
+	int back = 0;
+	int i    = 0;
+
+	pthread_mutex_lock(&(q->lock));
+
+	for ( i = 0; lost && ( i < b->n ); i++ ) {
+		if ( b->done[i] )
+			continue;
+
+		if ( ( r = malloc(sizeof(struct job_retry)) ) == NULL || ( r->name = strdup(b->files[i]) ) == NULL )
+			err_sys("ERROR: could not allocate files list");
+		r->next = NULL;
+		if ( q->retry == NULL )
+			q->retry = r;
+		else
+			q->last->next = r;
+		q->last = r;
+		++back;
+	}
+
+	if ( b->n > 0 )
+		--(q->busy);
+	b->n = 0;
+
+	if ( lost && b->open ) {
+		--(q->running);
+		b->open = 0;
+	}
+
+	if ( q->adaptive ) {
+		q->bytes += b->bytes;
+		if ( b->first > 0 ) {
+			q->lat_sum += b->first - b->t0;
+			++(q->lat_n);
+		}
+		q->lost += lost;
+		if ( ( now = now_us() ) >= q->since + AIMD_INTERVAL_US )
+			job_aimd(q, now);
+	}
+
+	pthread_cond_broadcast(&(q->cond));
+	pthread_mutex_unlock(&(q->lock));
+
+	if ( lost )
+		err_msg("WARNING: connection to %s:%s lost, %d files given to the other connections.",
+				cfg->host, cfg->serv, back);
+}
+
+
+/**
+ * @brief Waits until a connection can be opened: while files are left (or
+ *        may be given back) and the connections open are below the limit
+ *
+ * @return  1 if it can (counted as open, see b->open)
+ * @return  0 if no file is left
+ */
+static int
+job_wait(struct job_queue *q, struct job_batch *b)
+{
+	int ret = 0;
+
+	pthread_mutex_lock(&(q->lock));
+
+	for ( ; ; ) {
+		if ( job_left(q) && ( q->running < q->limit ) ) {
+			++(q->running);
+			b->open = 1;
+			ret = 1;
+			break;
+		}
+		if ( !job_left(q) && ( q->busy == 0 ) )
+			break;
+
+		pthread_cond_wait(&(q->cond), &(q->lock));
+	}
+
+	pthread_mutex_unlock(&(q->lock));
+	return ret;
+}
+
+
+/**
+ * @brief Tells if a connection is to be closed, after its batch: if 'done'
+ *        or over the limit (-A). If so, it is not counted as open anymore.
+ *
+ * @return  1 if to be closed
+ * @return  0 otherwise
+ */
+static int
+job_park(struct job_queue *q, struct job_batch *b, int done)
+{
+	int ret = 0;
+
+	pthread_mutex_lock(&(q->lock));
+
+	if ( done || ( q->running > q->limit ) ) {
+		--(q->running);
+		b->open = 0;
+		pthread_cond_broadcast(&(q->cond));
+		ret = 1;
+	}
+
+	pthread_mutex_unlock(&(q->lock));
+	return ret;
+}
+
+
+/**
+ * @brief Tells if files are left to be taken
+ *
+ * NOTE: to be called holding the lock
+ */
+static int
+job_left(const struct job_queue *q)
+{
+	if ( q->retry != NULL )
+		return 1;
+
+	return ( q->m != NULL ? !feof(q->m->fp) : ( q->next < q->nfiles ) );
+}
+
+
+/**
+ * @brief Adapts the connections allowed and their window to the interval
+ *        ended (AIMD): one more of each if the goodput grew, half of them if
+ *        a connection was lost or the latency rose
+ *
+ * NOTE: to be called holding the lock
+ */
+static void
+job_aimd(struct job_queue *q, uint64_t now)
+{
+	uint64_t lat  = ( q->lat_n > 0 ? q->lat_sum / q->lat_n : 0 );
+	double   rate = (double) q->bytes * 1000000 / ( now - q->since );
+
+	if ( ( lat > 0 ) && ( ( q->lat_min == 0 ) || ( lat < q->lat_min ) ) )
+		q->lat_min = lat;
+
+	if ( ( q->lost > 0 ) || ( ( lat > AIMD_LAT_RISE * q->lat_min ) && ( lat > q->lat_min + AIMD_LAT_SLACK_US ) ) ) {
+		q->limit  = ( q->limit > 1 ? q->limit / 2 : 1 );
+		q->window = ( q->window > 1 ? q->window / 2 : q->window );
+	} else if ( rate > q->rate * AIMD_GAIN ) {
+		if ( q->limit < q->nconns )
+			++(q->limit);
+		if ( ( q->window > 0 ) && ( q->window < AIMD_WINDOW_MAX ) )
+			++(q->window);
+	}
+
+	q->rate    = rate;
+	q->since   = now;
+	q->bytes   = 0;
+	q->lat_sum = 0;
+	q->lat_n   = 0;
+	q->lost    = 0;
+}
+
+
+/**
+ * @brief Monotonic time in microseconds
+ */
+static uint64_t
+now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
@@ -0,0 +1,150 @@
+/** ---------------------------------------------------------------------------
+ * Client1 - Directory manifests (LIST)
+ *
+ * @author dcr
+ * ----------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>     // dup()
+#include <ctype.h>      // isprint()
+#include <time.h>       // strftime()
+#include <inttypes.h>   // PRIu64
+#include <arpa/inet.h>  // ntohl()
+
+#include "../error.h"
+#include "../mylibsock.h"
+#include "../myproto.h"
+#include "client1.h"
+
+static int list_entries(struct conn *c, FILE *in);
+
+
+void
+list_dirs(struct conn *c, char **paths, int npaths)
+{
+	char    req[REQ_MAX];
+	FILE    *in  = NULL;
+	int     len  = 0;
+	int     i    = 0;
+
+	/* NOTE: one LIST at a time, nothing follows a manifest: it can be read buffered */
+	if ( ( in = fdopen(dup(c->sockfd), "r") ) == NULL ) {
+		err_ret("ERROR: could not open socket stream");
+		die_from_err(c->sockfd, c->rbuf);
+	}
+
+	for ( i = 0; i < npaths; i++ ) {
+
+		len = snprintf(req, sizeof(req), "LIST %s\r\n", paths[i]);
+		if ( ( Writen(c->sockfd, req, len) ) < 0 )
+			die_from_err(c->sockfd, c->rbuf);
+
+		if ( ( read_stream_status(c, in, paths[i]) ) && ( list_entries(c, in) < 0 ) ) {
+			err_msg("ERROR: wrong data format received from server.");
+			die_from_err(c->sockfd, c->rbuf);
+		}
+	}
+
+	fclose(in);
+}
+
+
+int
+read_stream_status(struct conn *c, FILE *in, const char *path)
+{
+	uint8_t buf[PROTO_NOK_LEN];
+
+	if ( fread(buf, 1, 1, in) < 1 )
+		goto conn_err;
+
+	/* '-': "-NOK" + status if NERR, "-ERR" otherwise (connection closed) */
+	if ( buf[0] == '-' ) {
+		if ( fread(buf, 1, 5, in) < 5 )
+			goto conn_err;
+
+		if ( !(c->features & FEAT_NERR) || ( memcmp(buf, "NOK\r\n", 5) != 0 ) ) {
+			err_msg("ERROR: server returned error for \"%s\": %.3s", path, buf);
+			die_from_err(c->sockfd, c->rbuf);
+		}
+
+		if ( fread(buf, 1, 1, in) < 1 )
+			goto conn_err;
+		err_msg("ERROR: server returned error for \"%s\": %s", path, proto_strstatus(buf[0]));
+		return 0;
+	}
+
+	if ( ( buf[0] != '+' ) || ( fread(buf, 1, 4, in) < 4 ) || ( memcmp(buf, "OK\r\n", 4) != 0 ) ) {
+		err_msg("ERROR: wrong data format received from server.");
+		die_from_err(c->sockfd, c->rbuf);
+	}
+	return 1;
+
+conn_err:
+	err_msg("ERROR: connection closed waiting the reply for \"%s\".", path);
+	die_from_err(c->sockfd, c->rbuf);
+	return -1;
+}
+
+
+/**
+ * @brief Reads and prints the entries of a manifest, up to its end:
+ *        "<size> <last modified> <checksum or -> <name>" ('/' after directories)
+ *
+ * @return  0 if OK
+ * @return -1 on error
+ */
+static int
+list_entries(struct conn *c, FILE *in)
+{
+	struct proto_info info;
+	struct tm tm;
+	time_t   ts = 0;
+	uint8_t  entry[PROTO_LIST_ENTRY_MAX];
+	char     name[NAME_MAX+1];
+	char     date[32];
+	char     crc[16];
+	uint32_t v     = 0;
+	int      ilen  = proto_info_len(c->features);
+	int      len   = 0;
+	int      flags = 0;
+	int      i     = 0;
+
+	for ( ; ; ) {
+
+		if ( fread(entry, 1, 1, in) < 1 )
+			return -1;
+		if ( ( len = entry[0] ) == 0 )
+			return 0; // end of manifest
+
+		/* name, flags, file info */
+		if ( fread(entry, 1, len + 1 + ilen, in) < (size_t) (len + 1 + ilen) )
+			return -1;
+
+		for ( i = 0; i < len; i++ ) // names are not trusted on a terminal
+			name[i] = ( isprint(entry[i]) ? entry[i] : '?' );
+		name[len] = '\0';
+
+		flags = entry[len];
+		proto_get_info(entry + len + 1, &info, c->features);
+
+		strcpy(crc, "-");
+		if ( flags & PROTO_LIST_CRC ) {
+			if ( fread(&v, 1, PROTO_CRC_LEN, in) < PROTO_CRC_LEN )
+				return -1;
+			snprintf(crc, sizeof(crc), "%08x", ntohl(v));
+		}
+
+		ts = info.ts;
+		if ( ( flags & PROTO_LIST_TOOBIG ) || ( localtime_r(&ts, &tm) == NULL ) ||
+			 ( strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &tm) == 0 ) )
+			strcpy(date, "-");
+
+		if ( flags & PROTO_LIST_TOOBIG )
+			printf("%12s %19s %8s %s\n", "-", date, crc, name);
+		else
+			printf("%12"PRIu64" %19s %8s %s%s\n", info.size, date, crc, name,
+				   ( flags & PROTO_LIST_DIR ? "/" : "" ));
+	}
+}
@@ -0,0 +1,200 @@
+/** ---------------------------------------------------------------------------
+ * Client1 - Compressed transfers (LZ)
+ *
+ * @author dcr
+ * ----------------------------------------------------------------------------
+ */
+#define _FILE_OFFSET_BITS 64 // files > 2GB on 32-bit systems
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>  // ntohl()
+
+#include "../error.h"
+#include "../mylibsock.h"
+#include "../mylz.h"
+#include "../mycrc.h"
+#include "client1.h"
+
+static int unlz_block(struct unlz *z, struct output *o);
+
+
+int
+reply_compressed(const struct conn *c, const struct creq *req)
+{
+	return ( ( c->features & FEAT_LZ ) && ( ( req->type == REQ_GET ) || ( req->type == REQ_COND ) ) );
+}
+
+
+ssize_t
+download_lz(const int sockfd,
+			const char* filename,
+			const struct proto_info *info,
+			const int crc)
+{
+	struct unlz z;
+	uint8_t trailer[PROTO_CRC_LEN];
+	struct output *o = NULL;
+	int  ret  = 1;
+	int  n    = 0;
+
+	if ( unlz_init(&z, info->size) < 0 )
+		return -2;
+
+	if ( ( o = output_open(filename, info, 0, NULL) ) == NULL ) {
+		unlz_free(&z);
+		return -2;
+	}
+
+	/* read exactly a block header, then its data: the stream ends the reply */
+	while ( ( ret > 0 ) && !z.end ) {
+		if ( ( Readn(sockfd, z.cbuf, unlz_need(&z)) ) <= 0 ) {
+			err_msg("ERROR: connection closed receiving \"%s\".", filename);
+			ret = -1;
+		} else if ( ( n = unlz_feed(&z, o, z.cbuf, unlz_need(&z)) ) < 0 )
+			ret = n;
+	}
+
+	if ( ( ret > 0 ) && ( z.written != info->size ) ) {
+		err_msg("ERROR: wrong data format received from server.");
+		ret = -1;
+	}
+
+	unlz_free(&z);
+
+	if ( ret < 0 ) {
+		output_close(o, info, OUTPUT_KEEP);
+		return ret;
+	}
+
+	if ( crc ) {
+		if ( ( Readn(sockfd, trailer, PROTO_CRC_LEN) ) <= 0 ) {
+			output_close(o, info, OUTPUT_KEEP);
+			return -1;
+		}
+
+		if ( !crc_match(filename, trailer, z.crc) )
+			return output_close(o, info, OUTPUT_FAIL);
+	}
+
+	return output_close(o, info, OUTPUT_DONE);
+}
+
+
+int
+unlz_init(struct unlz *z, uint64_t size)
+{
+	memset(z, 0, sizeof(struct unlz));
+	z->size = size;
+
+	/* NOTE: cbuf is also the receive buffer of download_lz() */
+	if ( ( z->cbuf = malloc(LZ_BLOCK_MAX) ) == NULL || ( z->raw = malloc(LZ_BLOCK_MAX) ) == NULL ) {
+		err_ret("ERROR: could not allocate buffer");
+		free(z->cbuf);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+void
+unlz_free(struct unlz *z)
+{
+	free(z->cbuf);
+	free(z->raw);
+	z->cbuf = NULL;
+	z->raw  = NULL;
+}
+
+
+int
+unlz_need(const struct unlz *z)
+{
+	if ( z->hlen < LZ_HDR_LEN )
+		return LZ_HDR_LEN - z->hlen;
+
+	return z->clen - z->cgot;
+}
+
+
+int
+unlz_feed(struct unlz *z, struct output *o, const uint8_t *buf, int len)
+{
+	uint32_t v = 0;
+	int used = 0; // bytes consumed
+	int n = 0;
+	int ret = 1;
+
+	while ( ( ret > 0 ) && ( used < len ) && !z->end ) {
+
+		n = ( len - used < unlz_need(z) ? len - used : unlz_need(z) );
+
+		/* block header: raw and compressed length */
+		if ( z->hlen < LZ_HDR_LEN ) {
+			memcpy(z->hdr + z->hlen, buf, n);
+			z->hlen += n;
+
+			if ( z->hlen == LZ_HDR_LEN ) {
+				memcpy(&v, z->hdr, 4);
+				z->rawlen = ntohl(v);
+				memcpy(&v, z->hdr+4, 4);
+				z->clen = ntohl(v);
+				z->cgot = 0;
+
+				if ( ( z->rawlen > LZ_BLOCK_MAX ) || ( z->clen > z->rawlen ) ||
+					 ( ( z->clen == 0 ) != ( z->rawlen == 0 ) ) ||
+					 ( z->rawlen > z->size - z->written ) ) {
+					err_msg("ERROR: wrong data format received from server.");
+					return -1;
+				}
+				z->end = ( z->rawlen == 0 );
+			}
+
+		/* block data */
+		} else {
+			if ( buf != z->cbuf + z->cgot ) // NOTE: download_lz() receives in place
+				memcpy(z->cbuf + z->cgot, buf, n);
+			z->cgot += n;
+
+			if ( z->cgot == z->clen )
+				ret = unlz_block(z, o);
+		}
+
+		buf  += n;
+		used += n;
+	}
+
+	return ( ret < 0 ? ret : used );
+}
+
+
+/**
+ * @brief Decompresses a received block and writes it on file
+ *
+ * @return   1 if OK
+ * @return  -1 on error
+ * @return  -2 on file-system error
+ */
+static int
+unlz_block(struct unlz *z, struct output *o)
+{
+	const uint8_t *raw = z->cbuf; // stored block
+
+	if ( z->clen < z->rawlen ) {
+		if ( lz_decompress(z->cbuf, z->clen, z->raw, z->rawlen) != (int) z->rawlen ) {
+			err_msg("ERROR: wrong data format received from server.");
+			return -1;
+		}
+		raw = z->raw;
+	}
+
+	if ( output_write(o, raw, z->rawlen) < 0 )
+		return -2;
+
+	z->crc      = crc32c(z->crc, raw, z->rawlen);
+	z->written += z->rawlen;
+	z->hlen = 0; // next block
+	return 1;
+}
@@ -16,250 +16,588 @@
 #include <sys/types.h>  // getsockopt(), pid_t
 #include <sys/socket.h> // getsockopt()
 #include <limits.h>     // NAME_MAX
+#include <fcntl.h>      // fcntl()
+#include <setjmp.h>
 
 #include "../error.h"
 #include "../mylibsock.h"
 #include "../mylibtcp.h"
+#include "../myproto.h"
+#include "client1.h"
 
 #define BUF_MAX         (NAME_MAX+7) // 255 + 6 chars + '\0'
-#define SO_RCVBUF_MAX   (8120)       // above 8120 gains in performance are negligible
-#define SEL_TIMEOUT     (5)          // select() timeout
-#define SEL_ATTEMPTS    (2)          // after SEL_ATTEMPTS select() timeouts client closes connection
+#define PIPE_MAX        (1024)       // max pipelined requests, keeps requests within socket buffers
+#define MUX_WINDOW      (32)         // default window with MUX (streams served at once by server)
+
+#define USAGE   "ERROR: use: %s [-w <window>] [-m] [-c] [-d] [-z] [-v] [-P] [-l] [-f <idle ms>] [-b] [-p <priority>] [-j <connections>] [-s <stripe MiB>] [-D] [-i <manifest>] [-o <fd>] [-M <mirror_address>:<port>]... [-A <max connections>] <server_IP_address> <server_port> <files>"
 
 /* FUCNTIONS PROTOTYPES */
-void 	die_from_err(int sockfd, uint8_t* buf);
-char*	str_trim(char* str, const size_t slen);
-int 	get_SO_RCVBUF(int sock);
-ssize_t download_file(const int sockfd, const char* filename, \
-			  		  const uint32_t file_size, const int buf_size);
+void	fetch_files(struct conn *c, char **files, int nfiles, int window);
+void	fetch_files_mget(struct conn *c, char **files, int nfiles);
+
+static __thread jmp_buf *die_jump = NULL; // die_from_err() of this thread returns here, NULL to exit
 
 
 int main (int argc, char *argv[])
 {
-	signed int sockfd = 0;       // socket
-	char buf[BUF_MAX];     // 255 + 6 chars + '\0'
+	struct conn conn;
+	struct conn_cfg cfg;
+	struct conn_cfg mirrors[MIRRORS_MAX + 1]; // the server first
+	struct manifest man;
+
+	char **files  = NULL; // filenames to transfer (requests order)
+	int  nfiles   = 0;    // nr. of valid filenames
+	int  window   = 0;    // max nr. of outstanding requests (1 = stop-and-wait)
+	int  use_mget = 0;    // request files in batches (MGET)
+	int  plain    = 0;    // don't negotiate protocol extensions
+	int  list     = 0;    // list directories instead of fetching files (LIST)
+	int  follow   = 0;    // follow growing files (FGET)
+	long idle     = 0;    // FGET: idle timeout (ms)
+	int  bundle   = 0;    // fetch directory trees instead of files (BNDL)
+	int  prio     = -1;   // priority class of the requests (PRIO), -1 for none
+	int  njobs    = 1;    // nr. of connections files are fetched over
+	long stripe   = 0;    // files fetched in ranges of 'stripe' MiB (PGET), 0 for whole
+	int  modes    = 0;    // requests other than GET (-m, -c, -d, -z)
+	char *manifest = NULL; // filenames read from this file ("-": stdin) instead of argv
+	int  ofd      = -1;   // files streamed to this descriptor instead of written on disk, -1 for none
+	int  nmirrors = 0;    // servers with the same files, besides the one given
+	int  adaptive = 0;    // connections and window follow the goodput, up to njobs connections (-A)
+	char *port    = NULL;
+	unsigned int feats = FEAT_REST | FEAT_X64 | FEAT_MUX | FEAT_NERR | FEAT_REDIR; // extensions to negotiate
+	int  opt = 0;
+	int  i   = 0;
+
+
+	/* '+': stop at the first non-option, server address is always argv[optind] */
+	while ( ( opt = getopt(argc, argv, "+w:mcdzvPlf:bp:j:s:Di:o:M:A:") ) != -1 ) {
+		switch ( opt ) {
+			case 'w':
+				window = atoi(optarg);
+				if ( window < 1 || window > PIPE_MAX )
+					err_quit("ERROR: window must be in [1, %d].", PIPE_MAX);
+				break;
+			case 'm':
+				use_mget = 1;
+				++modes;
+				break;
+			case 'c':
+				feats |= FEAT_COND; // local copies are sent only if changed
+				++modes;
+				break;
+			case 'd':
+				feats |= FEAT_DELTA; // local copies are patched
+				++modes;
+				break;
+			case 'z':
+				feats |= FEAT_LZ; // file content compressed
+				++modes;
+				break;
+			case 'v':
+				feats |= FEAT_CRC; // files verified with their checksum
+				break;
+			case 'P':
+				plain = 1;
+				break;
+			case 'l':
+				list = 1;
+				break;
+			case 'f':
+				follow = 1;
+				idle   = atol(optarg);
+				if ( idle < 0 || idle > INT32_MAX )
+					err_quit("ERROR: idle timeout must be in [0, %d] ms.", INT32_MAX);
+				break;
+			case 'b':
+				bundle = 1;
+				break;
+			case 'p':
+				prio = atoi(optarg);
+				if ( prio < PROTO_PRIO_INTERACTIVE || prio > PROTO_PRIO_BULK )
+					err_quit("ERROR: priority must be in [%d (interactive), %d (bulk)].",
+							 PROTO_PRIO_INTERACTIVE, PROTO_PRIO_BULK);
+				break;
+			case 'j':
+				njobs = atoi(optarg);
+				if ( njobs < 1 || njobs > JOBS_MAX )
+					err_quit("ERROR: connections must be in [1, %d].", JOBS_MAX);
+				break;
+			case 'A':
+				adaptive = 1;
+				njobs    = atoi(optarg);
+				if ( njobs < 1 || njobs > JOBS_MAX )
+					err_quit("ERROR: connections must be in [1, %d].", JOBS_MAX);
+				break;
+			case 's':
+				stripe = atol(optarg);
+				if ( stripe < 1 || stripe > STRIPE_MAX )
+					err_quit("ERROR: stripe must be in [1, %d] MiB.", STRIPE_MAX);
+				break;
+			case 'D':
+				output_direct(DIRECT_MIN); // large files not through the page cache
+				break;
+			case 'i':
+				manifest = optarg;
+				break;
+			case 'M':
+				/* NOTE: the port follows the last ':', an IPv6 address has more */
+				if ( nmirrors == MIRRORS_MAX )
+					err_quit("ERROR: at most %d mirrors.", MIRRORS_MAX);
+				if ( ( port = strrchr(optarg, ':') ) == NULL || port == optarg || port[1] == '\0' )
+					err_quit("ERROR: mirror must be <address>:<port>.");
+				*port = '\0';
+				mirrors[++nmirrors].host = optarg;
+				mirrors[nmirrors].serv   = port + 1;
+				break;
+			case 'o':
+				ofd = atoi(optarg);
+				if ( ofd < 0 || fcntl(ofd, F_GETFD) < 0 )
+					err_quit("ERROR: %s is not an open descriptor.", optarg);
+				break;
+			default:
+				err_quit(USAGE, argv[0]);
+		}
+	}
+
+	/* NOTE: with -i the files are only the ones of the manifest */
+	if ( ( argc - optind < 3 ) && ( ( manifest == NULL ) || ( argc - optind != 2 ) ) )
+		err_quit(USAGE, argv[0]);
+	if ( ( manifest != NULL ) && ( argc - optind > 2 ) )
+		err_quit("ERROR: -i cannot be used with files on the command line.");
+	if ( ( manifest != NULL ) && ( list || follow || bundle || ( stripe > 0 ) ) )
+		err_quit("ERROR: -i cannot be used with -l, -f, -b or -s.");
+	if ( ( manifest != NULL ) && ( manifest_open(&man, manifest) < 0 ) )
+		exit(1);
+
+	/* validate filenames once, so requests and replies can be matched by index */
+	if ( ( files = calloc(argc, sizeof(char *)) ) == NULL )
+		err_sys("ERROR: could not allocate files list");
+
+	for ( i = optind + 2; i < argc ; ++i ) {
+		files[nfiles] = str_trim(argv[i], strnlen(argv[i], NAME_MAX));
+		if ( strlen(files[nfiles]) + 6 >= BUF_MAX ) {
+			err_msg("ERROR: filename too long: \n\"%s\".", files[nfiles]);
+			continue; // skip this filename
+		}
+		++nfiles;
+	}
+
+	/* NOTE: plain servers make us reconnect, -P skips negotiation */
+	if ( use_mget )
+		feats = ( feats & ~FEAT_MUX ) | FEAT_MGET; // a MGET reply is a single stream
+	if ( list )
+		feats = ( feats & ~FEAT_MUX ) | FEAT_LIST; // manifests are read one at a time
+	if ( follow )
+		feats = ( feats & ~FEAT_MUX ) | FEAT_FOLLOW; // files are followed one at a time
+	if ( bundle )
+		feats = ( feats & ~FEAT_MUX ) | FEAT_BNDL; // archives are read one at a time
+	if ( stripe > 0 )
+		feats = ( feats & ~FEAT_MUX ) | FEAT_RANGE; // ranges are replied in order
+	if ( prio >= 0 )
+		feats |= FEAT_PRIO;
+
+	/* NOTE: files are streamed whole, one after the other, as they arrive */
+	if ( ofd >= 0 ) {
+		if ( list || follow || bundle || ( stripe > 0 ) || ( njobs > 1 ) || ( nmirrors > 0 ) || adaptive ||
+			 ( feats & ( FEAT_COND | FEAT_DELTA | FEAT_LZ ) ) )
+			err_quit("ERROR: -o cannot be used with -c, -d, -z, -l, -f, -b, -s, -j, -M or -A.");
+		feats &= ~( FEAT_MUX | FEAT_REST );
+
+		/* the messages go to standard error, not in the stream */
+		if ( ofd == STDOUT_FILENO && ( ( ofd = dup(STDOUT_FILENO) ) < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0 ) )
+			err_sys("ERROR: could not redirect messages");
+		output_stream(ofd);
+	}
+
+	cfg.host   = argv[optind];
+	cfg.serv   = argv[optind+1];
+	cfg.feats  = ( plain ? 0 : feats );
+	cfg.prio   = prio;
+	cfg.window = window;
+
+	/* NOTE: a range is written in place, files are always fetched whole */
+	if ( stripe > 0 ) {
+		if ( list || follow || bundle || modes || ( nmirrors > 0 ) || adaptive )
+			err_quit("ERROR: -s cannot be used with -m, -c, -d, -z, -l, -f, -b, -M or -A.");
+		fetch_files_striped(&cfg, files, nfiles, njobs, (uint64_t) stripe << 20);
+		free(files);
+		exit(crc_failed()); // 1 if a file was discarded
+	}
+
+	/* NOTE: each connection gets its own files, -j and -M are for file transfers only */
+	if ( ( njobs > 1 ) || ( nmirrors > 0 ) || adaptive ) {
+		if ( list || follow || bundle )
+			err_quit("ERROR: -j, -M and -A cannot be used with -l, -f or -b.");
+		if ( njobs * ( nmirrors + 1 ) > JOBS_MAX )
+			err_quit("ERROR: at most %d connections at once (-j or -A for each server).", JOBS_MAX);
+
+		mirrors[0] = cfg;
+		for ( i = 1; i <= nmirrors; i++ ) {
+			mirrors[i].feats  = cfg.feats;
+			mirrors[i].prio   = cfg.prio;
+			mirrors[i].window = cfg.window;
+		}
+
+		fetch_files_jobs(mirrors, nmirrors + 1, files, nfiles, ( manifest != NULL ? &man : NULL ),
+						 njobs * ( nmirrors + 1 ), adaptive);
+		if ( manifest != NULL )
+			manifest_close(&man);
+		free(files);
+		exit(crc_failed());
+	}
+
+	conn_start(&conn, &cfg);
 
-	int rcvbuflen = SO_RCVBUF_MAX; // socket receive buffer length
+	if ( list ) {
+		if ( !(conn.features & FEAT_LIST) )
+			err_quit("ERROR: server does not support LIST.");
+		list_dirs(&conn, files, nfiles);
+		conn_close(&conn);
+		free(files);
+		exit(crc_failed());
+	}
+
+	if ( follow ) {
+		if ( !(conn.features & FEAT_FOLLOW) )
+			err_quit("ERROR: server does not support FOLLOW.");
+		follow_files(&conn, files, nfiles, idle);
+		conn_close(&conn);
+		free(files);
+		exit(crc_failed());
+	}
 
-	char          *filename = NULL; // filename to transfer
-	unsigned char *rbuf     = NULL; // receive-buffer (uint8_t)
+	if ( bundle ) {
+		if ( !(conn.features & FEAT_BNDL) )
+			err_quit("ERROR: server does not support BNDL.");
+		bundle_dirs(&conn, files, nfiles);
+		conn_close(&conn);
+		free(files);
+		exit(crc_failed());
+	}
+
+	if ( manifest != NULL ) {
+		fetch_manifest(&conn, &man, window);
+		manifest_close(&man);
+	} else
+		fetch_files_any(&conn, files, nfiles, window);
+
+	conn_close(&conn);
+	free(files);
+	exit(crc_failed());
+}
 
-	uint32_t file_len_h = 0; // file size (host byte-order), NOTE: only files < 2^32 Bytes (~4GB)
-	time_t   file_ts    = 0; // file timestamp, NOTE: might be defined as uint64_t
 
-	int slen = 0;
-	int i    = 0;
+void
+fetch_files_any(struct conn *c, char **files, int nfiles, int window)
+{
+	if ( c->features & FEAT_MGET )
+		fetch_files_mget(c, files, nfiles);
+	else if ( c->features & FEAT_MUX )
+		fetch_files_mux(c, files, nfiles, conn_window(c, window));
+	else
+		fetch_files(c, files, nfiles, conn_window(c, window));
+}
 
 
-	if ( argc < 4 )
-		err_quit("ERROR: use: %s <server_IP_address> <server_port> <files>", \
-				  argv[0]);
+int
+conn_window(const struct conn *c, int window)
+{
+	if ( window > 0 )
+		return window;
 
-	/* create socket and connect to server */
-	/* NOTE: will try to estabilish a connection for no longer than 5s for each
-	 * server address returned by getaddrinfo(). (see mylibtcp.c) */
-	sockfd = tcp_connect(argv[1], argv[2]);
+	return ( c->features & FEAT_MUX ? MUX_WINDOW : 1 );
+}
 
-	/* get socket receive buffer length */
-	rcvbuflen = get_SO_RCVBUF(sockfd);
 
-	/* prepare receive buffer */
-	if ( ( rbuf = calloc(rcvbuflen, sizeof(unsigned char)) ) == NULL ) {
-		err_ret("ERROR: could not allocate receive buffer");
-		die_from_err(sockfd, NULL);
+/**
+ * @brief Requests files with GET, keeping up to 'window' requests in flight
+ *
+ * NOTE: exits on error
+ *
+ * @param c			Connection
+ * @param files		Filenames to request
+ * @param nfiles	Nr. of filenames
+ * @param window	Max nr. of outstanding requests
+ */
+void
+fetch_files(struct conn *c, char **files, int nfiles, int window)
+{
+	char     *reqbuf = NULL; // pipelined requests buffer
+	struct creq *reqs = NULL; // requests sent
+	uint8_t  *rbuf   = c->rbuf;
+	struct proto_info info;  // file size and timestamp (host byte-order)
+	uint64_t offset  = 0;    // offset of first byte received
+	int      hlen    = 4 + proto_info_len(c->features); // [O][K][\r][\n] + file info
+	int      crc     = ( c->features & FEAT_CRC ? 1 : 0 ); // file followed by checksum
+	ssize_t  ret     = 0;
+	int      status  = 0;  // status of a "-NOK" reply
+
+	int nreq   = 0; // nr. of requests sent
+	int nrep   = 0; // nr. of replies received
+	int reqlen = 0; // bytes in reqbuf
+	int slen   = 0;
+
+	/* prepare requests buffer, a whole window is sent with one write */
+	/* NOTE: kept on the connection, freed by conn_abort() if it is lost */
+	if ( ( c->xfer.bufs[0] = reqbuf = malloc(window * REQ_MAX) ) == NULL ||
+		 ( c->xfer.bufs[1] = reqs = calloc(nfiles, sizeof(struct creq)) ) == NULL ) {
+		err_ret("ERROR: could not allocate requests buffer");
+		die_from_err(c->sockfd, rbuf);
 	}
 
 	/**
 	 * start requesting files
 	 */
-	buf[0] = '\0';
-	for ( i = 3; i < argc ; ++i ) {
+	while ( nrep < nfiles ) {
 
-		filename = str_trim(argv[i], strnlen(argv[i], NAME_MAX));
+		/* fill the pipeline: at most 'window' requests are waiting for reply */
+		for ( reqlen = 0; ( nreq < nfiles ) && ( nreq - nrep < window ); ++nreq ) {
 
-		/* prepare request for server */
-		slen = snprintf(buf, BUF_MAX, "GET %s\r\n", filename);
-		if ( slen < 0 || slen >= BUF_MAX ) {
-			err_msg("ERROR: filename too long: \n\"%s\".", filename);
-			continue; // skip this filename
+			if ( ( slen = conn_request(c, files[nreq], reqbuf + reqlen, REQ_MAX, &(reqs[nreq])) ) < 0 )
+				die_from_err(c->sockfd, rbuf); // already validated, shouldn't happen
+			reqlen += slen;
+
+			/* signatures follow DGET request line */
+			if ( reqs[nreq].type == REQ_DELTA ) {
+				if ( ( Writen(c->sockfd, reqbuf, reqlen) ) < 0 ||
+					 ( conn_send_sigs(c, files[nreq], &(reqs[nreq])) ) < 0 )
+					die_from_err(c->sockfd, rbuf);
+				reqlen = 0;
+			}
 		}
 
-		/* send request to server */
-		if ( ( Writen(sockfd, buf, slen) ) < 0 )
-			die_from_err(sockfd, rbuf);
+		/* send requests to server */
+		if ( reqlen > 0 && ( Writen(c->sockfd, reqbuf, reqlen) ) < 0 )
+			die_from_err(c->sockfd, rbuf);
 
-		/* get and check reply */
-		if ( ( Readn(sockfd, rbuf, 1) ) <= 0 )
-			die_from_err(sockfd, rbuf);
+		/* get and check reply, replies come in requests order */
+		if ( ( Readn(c->sockfd, rbuf, 1) ) <= 0 )
+			die_from_err(c->sockfd, rbuf);
 
 		switch ( rbuf[0] ) {
 
 			case '+': // server found the file
 
-				if ( ( Readn(sockfd, rbuf, 12) ) <= 0 )	// [O][K][\r][\n][B]{4}[T]{4}
-					die_from_err(sockfd, rbuf);
+				if ( ( Readn(c->sockfd, rbuf, hlen) ) <= 0 )	// [O][K][\r][\n][file info]
+					die_from_err(c->sockfd, rbuf);
+
+				proto_get_info(rbuf+4, &info, c->features);
+				offset = 0;
+
+				if ( ( reqs[nrep].type == REQ_REST ) || ( reqs[nrep].type == REQ_DELTA ) ) { // [O]{4|8}
+					if ( ( Readn(c->sockfd, rbuf, proto_off_len(c->features)) ) <= 0 )
+						die_from_err(c->sockfd, rbuf);
+					proto_get_off(rbuf, &offset, c->features);
+				}
 
-				file_len_h 	= ntohl(*((uint32_t *) (rbuf+4)));
-				file_ts		= ntohl(*((uint32_t *) (rbuf+8)));
+				if ( reqs[nrep].type == REQ_DELTA ) // offset is the delta length
+					ret = download_delta(c->sockfd, files[nrep], &info, reqs[nrep].block, offset, c->rcvbuflen, crc);
+				else if ( reply_compressed(c, &(reqs[nrep])) )
+					ret = download_lz(c->sockfd, files[nrep], &info, crc);
+				else
+					ret = download_file(c->sockfd, files[nrep], &info, offset, c->rcvbuflen, crc);
 
-				if ( ( download_file(sockfd, filename, file_len_h, rcvbuflen) ) < 0 )
-					die_from_err(sockfd, rbuf);
+				if ( ret < 0 )
+					die_from_err(c->sockfd, rbuf);
 
-				printf("Written %"PRIu32" bytes in file \"%s\".\n", file_len_h, filename);
-				printf("Last modified: %s\n", ctime(&file_ts));
+				if ( ret > 0 ) // otherwise the checksum did not match
+					print_file_info(files[nrep], &info);
+				break;
+
+			case '=': // file not modified (CGET)
+
+				if ( ( Readn(c->sockfd, rbuf, 4) ) <= 0 )	// [O][K][\r][\n]
+					die_from_err(c->sockfd, rbuf);
+
+				print_not_modified(files[nrep]);
 				break;
 
 			case '-': // server side error (file not found, illegal command...)
 
-				if ( ( Readn(sockfd, rbuf, 5) ) <= 0 ) // [E][R][R][\r][\n]
-					die_from_err(sockfd, rbuf);
-				else {
-					rbuf[5] = '\0';
-					err_msg("ERROR: server returned error: %s", rbuf);
-					}
+				if ( ( status = read_srv_err(c) ) < 0 )
+					die_from_srv_err(c, files[nrep], nreq - nrep - 1);
+
+				/* NERR: only this file failed, go on with the others */
+				err_msg("ERROR: server returned error for \"%s\": %s", files[nrep], proto_strstatus(status));
 				break;
 
 			default: // could not understand message from server
 
 				err_msg("ERROR: wrong data format received from server.");
-				die_from_err(sockfd, rbuf);
+				die_from_err(c->sockfd, rbuf);
 				break;
 		}
-	}
 
-	/* send "QUIT" message to server */
-	if ( snprintf(buf, 7, "QUIT\r\n") < 0 )
-		err_msg("ERROR: snprintf error."); // shouldn't really happen
-	else if ( ( Writen(sockfd, buf, slen) ) < 0 )
-			die_from_err(sockfd, rbuf);
+		++nrep;
+	}
 
-	close(sockfd);
-	free(rbuf);
-	exit(0);
+	conn_xfer_end(c); // reqs, reqbuf
 }
 
 
+/**
+ * @brief Requests files in batches of MGET_MAX with MGET
+ *
+ * NOTE: exits on error
+ *
+ * @param c			Connection
+ * @param files		Filenames to request
+ * @param nfiles	Nr. of filenames
+ */
 void
-die_from_err(int sockfd, uint8_t* buf)
+fetch_files_mget(struct conn *c, char **files, int nfiles)
 {
-	err_msg("An error occurred. Closing connection.");
-	close(sockfd);
+	char     *reqbuf   = NULL; // request buffer
+	uint8_t  *manifest = NULL; // manifest buffer
+	uint8_t  *rbuf     = c->rbuf;
+	uint8_t  *p        = NULL;
+	struct proto_info info;
+	uint32_t idx       = 0;
+	ssize_t  ret       = 0;
+	int entry_len = MGET_ENTRY_HDR + proto_info_len(c->features);
+
+	int base   = 0; // index of first file in batch
+	int n      = 0; // nr. of files in batch
+	int reqlen = 0;
+	int i      = 0;
+
+	/* NOTE: kept on the connection, freed by conn_abort() if it is lost */
+	if ( ( c->xfer.bufs[0] = reqbuf = malloc(BUF_MAX + MGET_MAX * BUF_MAX) ) == NULL ||
+		 ( c->xfer.bufs[1] = manifest = malloc(MGET_MAX * entry_len) ) == NULL ) {
+		err_ret("ERROR: could not allocate requests buffer");
+		die_from_err(c->sockfd, rbuf);
+	}
 
-	if (buf != NULL)
-		free(buf);
+	for ( base = 0; base < nfiles; base += n ) {
 
-	exit(-1);
+		n = ( nfiles - base < MGET_MAX ? nfiles - base : MGET_MAX );
+
+		/* prepare request: "MGET n" + one filename per line */
+		reqlen = snprintf(reqbuf, BUF_MAX, "MGET %d\r\n", n);
+		for ( i = 0; i < n; i++ )
+			reqlen += snprintf(reqbuf + reqlen, BUF_MAX, "%s\r\n", files[base+i]);
+
+		if ( ( Writen(c->sockfd, reqbuf, reqlen) ) < 0 )
+			die_from_err(c->sockfd, rbuf);
+
+		/* get and check reply */
+		if ( ( Readn(c->sockfd, rbuf, 1) ) <= 0 )
+			die_from_err(c->sockfd, rbuf);
+
+		if ( rbuf[0] == '-' ) {
+			read_srv_err(c);
+			die_from_srv_err(c, NULL, 0); // whole batch refused
+		}
+
+		if ( rbuf[0] != '+' ||
+			 ( Readn(c->sockfd, rbuf, 8) ) <= 0 ||	// [O][K][\r][\n][N]{4}
+			 ( ntohl(*((uint32_t *) (rbuf+4))) != (uint32_t) n ) ||
+			 ( Readn(c->sockfd, manifest, n * entry_len) ) <= 0 ) {
+			err_msg("ERROR: wrong data format received from server.");
+			die_from_err(c->sockfd, rbuf);
+		}
+
+		/* contents follow in manifest order */
+		for ( i = 0, p = manifest; i < n; i++, p += entry_len ) {
+
+			idx = ntohl(*((uint32_t *) (p)));
+			proto_get_info(p+MGET_ENTRY_HDR, &info, c->features);
+
+			if ( idx >= (uint32_t) n ) {
+				err_msg("ERROR: wrong data format received from server.");
+				die_from_err(c->sockfd, rbuf);
+			}
+
+			if ( *(p+4) != PROTO_ST_OK ) {
+				err_msg("ERROR: server returned error for \"%s\": %s", \
+						files[base+idx], proto_strstatus(*(p+4)));
+				continue;
+			}
+
+			if ( ( ret = download_file(c->sockfd, files[base+idx], &info, 0, c->rcvbuflen,
+									   ( c->features & FEAT_CRC ? 1 : 0 )) ) < 0 )
+				die_from_err(c->sockfd, rbuf);
+
+			if ( ret > 0 ) // otherwise the checksum did not match
+				print_file_info(files[base+idx], &info);
+		}
+	}
+
+	conn_xfer_end(c); // manifest, reqbuf
 }
 
 
-/**
- * @brief Manages file transfer from receiver buffer to file-system file.
- *
- * @param sockfd		Opened socked where to read
- * @param filename		Name of the file to be created
- * @param file_size		Size of the file to be received
- * @param buf_size		Default receiver buffer size
- *
- * @return	 1 if OK
- * @return	-1 on error
- * @return	-2 on file-system error
- */
-ssize_t
-download_file(const int sockfd,
-			  const char* filename,
-			  const uint32_t file_size,
-			  const int buf_size)
+void
+print_file_info(const char *filename, const struct proto_info *info)
 {
-	FILE *fp;
+	time_t file_ts = info->ts;
+	char   ts[32];
 
-	uint8_t	*buf    = NULL;
-	int buflen = ( ( file_size > ((uint32_t) buf_size) ) ? buf_size : file_size );
-	uint32_t bytesToBeRead = file_size;
+	job_done(filename, info->size);
 
-	int n      = 0;
-	int rbytes = 0; // read bytes
+	/* NOTE: one printf, messages of parallel connections are not mixed (-j) */
+	printf("Written %"PRIu64" bytes in file \"%s\".\nLast modified: %s\n", info->size, filename,
+		   ctime_r(&file_ts, ts));
+}
 
-	int err		 = 0;
-	int sys_err  = 0;
-	int attempts = 0;
 
-	struct timeval tv;
-	fd_set rset;
+void
+print_not_modified(const char *filename)
+{
+	job_done(filename, 0);
+	printf("File \"%s\" not modified.\n", filename);
+}
 
 
-	if ( (filename == NULL) || (buf_size == 0) ) {
-		err_msg("ERROR: wrong parameters.");
-		return -1;
-	}
+int
+read_srv_err(struct conn *c)
+{
+	if ( ( Readn(c->sockfd, c->rbuf, 5) ) <= 0 ) // [E][R][R][\r][\n] or [N][O][K][\r][\n]
+		die_from_err(c->sockfd, c->rbuf);
 
-	/* prepare buffer */
-	if ( ( buf = calloc(buflen, sizeof(uint8_t)) ) == NULL ) { // note: if (buflen > SIZE_MAX) malloc returns NULL
-		err_ret("ERROR: could not allocate buffer");
-		return -2;
-	}
-	/* open file to be written */
-	if ( ( fp = fopen(filename, "wb") ) == NULL ) {
-		err_ret("ERROR: could not open file \"%s\"", filename);
-		return -2;
+	if ( ( c->features & FEAT_NERR ) && ( memcmp(c->rbuf, "NOK\r\n", 5) == 0 ) ) {
+		if ( ( Readn(c->sockfd, c->rbuf, 1) ) <= 0 ) // [S]
+			die_from_err(c->sockfd, c->rbuf);
+		return c->rbuf[0];
 	}
 
-	FD_ZERO(&rset);
-	sys_err  = 0;
-	attempts = 0;
-	rbytes   = 0;
-	bytesToBeRead = file_size;
-	while ( ( bytesToBeRead > 0 ) && ( attempts < SEL_ATTEMPTS ) ) {
-
-		/* select setup */
-		FD_SET(sockfd, &rset);
-		tv.tv_sec  = SEL_TIMEOUT;
-		tv.tv_usec = 0;
-
-		err = Select(sockfd + 1, &rset, NULL, NULL, &tv);
-		if ( err < 0 )
-			break; // select error, (bytesToBeRead  still > 0, function returns error)
-		if ( err == 0 ) {
-			++attempts;
-			continue; // select timeout, can occur max #SEL_ATTEMPTS times
-		}
+	return -1;
+}
 
-		if ( FD_ISSET(sockfd, &rset) ) {
 
-			/* check how much to read */
-			n      = ( ( bytesToBeRead > ((uint32_t) buflen) ) ? buflen : bytesToBeRead ); // NOTE: buflen is always < INT_MAX
-			rbytes = 0;
+void
+die_from_srv_err(struct conn *c, const char *filename, int pending)
+{
+	c->rbuf[3] = '\0';
+	if ( filename != NULL )
+		err_msg("ERROR: server returned error for \"%s\": %s", filename, c->rbuf);
+	else
+		err_msg("ERROR: server returned error: %s", c->rbuf);
+	if ( pending > 0 )
+		err_msg("ERROR: %d pending requests dropped.", pending);
+	die_from_err(c->sockfd, c->rbuf);
+}
 
-			/* read bytes from socket */
-			if ( ( rbytes = Readn(sockfd, buf, n) ) <= 0 )
-				break; // bytesToBeRead will be > 0 and function will return -1
 
-			/* write bytes on file */
-			if ( ( fwrite(buf, sizeof(uint8_t), rbytes, fp) ) < 0 ) {
-				err_ret("ERROR: cannot write file\"%s\"", filename);
-				sys_err = 1;
-				break;
-			}
-			if ( ( fflush(fp) ) == EOF ) {
-				err_ret("ERROR: cannot sync file\"%s\"", filename);
-				sys_err = 1;
-				break;
-			}
+void
+die_from_err(int sockfd, uint8_t* buf)
+{
+	err_msg("An error occurred. Closing connection.");
+	close(sockfd);
 
-			bytesToBeRead -= rbytes; // update remaining bytes to be transferred
-			attempts       = 0;      // reset attempts
-		}
-	}
+	if (buf != NULL)
+		free(buf);
 
-	free(buf);
-	fclose(fp);
+	if ( die_jump != NULL )
+		longjmp(*die_jump, 1);
 
-	if ( attempts == SEL_ATTEMPTS )
-		err_msg("ERROR: server is taking too much time to reply.");
+	exit(-1);
+}
 
-	if ( sys_err )
-		return -2;
 
-	return (bytesToBeRead == 0 ? 1 : -1);
+void
+die_recover(jmp_buf *env)
+{
+	die_jump = env;
 }
 
 
@@ -302,23 +640,3 @@ str_trim(char* str, const size_t slen)
 
     return str;
 }
-
-int
-get_SO_RCVBUF(int sock)
-{
-	int 	  opt_rbl = SO_RCVBUF_MAX;	// socket receive buffer length
-	socklen_t opt_len = 0;				// option lenght
-
-#ifdef SO_RCVBUF
-	opt_len = sizeof(opt_rbl);
-	if ( ( getsockopt(sock, SOL_SOCKET, SO_RCVBUF, &opt_rbl, &opt_len) ) < 0 ) {
-		err_ret("ERROR: could not get socket options");
-		close(sock);
-		exit(1);
-	}
-#else
-	opt_rbl = SO_RCVBUF_MAX;
-#endif // SO_RCVBUF
-
-	return opt_rbl;
-}
@@ -0,0 +1,89 @@
+/** ---------------------------------------------------------------------------
+ * Client1 - Filenames read from a manifest or standard input (-i)
+ *
+ * @author dcr
+ * ----------------------------------------------------------------------------
+ */
+#define _GNU_SOURCE          // getline()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>   // PRIu64
+
+#include "../error.h"
+#include "client1.h"
+
+
+int
+manifest_open(struct manifest *m, const char *path)
+{
+	memset(m, 0, sizeof(struct manifest));
+	m->path = path;
+
+	if ( strcmp(path, "-") == 0 )
+		m->fp = stdin;
+	else if ( ( m->fp = fopen(path, "r") ) == NULL ) {
+		err_ret("ERROR: could not open manifest \"%s\"", path);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+int
+manifest_read(struct manifest *m, char **files, char *names, int max)
+{
+	ssize_t len = 0;
+	int     n   = 0;
+
+	while ( ( n < max ) && ( ( len = getline(&(m->line), &(m->cap), m->fp) ) >= 0 ) ) {
+		++(m->lineno);
+
+		/* NOTE: as on the command line, request lines must fit a filename */
+		str_trim(m->line, len);
+		if ( ( len = strlen(m->line) ) == 0 )
+			continue;
+		if ( len >= MANIFEST_NAME ) {
+			err_msg("ERROR: filename too long (manifest line %"PRIu64"): \n\"%s\".", m->lineno, m->line);
+			continue; // skip this filename
+		}
+
+		files[n] = names + n * MANIFEST_NAME;
+		memcpy(files[n++], m->line, len + 1);
+	}
+
+	if ( ( n == 0 ) && ferror(m->fp) )
+		err_ret("ERROR: could not read manifest \"%s\"", m->path);
+
+	return n;
+}
+
+
+void
+manifest_close(struct manifest *m)
+{
+	if ( m->fp != stdin )
+		fclose(m->fp);
+	free(m->line);
+}
+
+
+void
+fetch_manifest(struct conn *c, struct manifest *m, int window)
+{
+	char **files = NULL;
+	char *names  = NULL;
+	int  n = 0;
+
+	if ( ( files = calloc(MANIFEST_BATCH, sizeof(char *)) ) == NULL ||
+		 ( names = malloc(MANIFEST_BATCH * MANIFEST_NAME) ) == NULL )
+		err_sys("ERROR: could not allocate files list");
+
+	while ( ( n = manifest_read(m, files, names, MANIFEST_BATCH) ) > 0 )
+		fetch_files_any(c, files, n, window);
+
+	free(names);
+	free(files);
+}
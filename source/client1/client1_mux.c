@@ -0,0 +1,420 @@
+/** ---------------------------------------------------------------------------
+ * Client1 - Multiplexed transfers (MUX)
+ *
+ * @author dcr
+ * ----------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../error.h"
+#include "../mylibsock.h"
+#include "../myproto.h"
+#include "../mycrc.h"
+#include "client1.h"
+
+#define ERR_LEN     (6) // |-|E|R|R|CR|LF|
+
+/* reply completed, its message is printed in the order of the requests */
+#define MUX_PENDING (0) // not completed yet
+#define MUX_FILE    (1) // file written
+#define MUX_SAME    (2) // file not modified
+#define MUX_ERROR   (3) // server error (-ERR or -NOK, see hdr)
+#define MUX_QUIET   (4) // nothing to print (reported already), or printed
+
+/* reply being received on a stream */
+struct mux_stream {
+	const char        *filename;
+	struct creq       req;                       // request sent
+	uint8_t           hdr[PROTO_REPLY_HDR_MAX];  // reply header
+	int               hlen;                      // reply header bytes received
+	FILE              *fp;                       // delta being received
+	struct output     *out;                      // file being written
+	uint64_t          left;                      // file bytes still to be received
+	struct proto_info info;
+	struct unlz       *z;                        // compressed file content (LZ)
+	uint32_t          crc;                       // checksum of the file received
+	uint8_t           trailer[PROTO_CRC_LEN];    // checksum sent (CRC)
+	int               tlen;                      // checksum bytes received
+	int               done;                      // MUX_*: reply completed, message not printed yet
+};
+
+static int mux_feed(struct conn *c, struct mux_stream *s, const uint8_t *buf, int len);
+static int mux_open(struct conn *c, struct mux_stream *s);
+static int mux_end(struct conn *c, struct mux_stream *s);
+static int mux_hdr_len(struct conn *c, const struct mux_stream *s);
+static void mux_abort(void *files, int nfiles);
+static void mux_print(struct mux_stream *s);
+
+
+void
+fetch_files_mux(struct conn *c, char **files, int nfiles, int window)
+{
+	struct mux_stream *streams = NULL; // one stream per request (stream id - 1)
+	struct mux_stream *s       = NULL;
+	char     *reqbuf = NULL;    // pipelined requests buffer
+	uint8_t  *frame  = NULL;    // frame payload buffer
+	uint8_t  fhdr[MUX_HDR_LEN]; // frame header
+
+	uint32_t id   = 0; // stream id
+	uint32_t base = c->nstreams; // streams of previous requests on the connection
+	int flags  = 0;
+	int flen   = 0; // frame payload length
+	int nreq   = 0; // nr. of requests sent
+	int ndone  = 0; // nr. of replies received
+	int nprint = 0; // nr. of replies whose message was printed (in order)
+	int reqlen = 0; // bytes in reqbuf
+	int slen   = 0;
+
+	/* NOTE: kept on the connection, released by conn_abort() if it is lost */
+	if ( ( c->xfer.bufs[0] = reqbuf = malloc(window * REQ_MAX) ) == NULL ||
+		 ( c->xfer.bufs[1] = frame = malloc(MUX_FRAME_MAX) ) == NULL ||
+		 ( c->xfer.bufs[2] = streams = calloc(nfiles, sizeof(struct mux_stream)) ) == NULL ) {
+		err_ret("ERROR: could not allocate requests buffer");
+		die_from_err(c->sockfd, c->rbuf);
+	}
+	c->xfer.files  = streams;
+	c->xfer.nfiles = nfiles;
+	c->xfer.close  = mux_abort;
+
+	while ( ndone < nfiles ) {
+
+		/* fill the pipeline: at most 'window' requests are waiting for reply */
+		for ( reqlen = 0; ( nreq < nfiles ) && ( nreq - ndone < window ); ++nreq ) {
+
+			streams[nreq].filename = files[nreq];
+
+			if ( ( slen = conn_request(c, files[nreq], reqbuf + reqlen, REQ_MAX, &(streams[nreq].req)) ) < 0 )
+				die_from_err(c->sockfd, c->rbuf); // already validated, shouldn't happen
+			reqlen += slen;
+
+			/* signatures follow DGET request line */
+			if ( streams[nreq].req.type == REQ_DELTA ) {
+				if ( ( Writen(c->sockfd, reqbuf, reqlen) ) < 0 ||
+					 ( conn_send_sigs(c, files[nreq], &(streams[nreq].req)) ) < 0 )
+					die_from_err(c->sockfd, c->rbuf);
+				reqlen = 0;
+			}
+		}
+
+		/* send requests to server */
+		if ( reqlen > 0 && ( Writen(c->sockfd, reqbuf, reqlen) ) < 0 )
+			die_from_err(c->sockfd, c->rbuf);
+
+		/* get next frame, from any stream */
+		if ( ( Readn(c->sockfd, fhdr, MUX_HDR_LEN) ) <= 0 ||
+			 ( proto_get_frame(fhdr, &id, &flags, &flen) ) < 0 ||
+			 ( flen > 0 && ( Readn(c->sockfd, frame, flen) ) <= 0 ) ) {
+			err_msg("ERROR: wrong data format received from server.");
+			die_from_err(c->sockfd, c->rbuf);
+		}
+
+		if ( id == MUX_STREAM_CONN ) { // connection error, server closes it
+			err_msg("ERROR: server returned error: %.*s", ( flen > 4 ? 3 : 0 ), frame+1);
+			if ( nreq - ndone > 0 )
+				err_msg("ERROR: %d pending requests dropped.", nreq - ndone);
+			die_from_err(c->sockfd, c->rbuf);
+		}
+
+		/* stream 'id' is the reply to request 'id - base - 1' (FEAT is stream 0) */
+		if ( ( id <= base ) || ( id - base > (uint32_t) nreq ) || ( streams[id-base-1].done != MUX_PENDING ) ) {
+			err_msg("ERROR: wrong data format received from server.");
+			die_from_err(c->sockfd, c->rbuf);
+		}
+		s = &(streams[id-base-1]);
+
+		if ( ( mux_feed(c, s, frame, flen) ) < 0 )
+			die_from_err(c->sockfd, c->rbuf);
+
+		if ( flags & MUX_FIN ) {
+			if ( ( mux_end(c, s) ) < 0 )
+				die_from_err(c->sockfd, c->rbuf);
+			++ndone;
+
+			/* NOTE: the files are served in turn, their messages keep the order of the command line */
+			while ( ( nprint < nreq ) && ( streams[nprint].done != MUX_PENDING ) )
+				mux_print(&(streams[nprint++]));
+		}
+	}
+
+	c->nstreams += nfiles;
+
+	conn_xfer_end(c); // streams, frame, reqbuf
+}
+
+
+/**
+ * @brief Consumes a frame payload: reply header first, then file content
+ *
+ * @return  0 if OK
+ * @return -1 on error
+ */
+static int
+mux_feed(struct conn *c, struct mux_stream *s, const uint8_t *buf, int len)
+{
+	int hdr_len = 0;
+	int n       = 0;
+
+	/* reply header, its length is known after the first byte */
+	while ( ( len > 0 ) && ( s->hlen < ( hdr_len = mux_hdr_len(c, s) ) ) ) {
+		n = ( len < hdr_len - s->hlen ? len : hdr_len - s->hlen );
+		memcpy(s->hdr + s->hlen, buf, n);
+		s->hlen += n;
+		buf     += n;
+		len     -= n;
+
+		if ( ( s->hlen == mux_hdr_len(c, s) ) && ( s->hdr[0] == '+' ) && ( mux_open(c, s) < 0 ) )
+			return -1;
+	}
+
+	if ( len == 0 )
+		return 0;
+
+	/* file content */
+	if ( ( s->fp == NULL ) && ( s->out == NULL ) ) {
+		err_msg("ERROR: wrong data format received from server.");
+		return -1;
+	}
+
+	if ( s->z != NULL ) {
+		if ( ( n = unlz_feed(s->z, s->out, buf, len) ) < 0 )
+			return -1;
+
+	} else {
+		n = ( (uint64_t) len < s->left ? len : (int) s->left );
+
+		if ( s->fp != NULL ) {
+			if ( ( fwrite(buf, sizeof(uint8_t), n, s->fp) ) < (size_t) n ) {
+				err_ret("ERROR: cannot write file\"%s\"", s->filename);
+				return -1;
+			}
+		} else if ( output_write(s->out, buf, n) < 0 )
+			return -1;
+
+		if ( ( c->features & FEAT_CRC ) && ( s->req.type != REQ_DELTA ) )
+			s->crc = crc32c(s->crc, buf, n);
+		s->left -= n;
+	}
+	buf += n;
+	len -= n;
+
+	/* checksum after the file content */
+	if ( len > 0 ) {
+		if ( !(c->features & FEAT_CRC) || ( len > PROTO_CRC_LEN - s->tlen ) ) {
+			err_msg("ERROR: wrong data format received from server.");
+			return -1;
+		}
+		memcpy(s->trailer + s->tlen, buf, len);
+		s->tlen += len;
+	}
+
+	return 0;
+}
+
+
+/**
+ * @brief Parses a "+OK" reply header and opens the file to be written
+ *
+ * @return  0 if OK
+ * @return -1 on error
+ */
+static int
+mux_open(struct conn *c, struct mux_stream *s)
+{
+	uint64_t offset = 0;
+	int n = 0;
+
+	if ( memcmp(s->hdr, "+OK\r\n", 5) != 0 ) {
+		err_msg("ERROR: wrong data format received from server.");
+		return -1;
+	}
+
+	n = 5 + proto_get_info(s->hdr+5, &(s->info), c->features);
+	if ( ( s->req.type == REQ_REST ) || ( s->req.type == REQ_DELTA ) )
+		proto_get_off(s->hdr+n, &offset, c->features);
+
+	/* delta is kept in a temporary file, the file is rebuilt at the end */
+	if ( s->req.type == REQ_DELTA ) {
+		if ( ( s->fp = tmpfile() ) == NULL ) {
+			err_ret("ERROR: could not create delta file");
+			return -1;
+		}
+		s->left = offset; // delta length
+		return 0;
+	}
+
+	if ( offset > s->info.size ) {
+		err_msg("ERROR: wrong data format received from server.");
+		return -1;
+	}
+
+	/* a resumed file is checked whole */
+	if ( ( s->out = output_open(s->filename, &(s->info), offset, ( c->features & FEAT_CRC ? &(s->crc) : NULL )) ) == NULL )
+		return -1;
+	s->left = s->info.size - offset;
+
+	/* file content is decompressed as it arrives */
+	if ( reply_compressed(c, &(s->req)) ) {
+		if ( ( s->z = malloc(sizeof(struct unlz)) ) == NULL || unlz_init(s->z, s->info.size) < 0 ) {
+			free(s->z);
+			s->z = NULL;
+			err_ret("ERROR: could not allocate buffer");
+			return -1;
+		}
+		s->left = 0; // checked at the end of stream
+	}
+
+	return 0;
+}
+
+
+/**
+ * @brief Closes the files of the streams not completed, the connection was
+ *        lost: the files being written are kept to be resumed (the messages
+ *        of the ones completed are printed)
+ */
+static void
+mux_abort(void *files, int nfiles)
+{
+	struct mux_stream *streams = files;
+	struct mux_stream *s       = NULL;
+
+	for ( s = streams; s < streams + nfiles; s++ ) {
+		mux_print(s);
+		if ( s->z != NULL ) {
+			unlz_free(s->z);
+			free(s->z);
+		}
+		if ( s->fp != NULL )
+			fclose(s->fp);
+		if ( s->out != NULL )
+			output_close(s->out, &(s->info), OUTPUT_KEEP);
+	}
+}
+
+
+/**
+ * @brief Prints the message of a completed stream, once
+ */
+static void
+mux_print(struct mux_stream *s)
+{
+	switch ( s->done ) {
+		case MUX_FILE:
+			print_file_info(s->filename, &(s->info));
+			break;
+		case MUX_SAME:
+			print_not_modified(s->filename);
+			break;
+		case MUX_ERROR:
+			if ( s->hlen == PROTO_NOK_LEN )
+				err_msg("ERROR: server returned error for \"%s\": %s", s->filename,
+						proto_strstatus(s->hdr[PROTO_NOK_LEN-1]));
+			else
+				err_msg("ERROR: server returned error for \"%s\": %.3s", s->filename, s->hdr+1);
+			break;
+		default:
+			return;
+	}
+	s->done = MUX_QUIET;
+}
+
+
+/**
+ * @brief Completes a stream (MUX_FIN received): its file is done (see
+ *        job_done()), its message is printed by mux_print()
+ *
+ * @return  0 if OK (the file was received or the server could not send it)
+ * @return -1 on error
+ */
+static int
+mux_end(struct conn *c, struct mux_stream *s)
+{
+	int n = 0;
+
+	if ( ( s->hlen == 0 ) || ( s->hlen < mux_hdr_len(c, s) ) ) {
+		err_msg("ERROR: wrong data format received from server.");
+		return -1;
+	}
+
+	/* NOTE: "-NOK" only with NERR, its status byte is kept in hdr (see mux_hdr_len()) */
+	if ( s->hdr[0] == '-' ) {
+		s->done = MUX_ERROR;
+		return 0;
+	}
+
+	if ( s->hdr[0] == '=' ) {
+		job_done(s->filename, 0);
+		s->done = MUX_SAME;
+		return 0;
+	}
+
+	if ( ( c->features & FEAT_CRC ) && ( s->tlen < PROTO_CRC_LEN ) ) {
+		err_msg("ERROR: wrong data format received from server.");
+		return -1;
+	}
+
+	if ( s->z != NULL ) {
+		s->crc = s->z->crc;
+		n = ( s->z->end && ( s->z->written == s->info.size ) );
+		unlz_free(s->z);
+		free(s->z);
+		s->z = NULL;
+		if ( !n ) { // stream ended before the file
+			err_msg("ERROR: wrong data format received from server.");
+			return -1;
+		}
+
+	} else if ( s->left > 0 ) {
+		err_msg("ERROR: wrong data format received from server.");
+		return -1;
+	}
+
+	if ( s->req.type == REQ_DELTA ) {
+		n = patch_file(s->filename, s->fp, &(s->info), s->req.block,
+					   ( c->features & FEAT_CRC ? s->trailer : NULL ));
+		fclose(s->fp);
+		s->fp = NULL;
+		if ( n < 0 )
+			return -1;
+
+		s->done = ( n > 0 ? MUX_FILE : MUX_QUIET );
+		if ( n > 0 )
+			job_done(s->filename, s->info.size);
+		return 0;
+	}
+
+	/* a file with a wrong checksum is dropped, the other files go on */
+	n = output_close(s->out, &(s->info),
+					 ( ( c->features & FEAT_CRC ) && !crc_match(s->filename, s->trailer, s->crc) ? OUTPUT_FAIL : OUTPUT_DONE ));
+	s->out = NULL;
+	if ( n < 0 )
+		return -1;
+
+	s->done = ( n > 0 ? MUX_FILE : MUX_QUIET );
+	if ( n > 0 )
+		job_done(s->filename, s->info.size);
+	return 0;
+}
+
+
+/**
+ * @brief Length of the reply header of a stream (1 until the first byte of
+ *        the reply is received, "-ERR" until "-NOK" is told apart)
+ */
+static int
+mux_hdr_len(struct conn *c, const struct mux_stream *s)
+{
+	if ( s->hlen == 0 )
+		return 1;
+
+	if ( s->hdr[0] == '=' )
+		return 5; // |=|O|K|CR|LF|
+
+	if ( s->hdr[0] != '+' )
+		return ( ( s->hlen > 1 ) && ( s->hdr[1] == 'N' ) ? PROTO_NOK_LEN : ERR_LEN );
+
+	return 5 + proto_info_len(c->features) +
+		   ( ( s->req.type == REQ_REST ) || ( s->req.type == REQ_DELTA ) ? proto_off_len(c->features) : 0 );
+}
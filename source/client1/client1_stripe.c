@@ -0,0 +1,415 @@
+/** ---------------------------------------------------------------------------
+ * Client1 - Large files fetched in ranges over many connections (RANGE)
+ *
+ * @author dcr
+ * ----------------------------------------------------------------------------
+ */
+#define _GNU_SOURCE          // fallocate(), O_CLOEXEC
+#define _FILE_OFFSET_BITS 64 // files > 2GB on 32-bit systems
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>     // pwrite(), ftruncate()
+#include <errno.h>
+#include <fcntl.h>      // open(), fallocate()
+#include <limits.h>     // PATH_MAX
+#include <inttypes.h>   // PRIu64
+#include <pthread.h>
+
+#include "../error.h"
+#include "../mylibsock.h"
+#include "../myproto.h"
+#include "../mycrc.h"
+#include "client1.h"
+
+#define STRIPE_DEPTH	(2) // ranges requested on a connection: the next one is asked before a reply
+
+/* file fetched in ranges */
+struct stripe_file {
+	const char        *filename;
+	char              part[PATH_MAX]; // written here, renamed when complete
+	int               fd;        // part, -1 until the first range is received
+	struct proto_info info;      // as in the reply to the first range
+	int               known;     // info known, the other ranges can be requested
+	uint64_t          next;      // offset of the next range to be requested
+	int               pending;   // ranges requested and not written yet
+	int               failed;    // discarded when its pending ranges are received
+	int               done;
+};
+
+/* files shared by the connections */
+struct stripe_queue {
+	const struct conn_cfg *cfg;
+	struct stripe_file *files;
+	int                nfiles;
+	int                first;    // files before it have no range left to be requested
+	int                next;     // next file whose first range is to be requested
+	int                probing;  // first ranges requested, not received yet
+	uint64_t           stripe;   // range length
+	pthread_mutex_t    lock;
+	pthread_cond_t     known;    // a first range was received: more ranges, or none
+};
+
+/* range requested on a connection */
+struct stripe_req {
+	struct stripe_file *f;
+	uint64_t           offset;
+};
+
+static void *stripe_worker(void *arg);
+static int stripe_take(struct stripe_queue *q, struct stripe_req *r, int wait);
+static int stripe_recv(struct conn *c, struct stripe_queue *q, struct stripe_req *r);
+static int stripe_open(struct stripe_file *f, const struct proto_info *info);
+static void stripe_end(struct stripe_queue *q, struct stripe_req *r, int ok, int changed);
+static void stripe_done(struct stripe_file *f);
+static int pwriten(int fd, const uint8_t *buf, size_t len, uint64_t offset);
+
+
+void
+fetch_files_striped(const struct conn_cfg *cfg, char **files, int nfiles, int nconns, uint64_t stripe)
+{
+	struct stripe_queue q;
+	int i = 0;
+
+	if ( ( q.files = calloc(( nfiles > 0 ? nfiles : 1 ), sizeof(struct stripe_file)) ) == NULL )
+		err_sys("ERROR: could not allocate files list");
+
+	for ( i = 0; i < nfiles; i++ ) {
+		q.files[i].filename = files[i];
+		q.files[i].fd       = -1;
+	}
+
+	q.cfg     = cfg;
+	q.nfiles  = nfiles;
+	q.first   = 0;
+	q.next    = 0;
+	q.probing = 0;
+	q.stripe  = stripe;
+	pthread_mutex_init(&(q.lock), NULL);
+	pthread_cond_init(&(q.known), NULL);
+
+	run_conns(stripe_worker, &q, nconns);
+
+	pthread_cond_destroy(&(q.known));
+	pthread_mutex_destroy(&(q.lock));
+	free(q.files);
+}
+
+
+/**
+ * @brief Serves a connection: requests ranges from the queue, up to
+ *        STRIPE_DEPTH at once, until none is left
+ */
+static void *
+stripe_worker(void *arg)
+{
+	struct stripe_queue *q = arg;
+	struct stripe_req reqs[STRIPE_DEPTH]; // requested, in order
+	struct stripe_req *r = NULL;
+	struct conn c;
+	char req[REQ_MAX];
+	int  head = 0; // oldest request
+	int  n    = 0; // nr. of requests waiting for reply
+	int  len  = 0;
+
+	conn_start(&c, q->cfg);
+	if ( !(c.features & FEAT_RANGE) )
+		err_quit("ERROR: server does not support RANGE.");
+
+	for ( ; ; ) {
+
+		/* NOTE: a connection with no reply to wait for waits for new ranges */
+		while ( ( n < STRIPE_DEPTH ) && stripe_take(q, ( r = &(reqs[(head + n) % STRIPE_DEPTH]) ), ( n == 0 )) ) {
+			len = snprintf(req, sizeof(req), "PGET %"PRIu64" %"PRIu64" %s\r\n", r->offset, q->stripe, r->f->filename);
+			if ( ( len >= (int) sizeof(req) ) || ( Writen(c.sockfd, req, len) ) < 0 )
+				die_from_err(c.sockfd, c.rbuf);
+			++n;
+		}
+
+		if ( n == 0 )
+			break;
+
+		/* replies come in requests order */
+		if ( stripe_recv(&c, q, &(reqs[head])) < 0 )
+			die_from_err(c.sockfd, c.rbuf);
+		head = ( head + 1 ) % STRIPE_DEPTH;
+		--n;
+	}
+
+	conn_close(&c);
+	return NULL;
+}
+
+
+/**
+ * @brief Takes the next range to be requested: of the files started, or the
+ *        first range of the next file
+ *
+ * NOTE: with 'wait', if no range is left while the size of some file is not
+ *       known yet, waits for it
+ *
+ * @return  1 if a range was taken
+ * @return  0 if none is left
+ */
+static int
+stripe_take(struct stripe_queue *q, struct stripe_req *r, int wait)
+{
+	struct stripe_file *f = NULL;
+	int i = 0;
+
+	pthread_mutex_lock(&(q->lock));
+
+	for ( ; ; ) {
+
+		/* skip the files whose ranges were all requested */
+		for ( ; q->first < q->next; q->first++ ) {
+			f = &(q->files[q->first]);
+			if ( !( f->failed || ( f->known && ( f->next >= f->info.size ) ) ) )
+				break;
+		}
+
+		for ( i = q->first; i < q->next; i++ ) {
+			f = &(q->files[i]);
+			if ( f->known && !f->failed && ( f->next < f->info.size ) ) {
+				r->f      = f;
+				r->offset = f->next;
+				f->next  += q->stripe;
+				++(f->pending);
+				pthread_mutex_unlock(&(q->lock));
+				return 1;
+			}
+		}
+
+		if ( q->next < q->nfiles ) {
+			f = &(q->files[q->next++]);
+			r->f      = f;
+			r->offset = 0;
+			f->pending = 1;
+			++(q->probing);
+			pthread_mutex_unlock(&(q->lock));
+			return 1;
+		}
+
+		if ( !wait || ( q->probing == 0 ) )
+			break;
+
+		pthread_cond_wait(&(q->known), &(q->lock));
+	}
+
+	pthread_mutex_unlock(&(q->lock));
+	return 0;
+}
+
+
+/**
+ * @brief Receives the reply to a range and writes it in place
+ *
+ * @return  0 if OK (also if the range could not be written or is wrong: the
+ *          file is discarded)
+ * @return -1 on connection error
+ */
+static int
+stripe_recv(struct conn *c, struct stripe_queue *q, struct stripe_req *r)
+{
+	struct stripe_file *f = r->f;
+	struct proto_info info;
+	uint8_t  trailer[PROTO_CRC_LEN];
+	uint8_t  *rbuf   = c->rbuf;
+	uint64_t offset  = 0;
+	uint64_t left    = 0;
+	uint32_t crc     = 0;
+	int      ilen    = proto_info_len(c->features);
+	int      ok      = 1;
+	int      changed = 0;
+	int      status  = 0;
+	int      n       = 0;
+
+	if ( ( Readn(c->sockfd, rbuf, 1) ) <= 0 )
+		return -1;
+
+	if ( rbuf[0] == '-' ) {
+		if ( ( status = read_srv_err(c) ) < 0 )
+			die_from_srv_err(c, f->filename, 0);
+
+		/* NERR: only this file failed, go on with the others */
+		err_msg("ERROR: server returned error for \"%s\": %s", f->filename, proto_strstatus(status));
+		stripe_end(q, r, 0, 0);
+		return 0;
+	}
+
+	if ( ( rbuf[0] != '+' ) || ( Readn(c->sockfd, rbuf, 4 + ilen + proto_off_len(c->features)) ) <= 0 ) {
+		err_msg("ERROR: wrong data format received from server.");
+		return -1;
+	}
+	proto_get_info(rbuf+4, &info, c->features);
+	proto_get_off(rbuf+4+ilen, &offset, c->features);
+
+	if ( offset != ( r->offset < info.size ? r->offset : info.size ) ) {
+		err_msg("ERROR: wrong data format received from server.");
+		return -1;
+	}
+
+	/* the first range tells the file, the others must be of the same one */
+	if ( r->offset == 0 ) {
+		ok = ( stripe_open(f, &info) == 0 );
+
+	} else if ( ( info.size != f->info.size ) || ( info.ts != f->info.ts ) || ( info.ts_ns != f->info.ts_ns ) ) {
+		changed = 1;
+		ok      = 0;
+	}
+
+	for ( left = ( info.size - offset < q->stripe ? info.size - offset : q->stripe ); left > 0; left -= n ) {
+		n = ( left < (uint64_t) c->rcvbuflen ? (int) left : c->rcvbuflen );
+		if ( ( Readn(c->sockfd, rbuf, n) ) <= 0 )
+			return -1;
+
+		if ( c->features & FEAT_CRC )
+			crc = crc32c(crc, rbuf, n);
+
+		if ( ok && ( pwriten(f->fd, rbuf, n, offset) < 0 ) ) {
+			err_ret("ERROR: cannot write file \"%s\"", f->part);
+			ok = 0;
+		}
+		offset += n;
+	}
+
+	if ( c->features & FEAT_CRC ) {
+		if ( ( Readn(c->sockfd, trailer, PROTO_CRC_LEN) ) <= 0 )
+			return -1;
+		if ( ok )
+			ok = crc_match(f->filename, trailer, crc);
+	}
+
+	stripe_end(q, r, ok, changed);
+	return 0;
+}
+
+
+/**
+ * @brief Opens the part of a file, with the space for all of it
+ *
+ * NOTE: the other ranges are not requested before, no lock is needed
+ *
+ * @return  0 if OK
+ * @return -1 on file-system error
+ */
+static int
+stripe_open(struct stripe_file *f, const struct proto_info *info)
+{
+	f->info = *info;
+
+	if ( snprintf(f->part, sizeof(f->part), "%s"PART_SUFFIX, f->filename) >= (int) sizeof(f->part) ) {
+		err_msg("ERROR: filename too long: \"%s\".", f->filename);
+		return -1;
+	}
+
+	if ( ( f->fd = open(f->part, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666) ) < 0 ) {
+		err_ret("ERROR: could not open file \"%s\"", f->part);
+		return -1;
+	}
+
+	/* NOTE: allocated at once, the ranges written in any order do not fragment it */
+	if ( ( info->size > 0 ) && ( fallocate(f->fd, 0, 0, info->size) < 0 ) &&
+		 ( ( ( errno != EOPNOTSUPP ) && ( errno != ENOSYS ) ) || ( ftruncate(f->fd, info->size) < 0 ) ) ) {
+		err_ret("ERROR: could not allocate file \"%s\"", f->part);
+		close(f->fd);
+		f->fd = -1;
+		unlink(f->part);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+/**
+ * @brief A range was received: the file is completed after its last range
+ *        ('changed': the file changed on the server, reported once)
+ */
+static void
+stripe_end(struct stripe_queue *q, struct stripe_req *r, int ok, int changed)
+{
+	struct stripe_file *f = r->f;
+	int complete = 0;
+
+	pthread_mutex_lock(&(q->lock));
+
+	if ( changed && !(f->failed) )
+		err_msg("ERROR: file \"%s\" changed on server while fetched, file discarded.", f->filename);
+
+	--(f->pending);
+	if ( !ok )
+		f->failed = 1;
+
+	if ( r->offset == 0 ) {
+		f->known = ok;
+		f->next  = q->stripe;
+		--(q->probing);
+		pthread_cond_broadcast(&(q->known));
+	}
+
+	complete = ( !(f->done) && ( f->pending == 0 ) && ( f->failed || ( f->next >= f->info.size ) ) );
+	if ( complete )
+		f->done = 1;
+
+	pthread_mutex_unlock(&(q->lock));
+
+	if ( complete )
+		stripe_done(f);
+}
+
+
+/**
+ * @brief Completes a file: renamed and reported, or removed if failed
+ */
+static void
+stripe_done(struct stripe_file *f)
+{
+	if ( f->fd < 0 )
+		return; // nothing written
+
+	if ( ( close(f->fd) < 0 ) && !(f->failed) ) {
+		err_ret("ERROR: cannot write file \"%s\"", f->part);
+		f->failed = 1;
+	}
+	f->fd = -1;
+
+	if ( !(f->failed) && ( rename(f->part, f->filename) < 0 ) ) {
+		err_ret("ERROR: could not rename \"%s\"", f->part);
+		f->failed = 1;
+	}
+
+	if ( f->failed ) {
+		unlink(f->part);
+		return;
+	}
+
+	output_done(f->filename, &(f->info));
+	print_file_info(f->filename, &(f->info));
+}
+
+
+/**
+ * @brief Writes a buffer at an offset of a file, all of it
+ *
+ * @return  0 if OK
+ * @return -1 on error
+ */
+static int
+pwriten(int fd, const uint8_t *buf, size_t len, uint64_t offset)
+{
+	ssize_t n = 0;
+
+	for ( ; len > 0; buf += n, len -= n, offset += n ) {
+		if ( ( n = pwrite(fd, buf, len, offset) ) < 0 ) {
+			if ( errno == EINTR ) {
+				n = 0;
+				continue;
+			}
+			return -1;
+		}
+	}
+
+	return 0;
+}
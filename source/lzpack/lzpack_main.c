@@ -0,0 +1,63 @@
+/** ---------------------------------------------------------------------------
+ * Lzpack - Precompresses files for the LZ extension ("<filename>.lz")
+ *
+ * @author dcr
+ * ----------------------------------------------------------------------------
+ */
+#define _FILE_OFFSET_BITS 64 // files > 2GB on 32-bit systems
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <limits.h>     // PATH_MAX
+
+#include "../error.h"
+#include "../mylz.h"
+
+#define USAGE   "ERROR: use: %s <files>"
+#define TMP_SUFFIX  ".tmp"  // file being written: "<filename>.lz.tmp"
+
+
+int main (int argc, char *argv[])
+{
+	char zname[PATH_MAX];
+	char tname[PATH_MAX];
+	FILE *in  = NULL;
+	FILE *out = NULL;
+	int  ret  = 0;
+	int  n    = 0;
+	int  i    = 0;
+
+	if ( argc < 2 )
+		err_quit(USAGE, argv[0]);
+
+	for ( i = 1; i < argc; i++ ) {
+
+		if ( ( snprintf(zname, PATH_MAX, "%s"LZ_SUFFIX, argv[i]) >= PATH_MAX ) ||
+			 ( snprintf(tname, PATH_MAX, "%s"LZ_SUFFIX TMP_SUFFIX, argv[i]) >= PATH_MAX ) ) {
+			err_msg("ERROR: filename too long: \n\"%s\".", argv[i]);
+			ret = 1;
+			continue;
+		}
+
+		if ( ( in = fopen(argv[i], "rb") ) == NULL || ( out = fopen(tname, "wb") ) == NULL ) {
+			err_ret("ERROR: could not open file \"%s\"", ( in == NULL ? argv[i] : tname ));
+			if ( in != NULL )
+				fclose(in);
+			ret = 1;
+			continue;
+		}
+
+		/* written aside then renamed: the server never sends a partial file */
+		n = lz_pack(in, out);
+		if ( ( fclose(out) == EOF ) || ( n < 0 ) || ( rename(tname, zname) < 0 ) ) {
+			err_ret("ERROR: could not compress file \"%s\"", argv[i]);
+			unlink(tname);
+			ret = 1;
+		}
+
+		fclose(in);
+	}
+
+	exit(ret);
+}
@@ -0,0 +1,158 @@
+/** ---------------------------------------------------------------------------
+ * Assignment - Cache of data derived from files (per process)
+ *
+ * @author dcr
+ * ----------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mycache.h"
+
+static struct cache_ent *head  = NULL; // most recently used
+static struct cache_ent *tail  = NULL; // least recently used
+static uint64_t          total = 0;    // bytes cached
+
+static void unlink_ent(struct cache_ent *ent);
+static void free_ent(struct cache_ent *ent);
+static void evict(void);
+
+
+struct cache_ent *
+cache_get(int kind, const char *path, const struct proto_info *info)
+{
+	struct cache_ent *ent = NULL;
+
+	for ( ent = head; ent != NULL; ent = ent->next ) {
+		if ( ( ent->kind == kind ) && ( strcmp(ent->path, path) == 0 ) )
+			break;
+	}
+
+	if ( ent == NULL )
+		return NULL;
+
+	/* the file changed */
+	if ( ( ent->info.size != info->size ) || ( ent->info.ts != info->ts ) ||
+		 ( ent->info.ts_ns != info->ts_ns ) ) {
+		unlink_ent(ent);
+		if ( ent->refs == 0 )
+			free_ent(ent); // otherwise freed when released
+		return NULL;
+	}
+
+	/* move to front */
+	unlink_ent(ent);
+	ent->next = head;
+	if ( head != NULL )
+		head->prev = ent;
+	head = ent;
+	if ( tail == NULL )
+		tail = ent;
+	total += ent->len;
+
+	++(ent->refs);
+	return ent;
+}
+
+
+struct cache_ent *
+cache_put(int kind, const char *path, const struct proto_info *info,
+		  uint8_t *data, uint64_t len)
+{
+	struct cache_ent *ent = NULL;
+
+	if ( ( ent = calloc(1, sizeof(struct cache_ent)) ) == NULL )
+		return NULL;
+
+	if ( ( ent->path = strdup(path) ) == NULL ) {
+		free(ent);
+		return NULL;
+	}
+
+	ent->kind = kind;
+	ent->info = *info;
+	ent->data = data;
+	ent->len  = len;
+	ent->refs = 1;
+
+	ent->next = head;
+	if ( head != NULL )
+		head->prev = ent;
+	head = ent;
+	if ( tail == NULL )
+		tail = ent;
+	total += len;
+
+	evict();
+	return ent;
+}
+
+
+void
+cache_release(struct cache_ent *ent)
+{
+	if ( ent == NULL )
+		return;
+
+	--(ent->refs);
+
+	/* no longer cached (stale or evicted while in use) */
+	if ( ( ent->refs == 0 ) && ( ent->prev == NULL ) && ( head != ent ) )
+		free_ent(ent);
+	else
+		evict();
+}
+
+
+/**
+ * @brief Removes an entry from the LRU list
+ */
+static void
+unlink_ent(struct cache_ent *ent)
+{
+	if ( ent->prev != NULL )
+		ent->prev->next = ent->next;
+	else
+		head = ent->next;
+
+	if ( ent->next != NULL )
+		ent->next->prev = ent->prev;
+	else
+		tail = ent->prev;
+
+	ent->prev = NULL;
+	ent->next = NULL;
+	total -= ent->len;
+}
+
+
+/**
+ * @brief Frees an entry
+ */
+static void
+free_ent(struct cache_ent *ent)
+{
+	free(ent->path);
+	free(ent->data);
+	free(ent);
+}
+
+
+/**
+ * @brief Evicts the least recently used entries over CACHE_MAX bytes
+ *
+ * NOTE: entries in use are dropped from the list, they are freed when
+ *       released
+ */
+static void
+evict(void)
+{
+	struct cache_ent *ent = NULL;
+
+	while ( ( total > CACHE_MAX ) && ( ( ent = tail ) != NULL ) && ( ent != head ) ) {
+		unlink_ent(ent);
+		if ( ent->refs == 0 )
+			free_ent(ent);
+	}
+}
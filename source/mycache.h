@@ -0,0 +1,70 @@
+#ifndef _MYCACHE_H
+#define _MYCACHE_H
+
+#include <inttypes.h> // uint64_t
+
+#include "myproto.h"  // struct proto_info
+
+/* DATA DEFINITION */
+
+/* kinds of data derived from a file */
+#define CACHE_LZ		(0)	// compressed stream
+#define CACHE_CRC		(1)	// CRC32C (4 bytes)
+
+#define CACHE_MAX		(64 << 20)	// max bytes cached
+
+/* data derived from a file, valid while the file keeps its size and timestamp */
+struct cache_ent {
+	char              *path;
+	int               kind;       // CACHE_*
+	struct proto_info info;       // file info when the data was derived
+	uint8_t           *data;
+	uint64_t          len;
+	int               refs;       // users of the entry (not evicted while > 0)
+	struct cache_ent  *prev;      // LRU list, most recently used first
+	struct cache_ent  *next;
+};
+
+/* FUNCTIONS */
+
+/**
+ * @brief Looks for the data derived from a file
+ *
+ * NOTE: the entry must be released with cache_release()
+ *
+ * @param kind          kind of data (CACHE_*)
+ * @param path          file name
+ * @param info          current file info
+ *
+ * @return  the entry if found
+ * @return  NULL if not cached (or stale)
+ */
+struct cache_ent *cache_get(int kind, const char *path, const struct proto_info *info);
+
+/**
+ * @brief Caches the data derived from a file, evicting the least recently
+ *        used entries over CACHE_MAX bytes
+ *
+ * NOTE: the cache takes ownership of 'data' (it must be malloc'ed), the
+ *       entry must be released with cache_release()
+ *
+ * @param kind          kind of data (CACHE_*)
+ * @param path          file name
+ * @param info          file info when the data was derived
+ * @param data          data
+ * @param len           data length
+ *
+ * @return  the entry if OK
+ * @return  NULL on system error ('data' is not freed)
+ */
+struct cache_ent *cache_put(int kind, const char *path, const struct proto_info *info,
+                            uint8_t *data, uint64_t len);
+
+/**
+ * @brief Releases an entry got from cache_get() or cache_put()
+ *
+ * @param ent           entry
+ */
+void cache_release(struct cache_ent *ent);
+
+#endif
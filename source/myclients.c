@@ -7,14 +7,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>   // close()
 #include <limits.h>   // NAME_MAX
 #include <sys/select.h> // FD_SETSIZE
 
 #include	"error.h"
 #include    "myclients.h"
+#include    "myfollow.h"
+#include    "mydelta.h"     // DELTA_SIG_LEN
 
 #define BUF_MAX			(NAME_MAX+7) // 255 + 6 chars + '\0'
 
+static void free_req(struct sfiles *req);
+
 int
 add_client(int sockfd,
 		   struct sclient **clients,
@@ -39,10 +44,15 @@ add_client(int sockfd,
 	}
 
 	/* init client */
-	clients[sockfd]->cfp                = NULL;
 	clients[sockfd]->files              = NULL;
-	clients[sockfd]->bytesToBeWrittenCF = 0;
 	clients[sockfd]->sendError 			= 0;
+	clients[sockfd]->features			= 0;
+	clients[sockfd]->nrequests			= 0;
+	clients[sockfd]->last_stream		= 0;
+	clients[sockfd]->peer				= -1;
+	clients[sockfd]->prio				= PROTO_PRIO_NORMAL;
+	clients[sockfd]->nqueued			= 0;
+	clients[sockfd]->qbytes				= 0;
 
 	if ( ready_clients ) {
 		/* add client to available clients */
@@ -67,18 +77,11 @@ rm_client(int sockfd,
 	if ( clients[sockfd] == NULL )
 		return 1;
 
-	if ( (clients[sockfd]->cfp) != NULL ) {
-        if ( ( fclose(clients[sockfd]->cfp) ) != 0 )
-            return -2;
-	}
-
 	if ( (clients[sockfd]->files) != NULL ) {
 		c = clients[sockfd]->files;
 		do {
 			n = c->next_file;
-			if ( (c->filename) != NULL )
-				free(c->filename);
-			free(c);
+			free_req(c);
 			c = n;
 		} while ( c != NULL );
 
@@ -107,10 +110,39 @@ rm_client(int sockfd,
 
 
 
+/* per-client queue limits */
+static unsigned int queue_reqs_max  = QUEUE_REQS_MAX;
+static size_t       queue_bytes_max = QUEUE_BYTES_MAX;
+
+
+void
+set_queue_limits(unsigned int reqs, size_t bytes)
+{
+	if ( reqs > 0 )
+		queue_reqs_max = reqs;
+	if ( bytes > 0 )
+		queue_bytes_max = bytes;
+}
+
+
 int
-add_file_client(char* filename,
-                int file_size,
-                struct sclient *client)
+queue_full(const struct sclient *client)
+{
+	return ( ( client->nqueued >= queue_reqs_max ) || ( client->qbytes >= queue_bytes_max ) );
+}
+
+
+/**
+ * @brief Appends an empty request to the client's files list
+ *
+ * NOTE: 'len' is the memory the request holds besides its node (names,
+ *       data), accounted to the client's queue
+ *
+ * @return  pointer to the new request if OK
+ * @return  NULL on system error
+ */
+static struct sfiles *
+append_req_client(int type, size_t len, struct sclient *client)
 {
     struct sfiles **p = NULL;
 
@@ -119,10 +151,264 @@ add_file_client(char* filename,
 
     *p = calloc (1, sizeof(struct sfiles));
     if ( !(*p) )
-        return -2;
+        return NULL;
 
-    (*p)->filename  = strndup(filename, file_size);
+    (*p)->type      = type;
+    (*p)->stream    = ( client->nrequests > 0 ? client->nrequests - 1 : 0 );
     (*p)->next_file = NULL;
+    (*p)->qbytes    = sizeof(struct sfiles) + len;
+    (*p)->prio      = client->prio;
+
+    ++(client->nqueued);
+    client->qbytes += (*p)->qbytes;
+
+    return *p;
+}
+
+
+/**
+ * @brief Removes the last request of the client's files list
+ */
+static void
+drop_last_req_client(struct sclient *client)
+{
+    struct sfiles **p = NULL;
+
+    if ( client->files == NULL )
+        return;
+
+    for ( p = &(client->files); (*p)->next_file != NULL; p = &((*p)->next_file) );
+
+    --(client->nqueued);
+    client->qbytes -= (*p)->qbytes;
+
+    free(*p);
+    *p = NULL;
+}
+
+
+int
+add_file_client(char* filename,
+                int file_size,
+                struct sclient *client)
+{
+    struct sfiles *p = NULL;
+
+    if ( ( p = append_req_client(SF_FILE, file_size + 1, client) ) == NULL )
+        return -2;
+
+    if ( ( p->filename = strndup(filename, file_size) ) == NULL ) {
+        drop_last_req_client(client);
+        return -2;
+    }
+
+    return 1;
+}
+
+
+int
+add_rest_client(char* filename,
+                int file_size,
+                uint64_t offset,
+                const struct proto_info *info,
+                struct sclient *client)
+{
+    struct sfiles *p = NULL;
+
+    if ( ( p = append_req_client(SF_REST, file_size + 1, client) ) == NULL )
+        return -2;
+
+    if ( ( p->filename = strndup(filename, file_size) ) == NULL ) {
+        drop_last_req_client(client);
+        return -2;
+    }
+    p->offset = offset;
+    p->info   = *info;
+
+    return 1;
+}
+
+
+int
+add_range_client(char* filename,
+                 int file_size,
+                 uint64_t offset,
+                 uint64_t length,
+                 struct sclient *client)
+{
+    struct sfiles *p = NULL;
+
+    if ( ( p = append_req_client(SF_RANGE, file_size + 1, client) ) == NULL )
+        return -2;
+
+    if ( ( p->filename = strndup(filename, file_size) ) == NULL ) {
+        drop_last_req_client(client);
+        return -2;
+    }
+    p->offset = offset;
+    p->size   = length;
+
+    return 1;
+}
+
+
+int
+add_cond_client(char* filename,
+                int file_size,
+                const struct proto_info *info,
+                struct sclient *client)
+{
+    struct sfiles *p = NULL;
+
+    if ( ( p = append_req_client(SF_COND, file_size + 1, client) ) == NULL )
+        return -2;
+
+    if ( ( p->filename = strndup(filename, file_size) ) == NULL ) {
+        drop_last_req_client(client);
+        return -2;
+    }
+    p->info = *info;
+
+    return 1;
+}
+
+
+int
+add_delta_client(char* filename,
+                 int file_size,
+                 const struct proto_info *info,
+                 uint32_t block,
+                 uint8_t *sigs,
+                 uint32_t nblocks,
+                 struct sclient *client)
+{
+    struct sfiles *p = NULL;
+
+    if ( ( p = append_req_client(SF_DELTA, file_size + 1 + (size_t) nblocks * DELTA_SIG_LEN, client) ) == NULL )
+        return -2;
+
+    if ( ( p->filename = strndup(filename, file_size) ) == NULL ) {
+        drop_last_req_client(client);
+        return -2;
+    }
+    p->info  = *info;
+    p->block = block;
+    p->data  = sigs;
+    p->size  = nblocks;
+
+    return 1;
+}
+
+
+int
+add_follow_client(char* filename,
+                  int file_size,
+                  uint64_t offset,
+                  uint64_t limit,
+                  uint32_t idle,
+                  struct sclient *client)
+{
+    struct sfiles *p = NULL;
+
+    if ( ( p = append_req_client(SF_FOLLOW, file_size + 1, client) ) == NULL )
+        return -2;
+
+    if ( ( p->filename = strndup(filename, file_size) ) == NULL ) {
+        drop_last_req_client(client);
+        return -2;
+    }
+    p->offset = offset;
+    p->size   = ( limit > 0 ? limit : UINT64_MAX );
+    p->block  = idle;
+
+    return 1;
+}
+
+
+int
+add_list_client(char* dirname,
+                int dir_size,
+                const char *pattern,
+                struct sclient *client)
+{
+    struct sfiles *p = NULL;
+
+    if ( ( p = append_req_client(SF_LIST, dir_size + 1 + ( pattern != NULL ? strlen(pattern) + 1 : 0 ), client) ) == NULL )
+        return -2;
+
+    if ( ( p->filename = strndup(dirname, dir_size) ) == NULL ||
+         ( ( pattern != NULL ) && ( p->data = (uint8_t *) strdup(pattern) ) == NULL ) ) {
+        free(p->filename);
+        drop_last_req_client(client);
+        return -2;
+    }
+
+    return 1;
+}
+
+
+int
+add_bndl_client(char* dirname,
+                int dir_size,
+                struct sclient *client)
+{
+    struct sfiles *p = NULL;
+
+    if ( ( p = append_req_client(SF_BNDL, dir_size + 1, client) ) == NULL )
+        return -2;
+
+    if ( ( p->filename = strndup(dirname, dir_size) ) == NULL ) {
+        drop_last_req_client(client);
+        return -2;
+    }
+    p->bfd = -1;
+
+    return 1;
+}
+
+
+int
+add_body_client(char* filename,
+                uint64_t size,
+                struct sclient *client)
+{
+    struct sfiles *p = NULL;
+
+    if ( ( p = append_req_client(SF_BODY, strlen(filename) + 1, client) ) == NULL )
+        return -2;
+
+    if ( ( p->filename = strdup(filename) ) == NULL ) {
+        drop_last_req_client(client);
+        return -2;
+    }
+    p->size = size;
+
+    return 1;
+}
+
+
+int
+add_data_client(uint8_t* data,
+                uint64_t size,
+                struct sclient *client)
+{
+    struct sfiles *p = NULL;
+
+    if ( ( p = append_req_client(SF_DATA, size, client) ) == NULL )
+        return -2;
+
+    p->data = data;
+    p->size = size;
+
+    return 1;
+}
+
+
+int
+add_error_client(struct sclient *client)
+{
+    if ( append_req_client(SF_ERR, 0, client) == NULL )
+        return -2;
 
     return 1;
 }
@@ -139,6 +425,33 @@ get_next_file_client(struct sclient *client)
 }
 
 
+struct sfiles *
+get_next_req_client(struct sclient *client)
+{
+    return client->files;
+}
+
+
+
+int
+rm_req_client(struct sclient *client,
+              struct sfiles *req)
+{
+    struct sfiles **p = NULL;
+
+    for ( p = &(client->files); ( *p != NULL ) && ( *p != req ); p = &((*p)->next_file) );
+
+    if ( (*p) == NULL )
+        return -1; // not in list
+
+    *p = req->next_file; // unlink
+    --(client->nqueued);
+    client->qbytes -= req->qbytes;
+    free_req(req);
+
+    return 1;
+}
+
 
 int
 rm_head_file_client(struct sclient *client)
@@ -150,11 +463,9 @@ rm_head_file_client(struct sclient *client)
         return -1; // nothing to remove
 
     n = (*p)->next_file;
-
-    if ( ((*p)->filename) != NULL )
-        free((*p)->filename);
-
-    free(*p);
+    --(client->nqueued);
+    client->qbytes -= (*p)->qbytes;
+    free_req(*p);
 
     *p = n; // update 'list head'
 
@@ -162,6 +473,44 @@ rm_head_file_client(struct sclient *client)
 }
 
 
+/**
+ * @brief Frees a request, closing the file being sent
+ */
+static void
+free_req(struct sfiles *req)
+{
+    if ( (req->fp) != NULL )
+        fclose(req->fp);
+
+    if ( (req->filename) != NULL )
+        free(req->filename);
+
+    if ( (req->data) != NULL )
+        free(req->data);
+
+    cache_release(req->cent);
+    free(req->zbuf);
+
+    if ( (req->dir) != NULL ) {
+        dir_close(req->dir);
+        free(req->dir);
+    }
+
+    if ( (req->wd) > 0 )
+        follow_unwatch(req->wd);
+
+    if ( (req->walk) != NULL ) {
+        walk_close(req->walk);
+        free(req->walk);
+    }
+
+    if ( (req->type) == SF_BNDL && (req->bfd) >= 0 )
+        close(req->bfd);
+
+    free(req);
+}
+
+
 int
 there_are_more_files(struct sclient *client)
 {
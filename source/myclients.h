@@ -4,17 +4,78 @@
 
 #include <inttypes.h> // uint32_t
 
+#include "myproto.h"     // struct proto_info
+#include "mycache.h"     // struct cache_ent
+#include "mydir.h"       // struct dir_reader, struct dir_walk
+
 /* DATA DEFINITION */
+
+/* per-client queue limits: the socket is not read while they are reached */
+#define QUEUE_REQS_MAX		(4096)		// requests queued
+#define QUEUE_BYTES_MAX		(8 << 20)	// memory held by the queued requests
+
+/* requests types */
+#define SF_FILE		(0)	// header + file content (GET)
+#define SF_BODY		(1)	// file content only, header already sent (MGET)
+#define SF_DATA		(2)	// in-memory reply (FEAT, MGET manifest)
+#define SF_ERR		(3)	// error, notified in requests order
+#define SF_REST		(4)	// header + file content from offset if unchanged (RGET)
+#define SF_COND		(5)	// "not modified" or header + file content (CGET)
+#define SF_DELTA	(6)	// "not modified" or header + delta (DGET)
+#define SF_LIST		(7)	// header + directory manifest (LIST)
+#define SF_FOLLOW	(8)	// header + chunks of a growing file (FGET)
+#define SF_BNDL		(9)	// header + directory tree archive (BNDL)
+#define SF_RANGE	(10)	// header + byte range of a file (PGET)
+
 struct sfiles {
 	char 			*filename;
+	int				type;		// request type (SF_*)
+	uint32_t		stream;		// command sequence nr. (MUX stream id)
+	uint8_t			*data;		// SF_DATA: reply to be sent, SF_DELTA: signatures,
+								// SF_LIST: pattern (NULL for all)
+	uint64_t		size;		// SF_BODY, SF_DATA: bytes to be sent, SF_DELTA: nr. of signatures,
+								// SF_FOLLOW: bytes still allowed (limit), SF_RANGE: range length,
+								// SF_BNDL: bytes of the file being sent still to be read
+	uint32_t		block;		// SF_DELTA: block size, SF_FOLLOW: idle timeout (ms)
+	struct proto_info info;		// SF_REST, SF_COND, SF_DELTA: expected file info,
+								// CRC: info of the file sent (once started)
+	uint64_t		offset;		// SF_REST, SF_RANGE: offset of first byte to be sent,
+								// SF_FOLLOW: offset of next byte to be sent
+	int				started;	// reply is being sent
+	FILE			*fp;		// file being sent
+	uint64_t		left;		// bytes still to be sent (file or data), SF_LIST,
+								// SF_FOLLOW, SF_BNDL: 1 until the end of the reply is built
+	struct cache_ent *cent;		// LZ: cached compressed file being sent
+	uint8_t			*zbuf;		// LZ: file compressed while sent, block buffer,
+								// SF_LIST: manifest entries buffer, SF_BNDL: archive buffer
+	int				zlen;		// LZ, SF_LIST, SF_BNDL: bytes in zbuf
+	int				zpos;		// LZ, SF_LIST, SF_BNDL: bytes of zbuf already sent
+	struct dir_reader *dir;		// SF_LIST: directory being listed
+	struct dir_walk	*walk;		// SF_BNDL: tree being sent
+	int				bfd;		// SF_BNDL: file being sent (-1 if none)
+	int				wd;			// SF_FOLLOW: watch on the file (0 if none)
+	int				waiting;	// SF_FOLLOW: nothing to send until woken up
+	int				stop;		// SF_FOLLOW: STOP received
+	uint64_t		idle_at;	// SF_FOLLOW: end if nothing appended by then (ms)
+	uint32_t		crc;		// CRC: file checksum (running if crc_run)
+	int				crc_run;	// CRC: checksum computed while sending the file,
+								// SF_BNDL: 0 if the file shrank while sent
+	int				tleft;		// CRC: checksum bytes still to be sent
+	size_t			qbytes;		// memory accounted to the client's queue
+	int				prio;		// PRIO: class of the request (PROTO_PRIO_*)
 	struct sfiles	*next_file;
 };
 
 struct sclient {
-	FILE*         cfp;			      // Current File (Pointer) transferring
 	struct sfiles *files;             // files requested list
-	uint32_t      bytesToBeWrittenCF; // bytes still to be written on current file
 	int		      sendError;          // says if server has to send error to client
+	unsigned int  features;           // negotiated protocol extensions (FEAT_*)
+	unsigned int  nrequests;          // nr. of commands received
+	uint32_t      last_stream;        // MUX: last stream served (round robin)
+	int           peer;               // REDIR: peer the client is sent to (-1 if served here)
+	int           prio;               // PRIO: class of the next requests (PROTO_PRIO_*)
+	unsigned int  nqueued;            // nr. of requests queued
+	size_t        qbytes;             // memory held by the queued requests
 };
 
 struct sready_clients {
@@ -40,6 +101,28 @@ int add_client(int sockfd,
 		  	   struct sready_clients *ready_clients);
 
 
+/**
+ * @brief Sets the limits of the clients' request queues (0 keeps a limit)
+ *
+ * @param reqs              max requests queued
+ * @param bytes             max memory held by the queued requests
+ */
+void set_queue_limits(unsigned int reqs, size_t bytes);
+
+/**
+ * @brief Checks if a client's request queue is full: its socket must not be
+ *        read (selected) until some requests were served
+ *
+ * NOTE: the command being read is always queued, a queue can exceed its
+ *       limits by one command (MGET_MAX files at most)
+ *
+ * @param client            client info
+ *
+ * @return  1 to say YES
+ * @return  0 to say NO
+ */
+int queue_full(const struct sclient *client);
+
 /**
  * @brief Removes a client to the 'server's clients database'
  *
@@ -70,6 +153,181 @@ int add_file_client(char* filename,
                     int file_size,
                     struct sclient *client);
 
+/**
+ * @brief Adds a file to be sent from an offset to the client's files list
+ *
+ * NOTE: the file is sent from 'offset' only if its size and timestamp are
+ *       still the ones in 'info', otherwise it is sent whole.
+ *
+ * @param filename      the filename
+ * @param file_size     lenght of the filename
+ * @param offset        offset of the first byte to be sent
+ * @param info          expected file info
+ * @param client        reference to client
+ *
+ * @return   1 if OK
+ * @return  -2 on system error
+ */
+int add_rest_client(char* filename,
+                    int file_size,
+                    uint64_t offset,
+                    const struct proto_info *info,
+                    struct sclient *client);
+
+/**
+ * @brief Adds a byte range of a file to the client's files list
+ *
+ * @param filename      the filename
+ * @param file_size     lenght of the filename
+ * @param offset        offset of the first byte to be sent
+ * @param length        max nr. of bytes to be sent
+ * @param client        reference to client
+ *
+ * @return   1 if OK
+ * @return  -2 on system error
+ */
+int add_range_client(char* filename,
+                     int file_size,
+                     uint64_t offset,
+                     uint64_t length,
+                     struct sclient *client);
+
+/**
+ * @brief Adds a file to be sent only if changed to the client's files list
+ *
+ * NOTE: the file is not sent if its size and timestamp are still the ones in
+ *       'info'
+ *
+ * @param filename      the filename
+ * @param file_size     lenght of the filename
+ * @param info          file info of the client's copy
+ * @param client        reference to client
+ *
+ * @return   1 if OK
+ * @return  -2 on system error
+ */
+int add_cond_client(char* filename,
+                    int file_size,
+                    const struct proto_info *info,
+                    struct sclient *client);
+
+/**
+ * @brief Adds a file to be sent as delta to the client's files list
+ *
+ * NOTE: the list takes ownership of 'sigs' (it must be malloc'ed)
+ *
+ * @param filename      the filename
+ * @param file_size     lenght of the filename
+ * @param info          file info of the client's copy
+ * @param block         block size
+ * @param sigs          signatures of the client's copy
+ * @param nblocks       nr. of signatures
+ * @param client        reference to client
+ *
+ * @return   1 if OK
+ * @return  -2 on system error
+ */
+int add_delta_client(char* filename,
+                     int file_size,
+                     const struct proto_info *info,
+                     uint32_t block,
+                     uint8_t *sigs,
+                     uint32_t nblocks,
+                     struct sclient *client);
+
+/**
+ * @brief Adds a file to be followed to the client's files list
+ *
+ * @param filename      the filename
+ * @param file_size     lenght of the filename
+ * @param offset        offset of the first byte to be sent
+ * @param limit         max bytes to be sent (0 for no limit)
+ * @param idle          idle timeout in ms (0 for none)
+ * @param client        reference to client
+ *
+ * @return   1 if OK
+ * @return  -2 on system error
+ */
+int add_follow_client(char* filename,
+                      int file_size,
+                      uint64_t offset,
+                      uint64_t limit,
+                      uint32_t idle,
+                      struct sclient *client);
+
+/**
+ * @brief Adds a directory to be listed to the client's files list
+ *
+ * @param dirname       the directory
+ * @param dir_size      lenght of the directory name
+ * @param pattern       names to be listed (fnmatch() pattern), NULL for all
+ * @param client        reference to client
+ *
+ * @return   1 if OK
+ * @return  -2 on system error
+ */
+int add_list_client(char* dirname,
+                    int dir_size,
+                    const char *pattern,
+                    struct sclient *client);
+
+/**
+ * @brief Adds a directory tree to be sent to the client's files list
+ *
+ * @param dirname       the directory
+ * @param dir_size      lenght of the directory name
+ * @param client        reference to client
+ *
+ * @return   1 if OK
+ * @return  -2 on system error
+ */
+int add_bndl_client(char* dirname,
+                    int dir_size,
+                    struct sclient *client);
+
+/**
+ * @brief Adds a file whose header was already sent to the client's files list
+ *
+ * @param filename      the filename
+ * @param size          bytes to be sent
+ * @param client        reference to client
+ *
+ * @return   1 if OK
+ * @return  -2 on system error
+ */
+int add_body_client(char* filename,
+                    uint64_t size,
+                    struct sclient *client);
+
+/**
+ * @brief Adds an in-memory reply to the client's files list
+ *
+ * NOTE: the list takes ownership of 'data' (it must be malloc'ed)
+ *
+ * @param data          reply to be sent
+ * @param size          reply length
+ * @param client        reference to client
+ *
+ * @return   1 if OK
+ * @return  -2 on system error
+ */
+int add_data_client(uint8_t* data,
+                    uint64_t size,
+                    struct sclient *client);
+
+/**
+ * @brief Adds an error to the client's files list
+ *
+ * NOTE: pipelined requests must be answered in order, the error is sent once
+ *       all previous requests were served.
+ *
+ * @param client        reference to client
+ *
+ * @return   1 if OK
+ * @return  -2 on system error
+ */
+int add_error_client(struct sclient *client);
+
 /**
  * @brief Retrieve the name of the next file to be sent to client
  *
@@ -80,6 +338,28 @@ int add_file_client(char* filename,
  */
 char * get_next_file_client(struct sclient *client);
 
+/**
+ * @brief Retrieve the next request to be served
+ *
+ * @param client        reference to client
+ *
+ * @return  pointer to request if OK
+ * @return  NULL if there are no requests
+ */
+struct sfiles * get_next_req_client(struct sclient *client);
+
+/**
+ * @brief Removes a request (presumably served) from client's files list
+ *
+ * @param client        reference to client
+ * @param req           request to be removed
+ *
+ * @return   1 if Ok
+ * @return  -1 on function error
+ */
+int rm_req_client(struct sclient *client,
+                  struct sfiles *req);
+
 /**
  * @brief Removes the head file (presumably sent) in client's files list
  *
@@ -0,0 +1,209 @@
+/** ---------------------------------------------------------------------------
+ * Assignment - CRC32C checksum library
+ *
+ * @author dcr
+ * ----------------------------------------------------------------------------
+ */
+#define _FILE_OFFSET_BITS 64 // files > 2GB on 32-bit systems
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>    // pthread_once()
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>  // SSE4.2 intrinsics
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>   // CRC intrinsics
+#endif
+
+#include "mycrc.h"
+
+#define POLY		(0x82F63B78u)	// Castagnoli, reflected
+#define READ_BUF	(1 << 16)		// crc32c_file() buffer
+#define STRIPE		(8192)			// hardware: 3 interleaved streams of STRIPE bytes
+
+static uint32_t table[8][256];     // slicing-by-8 tables
+#if defined(__x86_64__) && defined(__GNUC__)
+static uint32_t shift[4][256];     // CRC of a state followed by STRIPE zero bytes
+static uint32_t crc_shift(uint32_t crc);
+#endif
+static uint32_t (*impl)(uint32_t crc, const uint8_t *p, size_t len) = NULL;
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+static void crc_init(void);
+static uint32_t crc_sw(uint32_t crc, const uint8_t *p, size_t len);
+
+
+uint32_t
+crc32c(uint32_t crc, const void *buf, size_t len)
+{
+	pthread_once(&once, crc_init);
+
+	return ~impl(~crc, buf, len);
+}
+
+
+int
+crc32c_file(FILE *fp, uint64_t len, uint32_t *crc)
+{
+	uint8_t *buf = NULL;
+	size_t  n    = 0;
+
+	if ( ( buf = malloc(READ_BUF) ) == NULL )
+		return -1;
+
+	for ( ; len > 0; len -= n ) {
+		n = ( len < READ_BUF ? len : READ_BUF );
+		if ( fread(buf, 1, n, fp) < n ) {
+			free(buf);
+			return -1;
+		}
+		*crc = crc32c(*crc, buf, n);
+	}
+
+	free(buf);
+	return 0;
+}
+
+
+#if defined(__x86_64__) && defined(__GNUC__)
+/**
+ * @brief Moves a CRC32C state over STRIPE zero bytes
+ */
+static uint32_t
+crc_shift(uint32_t crc)
+{
+	return shift[0][crc & 0xff] ^ shift[1][(crc >> 8) & 0xff] ^
+		   shift[2][(crc >> 16) & 0xff] ^ shift[3][crc >> 24];
+}
+
+
+/**
+ * @brief CRC32C with the SSE4.2 instruction, 8 bytes at a time
+ *
+ * NOTE: the instruction has a latency of 3 cycles, long buffers are split in
+ *       3 streams computed together, then combined.
+ */
+__attribute__((target("sse4.2")))
+static uint32_t
+crc_hw(uint32_t crc, const uint8_t *p, size_t len)
+{
+	uint64_t c  = crc;
+	uint64_t c1 = 0;
+	uint64_t c2 = 0;
+	uint64_t v = 0, v1 = 0, v2 = 0;
+	size_t   i = 0;
+
+	for ( ; ( len > 0 ) && ( (uintptr_t) p & 7 ); p++, len-- )
+		c = _mm_crc32_u8(c, *p);
+
+	for ( ; len >= 3 * STRIPE; p += 3 * STRIPE, len -= 3 * STRIPE ) {
+		c1 = 0;
+		c2 = 0;
+		for ( i = 0; i < STRIPE; i += 8 ) {
+			memcpy(&v,  p + i, 8);
+			memcpy(&v1, p + STRIPE + i, 8);
+			memcpy(&v2, p + 2*STRIPE + i, 8);
+			c  = _mm_crc32_u64(c,  v);
+			c1 = _mm_crc32_u64(c1, v1);
+			c2 = _mm_crc32_u64(c2, v2);
+		}
+		c = crc_shift(crc_shift(c) ^ c1) ^ c2;
+	}
+
+	for ( ; len >= 8; p += 8, len -= 8 ) {
+		memcpy(&v, p, 8);
+		c = _mm_crc32_u64(c, v);
+	}
+
+	for ( ; len > 0; p++, len-- )
+		c = _mm_crc32_u8(c, *p);
+
+	return c;
+}
+
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+/**
+ * @brief CRC32C with the ARMv8 instruction, 8 bytes at a time
+ */
+static uint32_t
+crc_hw(uint32_t crc, const uint8_t *p, size_t len)
+{
+	uint64_t v = 0;
+
+	for ( ; len >= 8; p += 8, len -= 8 ) {
+		memcpy(&v, p, 8);
+		crc = __crc32cd(crc, v);
+	}
+
+	for ( ; len > 0; p++, len-- )
+		crc = __crc32cb(crc, *p);
+
+	return crc;
+}
+#endif
+
+
+/**
+ * @brief Builds the tables and picks the implementation (once)
+ */
+static void
+crc_init(void)
+{
+	uint32_t c = 0;
+	int i = 0;
+	int j = 0;
+
+	for ( i = 0; i < 256; i++ ) {
+		c = i;
+		for ( j = 0; j < 8; j++ )
+			c = ( c & 1 ? ( c >> 1 ) ^ POLY : c >> 1 );
+		table[0][i] = c;
+	}
+
+	for ( i = 0; i < 256; i++ )
+		for ( j = 1; j < 8; j++ )
+			table[j][i] = ( table[j-1][i] >> 8 ) ^ table[0][table[j-1][i] & 0xff];
+
+	impl = crc_sw;
+#if defined(__x86_64__) && defined(__GNUC__)
+	/* the state after STRIPE zero bytes is linear in the initial state: tables
+	 * from the states of single bits */
+	for ( i = 0; i < 32; i++ ) {
+		for ( c = 1u << i, j = 0; j < STRIPE; j++ )
+			c = ( c >> 8 ) ^ table[0][c & 0xff];
+		for ( j = 0; j < 256; j++ )
+			if ( j & ( 1 << (i & 7) ) )
+				shift[i >> 3][j] ^= c;
+	}
+
+	if ( __builtin_cpu_supports("sse4.2") )
+		impl = crc_hw;
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+	impl = crc_hw;
+#endif
+}
+
+
+/**
+ * @brief CRC32C with slicing-by-8 tables (little endian loads)
+ */
+static uint32_t
+crc_sw(uint32_t crc, const uint8_t *p, size_t len)
+{
+	uint32_t lo = 0;
+	uint32_t hi = 0;
+
+	for ( ; len >= 8; p += 8, len -= 8 ) {
+		lo = crc ^ ( (uint32_t) p[0] | ( (uint32_t) p[1] << 8 ) | ( (uint32_t) p[2] << 16 ) | ( (uint32_t) p[3] << 24 ) );
+		hi = (uint32_t) p[4] | ( (uint32_t) p[5] << 8 ) | ( (uint32_t) p[6] << 16 ) | ( (uint32_t) p[7] << 24 );
+		crc = table[7][lo & 0xff] ^ table[6][(lo >> 8) & 0xff] ^ table[5][(lo >> 16) & 0xff] ^ table[4][lo >> 24] ^
+			  table[3][hi & 0xff] ^ table[2][(hi >> 8) & 0xff] ^ table[1][(hi >> 16) & 0xff] ^ table[0][hi >> 24];
+	}
+
+	for ( ; len > 0; p++, len-- )
+		crc = ( crc >> 8 ) ^ table[0][(crc ^ *p) & 0xff];
+
+	return crc;
+}
@@ -0,0 +1,36 @@
+#ifndef _MYCRC_H
+#define _MYCRC_H
+
+#include <stdio.h>    // FILE
+#include <stddef.h>   // size_t
+#include <inttypes.h> // uint32_t
+
+/**
+ * @brief Updates a CRC32C (Castagnoli) checksum, with the CPU instructions
+ *        if available (SSE4.2 on x86-64, CRC on ARMv8), slicing-by-8 tables
+ *        otherwise
+ *
+ * NOTE: crc32c(0, NULL, 0) is the checksum of no data, checksums can be
+ *       updated: crc32c(crc32c(0, a, n), b, m) is the checksum of a + b
+ *
+ * @param crc           checksum of the previous data
+ * @param buf           data
+ * @param len           data length
+ *
+ * @return  the updated checksum
+ */
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len);
+
+/**
+ * @brief Updates a CRC32C checksum with 'len' bytes of a file
+ *
+ * @param fp            file (read from its current position)
+ * @param len           bytes to be read
+ * @param crc           checksum of the previous data (updated)
+ *
+ * @return  0 if OK
+ * @return -1 on error (file shorter than 'len' or read error)
+ */
+int crc32c_file(FILE *fp, uint64_t len, uint32_t *crc);
+
+#endif
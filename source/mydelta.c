@@ -0,0 +1,379 @@
+/** ---------------------------------------------------------------------------
+ * Assignment - Delta encoding library (rsync-like)
+ *
+ * @author dcr
+ * ----------------------------------------------------------------------------
+ */
+#define _FILE_OFFSET_BITS 64 // files > 2GB on 32-bit systems
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>  // htonl()
+
+#if defined(__SSE2__)
+#include <emmintrin.h>  // SSE2 intrinsics
+#endif
+
+#include "mydelta.h"
+
+#define LIT_MAX		(1 << 20)	// max literal length in one operation
+#define COPY_BUF	(1 << 16)	// literals copy buffer
+
+#define PRIME1		(0x9E3779B185EBCA87ULL)
+#define PRIME2		(0xC2B2AE3D27D4EB4FULL)
+#define PRIME3		(0x165667B19E3779F9ULL)
+#define PRIME4		(0x85EBCA77C2B2AE63ULL)
+#define PRIME5		(0x27D4EB2F165667C5ULL)
+
+static int put_lit(FILE *out, const uint8_t *data, uint64_t len);
+static int put_block(FILE *out, uint32_t idx);
+
+
+uint32_t
+delta_weak(const uint8_t *buf, size_t len)
+{
+	uint32_t a = 0; // sum of bytes
+	uint32_t b = 0; // sum of bytes weighted by distance from block end
+	size_t   i = 0;
+
+#if defined(__SSE2__)
+	/* 16 bytes at a time: b = sum over chunks c of (len - 16c) * S[c] - W[c],
+	 * S[c] sum of chunk bytes, W[c] sum of chunk bytes weighted by their
+	 * index in the chunk. NOTE: only the low 16 bits matter, sums can wrap. */
+	size_t n = len / 16;
+
+	if ( n > 0 ) {
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i wlo  = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+		const __m128i whi  = _mm_setr_epi16(8, 9, 10, 11, 12, 13, 14, 15);
+		__m128i vs = zero; // S[0] + .. + S[c]
+		__m128i vp = zero; // sum of the above, before adding S[c]
+		__m128i vw = zero; // W[0] + .. + W[c]
+		__m128i v;
+		uint64_t s[2], p[2];
+		uint32_t w[4];
+		uint32_t sum = 0;
+		uint32_t pre = 0;
+		size_t   c   = 0;
+
+		for ( c = 0; c < n; c++ ) {
+			v  = _mm_loadu_si128((const __m128i *) (buf + 16*c));
+			vp = _mm_add_epi64(vp, vs);
+			vs = _mm_add_epi64(vs, _mm_sad_epu8(v, zero));
+			vw = _mm_add_epi32(vw, _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi8(v, zero), wlo),
+												 _mm_madd_epi16(_mm_unpackhi_epi8(v, zero), whi)));
+		}
+
+		_mm_storeu_si128((__m128i *) s, vs);
+		_mm_storeu_si128((__m128i *) p, vp);
+		_mm_storeu_si128((__m128i *) w, vw);
+
+		sum = s[0] + s[1];
+		pre = p[0] + p[1]; // sum of (n-1-c) * S[c]
+
+		a = sum;
+		b = len * sum - 16 * ( (n-1) * sum - pre ) - ( w[0] + w[1] + w[2] + w[3] );
+		i = 16 * n;
+	}
+#endif // __SSE2__
+
+	for ( ; i < len; i++ ) {
+		a += buf[i];
+		b += ( len - i ) * buf[i];
+	}
+
+	return ( a & 0xffff ) | ( b << 16 );
+}
+
+
+uint32_t
+delta_roll(uint32_t weak, uint8_t out, uint8_t in, size_t len)
+{
+	uint32_t a = weak & 0xffff;
+	uint32_t b = weak >> 16;
+
+	a = ( a - out + in ) & 0xffff;
+	b = ( b - len * out + a ) & 0xffff;
+
+	return a | ( b << 16 );
+}
+
+
+static uint64_t
+rotl64(uint64_t x, int r)
+{
+	return ( x << r ) | ( x >> (64 - r) );
+}
+
+
+static uint64_t
+load64(const uint8_t *p) // little endian, same hash on any host
+{
+	return   (uint64_t) p[0]        | ((uint64_t) p[1] << 8)  | ((uint64_t) p[2] << 16) |
+			((uint64_t) p[3] << 24) | ((uint64_t) p[4] << 32) | ((uint64_t) p[5] << 40) |
+			((uint64_t) p[6] << 48) | ((uint64_t) p[7] << 56);
+}
+
+
+uint64_t
+delta_strong(const uint8_t *buf, size_t len)
+{
+	uint64_t h = PRIME5 + len;
+	uint64_t k = 0;
+
+	for ( ; len >= 8; buf += 8, len -= 8 ) {
+		k  = rotl64(load64(buf) * PRIME2, 31) * PRIME1;
+		h ^= k;
+		h  = rotl64(h, 27) * PRIME1 + PRIME4;
+	}
+
+	for ( ; len > 0; buf++, len-- ) {
+		h ^= (*buf) * PRIME5;
+		h  = rotl64(h, 11) * PRIME1;
+	}
+
+	/* final mix */
+	h ^= h >> 33;
+	h *= PRIME2;
+	h ^= h >> 29;
+	h *= PRIME3;
+	h ^= h >> 32;
+
+	return h;
+}
+
+
+uint32_t
+delta_block_size(uint64_t size)
+{
+	uint32_t block = DELTA_BLOCK_MIN;
+
+	while ( ( block < DELTA_BLOCK_MAX ) &&
+			( ( (uint64_t) block * block < size ) || ( size / block > DELTA_BLOCKS_MAX ) ) )
+		block <<= 1;
+
+	return block;
+}
+
+
+int
+delta_signatures(FILE *fp, uint32_t block, uint32_t nblocks, uint8_t *sigs)
+{
+	uint8_t  *buf = NULL;
+	uint32_t weak = 0;
+	uint64_t strong = 0;
+	uint32_t i  = 0;
+	int      ret = 0;
+
+	if ( ( buf = malloc(block) ) == NULL )
+		return -1;
+
+	for ( i = 0; i < nblocks; i++, sigs += DELTA_SIG_LEN ) {
+
+		if ( fread(buf, 1, block, fp) < block ) {
+			ret = -1;
+			break;
+		}
+
+		weak   = htonl(delta_weak(buf, block));
+		strong = delta_strong(buf, block);
+		memcpy(sigs, &weak, 4);
+		weak   = htonl(strong >> 32);
+		memcpy(sigs+4, &weak, 4);
+		weak   = htonl(strong & 0xffffffffu);
+		memcpy(sigs+8, &weak, 4);
+	}
+
+	free(buf);
+	return ret;
+}
+
+
+int
+delta_generate(FILE *out, const uint8_t *data, uint64_t size,
+			   const uint8_t *sigs, uint32_t nblocks, uint32_t block)
+{
+	int32_t  *head  = NULL; // hash table of weak checksums: first block..
+	int32_t  *next  = NULL; // ..and next block with the same hash
+	uint32_t *weaks = NULL;
+	uint32_t mask   = 1;
+	uint32_t weak   = 0;
+	uint32_t hi = 0, lo = 0;
+	uint64_t strong = 0;
+	uint64_t pos    = 0; // start of current window
+	uint64_t lit    = 0; // start of pending literal data
+	int      have_strong = 0;
+	int32_t  j   = 0;
+	uint32_t i   = 0;
+	int      ret = -1;
+
+	while ( mask < 2 * nblocks )
+		mask <<= 1;
+
+	if ( ( head = malloc(mask * sizeof(int32_t)) ) == NULL ||
+		 ( next = malloc((nblocks + 1) * sizeof(int32_t)) ) == NULL ||
+		 ( weaks = malloc((nblocks + 1) * sizeof(uint32_t)) ) == NULL )
+		goto out;
+
+	mask -= 1;
+	memset(head, 0xff, (mask + 1) * sizeof(int32_t)); // -1: empty
+
+	for ( i = nblocks; i-- > 0; ) { // chains in block order
+		memcpy(&weak, sigs + i*DELTA_SIG_LEN, 4);
+		weaks[i] = ntohl(weak);
+		next[i]  = head[weaks[i] & mask];
+		head[weaks[i] & mask] = i;
+	}
+
+	if ( ( nblocks > 0 ) && ( size >= block ) )
+		weak = delta_weak(data, block);
+
+	while ( ( nblocks > 0 ) && ( pos + block <= size ) ) {
+
+		/* look for a block with the same checksum, then the same hash */
+		have_strong = 0;
+		for ( j = head[weak & mask]; j >= 0; j = next[j] ) {
+			if ( weaks[j] != weak )
+				continue;
+
+			if ( !have_strong ) {
+				strong = delta_strong(data + pos, block);
+				have_strong = 1;
+			}
+
+			memcpy(&hi, sigs + j*DELTA_SIG_LEN + 4, 4);
+			memcpy(&lo, sigs + j*DELTA_SIG_LEN + 8, 4);
+			if ( ( ((uint64_t) ntohl(hi) << 32) | ntohl(lo) ) == strong )
+				break;
+		}
+
+		if ( j >= 0 ) { // match: pending literals, block reference
+			if ( ( put_lit(out, data + lit, pos - lit) < 0 ) || ( put_block(out, j) < 0 ) )
+				goto out;
+
+			pos += block;
+			lit  = pos;
+			if ( pos + block <= size )
+				weak = delta_weak(data + pos, block);
+			continue;
+		}
+
+		if ( pos + block == size )
+			break; // no more bytes to roll in
+
+		weak = delta_roll(weak, data[pos], data[pos + block], block);
+		++pos;
+	}
+
+	if ( ( put_lit(out, data + lit, size - lit) < 0 ) || ( fputc(DELTA_OP_END, out) == EOF ) )
+		goto out;
+
+	ret = 0;
+
+out:
+	free(head);
+	free(next);
+	free(weaks);
+	return ret;
+}
+
+
+int
+delta_apply(FILE *delta, FILE *basis, FILE *out, uint32_t block, uint64_t *written)
+{
+	uint8_t  *buf = NULL;
+	uint32_t len  = 0;
+	uint32_t n    = 0;
+	int      op   = 0;
+	int      ret  = 0;
+
+	*written = 0;
+
+	if ( ( buf = malloc( block > COPY_BUF ? block : COPY_BUF ) ) == NULL )
+		return -2;
+
+	while ( ( ret == 0 ) && ( ( op = fgetc(delta) ) != DELTA_OP_END ) ) {
+
+		if ( ( op == EOF ) || ( fread(&len, 4, 1, delta) < 1 ) ) {
+			ret = -1;
+			break;
+		}
+		len = ntohl(len);
+
+		switch ( op ) {
+
+			case DELTA_OP_BLOCK: // len is the block index
+				if ( ( fseeko(basis, (off_t) len * block, SEEK_SET) < 0 ) ||
+					 ( fread(buf, 1, block, basis) < block ) ) {
+					ret = -1; // not a block of the receiver's copy
+					break;
+				}
+				if ( fwrite(buf, 1, block, out) < block )
+					ret = -2;
+				*written += block;
+				break;
+
+			case DELTA_OP_LIT:
+				for ( ; ( ret == 0 ) && ( len > 0 ); len -= n ) {
+					n = ( len < COPY_BUF ? len : COPY_BUF );
+					if ( fread(buf, 1, n, delta) < n )
+						ret = -1;
+					else if ( fwrite(buf, 1, n, out) < n )
+						ret = -2;
+					*written += n;
+				}
+				break;
+
+			default:
+				ret = -1;
+				break;
+		}
+	}
+
+	free(buf);
+	return ret;
+}
+
+
+/**
+ * @brief Writes literal data (split in operations of at most LIT_MAX bytes)
+ *
+ * @return  0 if OK
+ * @return -1 on error
+ */
+static int
+put_lit(FILE *out, const uint8_t *data, uint64_t len)
+{
+	uint32_t n  = 0;
+	uint32_t nn = 0;
+
+	for ( ; len > 0; data += n, len -= n ) {
+		n  = ( len < LIT_MAX ? len : LIT_MAX );
+		nn = htonl(n);
+
+		if ( ( fputc(DELTA_OP_LIT, out) == EOF ) || ( fwrite(&nn, 4, 1, out) < 1 ) ||
+			 ( fwrite(data, 1, n, out) < n ) )
+			return -1;
+	}
+
+	return 0;
+}
+
+
+/**
+ * @brief Writes a block reference
+ *
+ * @return  0 if OK
+ * @return -1 on error
+ */
+static int
+put_block(FILE *out, uint32_t idx)
+{
+	idx = htonl(idx);
+
+	if ( ( fputc(DELTA_OP_BLOCK, out) == EOF ) || ( fwrite(&idx, 4, 1, out) < 1 ) )
+		return -1;
+
+	return 0;
+}
@@ -0,0 +1,120 @@
+#ifndef _MYDELTA_H
+#define _MYDELTA_H
+
+#include <stdio.h>    // FILE
+#include <stddef.h>   // size_t
+#include <inttypes.h> // uint32_t
+
+/**
+ * DELTA ENCODING
+ *
+ * The receiver splits its copy of a file in blocks and sends a signature for
+ * each full block: a weak rolling checksum and a strong hash.
+ *
+ *     |W|{4} |S|{8}
+ *
+ * The sender looks for blocks of its file with the same signatures at any
+ * offset and describes its file as a sequence of operations:
+ *
+ *     |B| |I|{4}                      copy block I of the receiver's copy
+ *     |L| |N|{4} \* N bytes *\        literal data
+ *     |E|                             end of the file
+ *
+ * (numbers in network byte order)
+ */
+#define DELTA_OP_BLOCK		('B')
+#define DELTA_OP_LIT		('L')
+#define DELTA_OP_END		('E')
+
+#define DELTA_SIG_LEN		(12)		// signature length
+#define DELTA_BLOCK_MIN		(1 << 10)	// min block size
+#define DELTA_BLOCK_MAX		(1 << 20)	// max block size
+#define DELTA_BLOCKS_MAX	(1 << 16)	// max nr. of blocks (signatures)
+
+/**
+ * @brief Weak checksum of a block (vectorized)
+ *
+ * @param buf           block
+ * @param len           block length
+ *
+ * @return  the checksum
+ */
+uint32_t delta_weak(const uint8_t *buf, size_t len);
+
+/**
+ * @brief Rolls the weak checksum of a block one byte forward
+ *
+ * @param weak          checksum of the block
+ * @param out           first byte of the block (leaving)
+ * @param in            byte following the block (entering)
+ * @param len           block length
+ *
+ * @return  the checksum of the block moved by one byte
+ */
+uint32_t delta_roll(uint32_t weak, uint8_t out, uint8_t in, size_t len);
+
+/**
+ * @brief Strong hash of a block
+ *
+ * @param buf           block
+ * @param len           block length
+ *
+ * @return  the hash
+ */
+uint64_t delta_strong(const uint8_t *buf, size_t len);
+
+/**
+ * @brief Chooses the block size for a file (about the square root of its size)
+ *
+ * @param size          file size
+ *
+ * @return  the block size
+ */
+uint32_t delta_block_size(uint64_t size);
+
+/**
+ * @brief Computes the signatures of the full blocks of a file
+ *
+ * @param fp            file (read from its current position)
+ * @param block         block size
+ * @param nblocks       nr. of blocks
+ * @param sigs          output buffer (nblocks * DELTA_SIG_LEN bytes)
+ *
+ * @return  0 if OK
+ * @return -1 on error (file shorter than nblocks blocks or read error)
+ */
+int delta_signatures(FILE *fp, uint32_t block, uint32_t nblocks, uint8_t *sigs);
+
+/**
+ * @brief Writes the operations that describe 'data' in terms of the blocks
+ *        of the receiver's copy
+ *
+ * @param out           output file
+ * @param data          file content
+ * @param size          file size
+ * @param sigs          receiver's signatures
+ * @param nblocks       nr. of signatures
+ * @param block         block size
+ *
+ * @return  0 if OK
+ * @return -1 on error
+ */
+int delta_generate(FILE *out, const uint8_t *data, uint64_t size,
+                   const uint8_t *sigs, uint32_t nblocks, uint32_t block);
+
+/**
+ * @brief Rebuilds a file from the receiver's copy and the operations
+ *
+ * @param delta         operations (read from its current position)
+ * @param basis         receiver's copy
+ * @param out           output file
+ * @param block         block size
+ * @param written       bytes written on output file (output)
+ *
+ * @return  0 if OK
+ * @return -1 on format error
+ * @return -2 on file-system error
+ */
+int delta_apply(FILE *delta, FILE *basis, FILE *out, uint32_t block, uint64_t *written);
+
+#endif
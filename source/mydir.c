@@ -0,0 +1,355 @@
+/** ---------------------------------------------------------------------------
+ * Assignment - Directory reading in batches (LIST), tree walks (BNDL)
+ *
+ * @author dcr
+ * ----------------------------------------------------------------------------
+ */
+#define _GNU_SOURCE          // statx()
+#define _FILE_OFFSET_BITS 64 // files > 2GB on 32-bit systems
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>          // open()
+#include <dirent.h>         // DT_*
+#include <fnmatch.h>
+#include <sys/stat.h>       // statx()
+#include <sys/syscall.h>    // SYS_getdents64
+
+#include "mydir.h"
+
+/* raw entry returned by getdents64 */
+struct linux_dirent64 {
+	uint64_t       d_ino;
+	int64_t        d_off;
+	unsigned short d_reclen;
+	unsigned char  d_type;
+	char           d_name[];
+};
+
+static int stat_entry(int dirfd, const char *name, struct dir_entry *ent);
+static int read_entries(struct dir_walk *w);
+static int cmp_ino(const void *a, const void *b);
+
+
+int
+dir_open(struct dir_reader *d, const char *path, const char *pattern)
+{
+	memset(d, 0, sizeof(struct dir_reader));
+
+	if ( ( d->fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC) ) < 0 )
+		return -1;
+
+	if ( ( d->buf = malloc(DIR_BUF_LEN) ) == NULL ||
+		 ( ( pattern != NULL ) && ( d->pattern = strdup(pattern) ) == NULL ) ) {
+		dir_close(d);
+		return -2;
+	}
+
+	return 0;
+}
+
+
+int
+dir_next(struct dir_reader *d, struct dir_entry *ent)
+{
+	struct linux_dirent64 *de = NULL;
+	long n = 0;
+
+	for ( ; ; ) {
+
+		/* next batch of entries */
+		if ( d->pos == d->len ) {
+			if ( d->end )
+				return 0;
+
+			if ( ( n = syscall(SYS_getdents64, d->fd, d->buf, DIR_BUF_LEN) ) < 0 )
+				return -1;
+
+			d->len = n;
+			d->pos = 0;
+			d->end = ( n == 0 );
+			continue;
+		}
+
+		de      = (struct linux_dirent64 *) (d->buf + d->pos);
+		d->pos += de->d_reclen;
+
+		/* filter by name and type before asking for the info */
+		if ( ( strcmp(de->d_name, ".") == 0 ) || ( strcmp(de->d_name, "..") == 0 ) )
+			continue;
+
+		if ( ( de->d_type != DT_REG ) && ( de->d_type != DT_DIR ) &&
+			 ( de->d_type != DT_LNK ) && ( de->d_type != DT_UNKNOWN ) )
+			continue;
+
+		if ( ( d->pattern != NULL ) && ( fnmatch(d->pattern, de->d_name, FNM_PERIOD) != 0 ) )
+			continue;
+
+		if ( stat_entry(d->fd, de->d_name, ent) == 0 )
+			return 1; // otherwise removed meanwhile, a dangling link...
+	}
+}
+
+
+void
+dir_close(struct dir_reader *d)
+{
+	if ( d->fd >= 0 )
+		close(d->fd);
+	free(d->buf);
+	free(d->pattern);
+
+	d->fd      = -1;
+	d->buf     = NULL;
+	d->pattern = NULL;
+}
+
+
+/**
+ * @brief Gets the info of an entry, if it is a regular file or a directory
+ *
+ * @return  0 if OK
+ * @return -1 if not found or not listed
+ */
+static int
+stat_entry(int dirfd, const char *name, struct dir_entry *ent)
+{
+#ifdef STATX_BASIC_STATS
+	struct statx stx;
+
+	/* NOTE: only the fields needed, cached values are fine on remote file systems */
+	if ( ( statx(dirfd, name, AT_STATX_DONT_SYNC, STATX_TYPE | STATX_SIZE | STATX_MTIME, &stx) < 0 ) ||
+		 ( !S_ISREG(stx.stx_mode) && !S_ISDIR(stx.stx_mode) ) )
+		return -1;
+
+	ent->isdir      = S_ISDIR(stx.stx_mode);
+	ent->info.size  = ( ent->isdir ? 0 : stx.stx_size );
+	ent->info.ts    = stx.stx_mtime.tv_sec;
+	ent->info.ts_ns = stx.stx_mtime.tv_nsec;
+#else
+	struct stat st;
+
+	if ( ( fstatat(dirfd, name, &st, 0) < 0 ) || ( !S_ISREG(st.st_mode) && !S_ISDIR(st.st_mode) ) )
+		return -1;
+
+	ent->isdir      = S_ISDIR(st.st_mode);
+	ent->info.size  = ( ent->isdir ? 0 : st.st_size );
+	ent->info.ts    = st.st_mtim.tv_sec;
+	ent->info.ts_ns = st.st_mtim.tv_nsec;
+#endif
+	ent->name = name;
+	return 0;
+}
+
+
+int
+walk_open(struct dir_walk *w, const char *root)
+{
+	memset(w, 0, sizeof(struct dir_walk));
+	w->curfd = -1;
+
+	if ( ( w->rootfd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC) ) < 0 )
+		return -1;
+
+	/* the root itself is walked first */
+	if ( ( w->todo = calloc(1, sizeof(struct walk_dir)) ) == NULL ||
+		 ( w->todo->path = strdup("") ) == NULL ) {
+		walk_close(w);
+		return -2;
+	}
+	w->last = w->todo;
+
+	return 0;
+}
+
+
+int
+walk_next(struct dir_walk *w, struct walk_entry *ent)
+{
+	struct walk_dir *d = NULL;
+	struct stat st;
+	const char *name = NULL;
+	int fd = 0;
+	int n  = 0;
+
+	for ( ; ; ) {
+
+		/* next directory */
+		if ( w->next == w->nents ) {
+			if ( w->curfd >= 0 )
+				close(w->curfd);
+			if ( w->cur != NULL ) {
+				free(w->cur->path);
+				free(w->cur);
+			}
+			w->curfd = -1;
+			w->cur   = NULL;
+
+			if ( ( w->cur = w->todo ) == NULL )
+				return 0;
+			if ( ( w->todo = w->cur->next ) == NULL )
+				w->last = NULL;
+
+			if ( ( w->curfd = openat(w->rootfd, ( w->cur->path[0] ? w->cur->path : "." ),
+									 O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC) ) < 0 )
+				w->nents = w->next = 0; // removed meanwhile, no permission...
+			else if ( ( n = read_entries(w) ) < 0 )
+				return n; // NOTE: an I/O error, the tree would be sent incomplete
+			continue;
+		}
+
+		name = w->names + w->ents[w->next++].name;
+
+		if ( ( n = snprintf(w->path, sizeof(w->path), "%s%s%s", w->cur->path,
+							( w->cur->path[0] ? "/" : "" ), name) ) >= (int) sizeof(w->path) )
+			continue;
+
+		/* NOTE: the entry is checked once opened, it could be replaced meanwhile */
+		if ( ( fd = openat(w->curfd, name, O_RDONLY | O_NOFOLLOW | O_NONBLOCK | O_CLOEXEC) ) < 0 )
+			continue;
+
+		if ( ( fstat(fd, &st) < 0 ) || ( !S_ISREG(st.st_mode) && !S_ISDIR(st.st_mode) ) ) {
+			close(fd);
+			continue;
+		}
+
+		ent->path       = w->path;
+		ent->isdir      = S_ISDIR(st.st_mode);
+		ent->info.size  = ( ent->isdir ? 0 : st.st_size );
+		ent->info.ts    = st.st_mtim.tv_sec;
+		ent->info.ts_ns = st.st_mtim.tv_nsec;
+		ent->fd         = -1;
+
+		if ( !ent->isdir ) {
+			ent->fd = fd;
+			return 1;
+		}
+
+		/* its entries, after the ones of this directory */
+		close(fd);
+		if ( ( d = calloc(1, sizeof(struct walk_dir)) ) == NULL || ( d->path = strdup(w->path) ) == NULL ) {
+			free(d);
+			return -2;
+		}
+		if ( w->last != NULL )
+			w->last->next = d;
+		else
+			w->todo = d;
+		w->last = d;
+
+		return 1;
+	}
+}
+
+
+void
+walk_close(struct dir_walk *w)
+{
+	struct walk_dir *d = NULL;
+
+	if ( w->rootfd >= 0 )
+		close(w->rootfd);
+	if ( w->curfd >= 0 )
+		close(w->curfd);
+
+	if ( w->cur != NULL ) {
+		free(w->cur->path);
+		free(w->cur);
+	}
+	while ( ( d = w->todo ) != NULL ) {
+		w->todo = d->next;
+		free(d->path);
+		free(d);
+	}
+
+	free(w->ents);
+	free(w->names);
+	memset(w, 0, sizeof(struct dir_walk));
+	w->rootfd = w->curfd = -1;
+}
+
+
+/**
+ * @brief Reads all the entries of the directory being walked, sorted by inode
+ *        (inodes near each other are near on disk, also their data)
+ *
+ * @return  0 if OK
+ * @return -1 on error reading the directory
+ * @return -2 on system error
+ */
+static int
+read_entries(struct dir_walk *w)
+{
+	struct linux_dirent64 *de = NULL;
+	struct walk_ent *ents = NULL;
+	uint8_t *buf = NULL;
+	char    *names = NULL;
+	size_t  len = 0;
+	long    n   = 0;
+	long    pos = 0;
+
+	w->nents = w->next = 0;
+	w->nlen  = 0;
+
+	if ( ( buf = malloc(DIR_BUF_LEN) ) == NULL )
+		return -2;
+
+	while ( ( n = syscall(SYS_getdents64, w->curfd, buf, DIR_BUF_LEN) ) > 0 ) {
+		for ( pos = 0; pos < n; pos += de->d_reclen ) {
+			de = (struct linux_dirent64 *) (buf + pos);
+
+			/* NOTE: symbolic links are never followed, they could lead out of the tree */
+			if ( ( strcmp(de->d_name, ".") == 0 ) || ( strcmp(de->d_name, "..") == 0 ) ||
+				 ( ( de->d_type != DT_REG ) && ( de->d_type != DT_DIR ) && ( de->d_type != DT_UNKNOWN ) ) )
+				continue;
+
+			len = strlen(de->d_name) + 1;
+
+			if ( w->nents == w->amax ) {
+				if ( ( ents = realloc(w->ents, ( w->amax + 1024 ) * 2 * sizeof(struct walk_ent)) ) == NULL )
+					goto sys_err;
+				w->ents = ents;
+				w->amax = ( w->amax + 1024 ) * 2;
+			}
+			if ( w->nlen + len > w->nsize ) {
+				if ( ( names = realloc(w->names, ( w->nsize + len + 16384 ) * 2) ) == NULL )
+					goto sys_err;
+				w->names = names;
+				w->nsize = ( w->nsize + len + 16384 ) * 2;
+			}
+
+			memcpy(w->names + w->nlen, de->d_name, len);
+			w->ents[w->nents].ino  = de->d_ino;
+			w->ents[w->nents].name = w->nlen;
+			w->nlen += len;
+			++(w->nents);
+		}
+	}
+
+	free(buf);
+
+	if ( n < 0 ) {
+		w->nents = 0;
+		return -1;
+	}
+
+	qsort(w->ents, w->nents, sizeof(struct walk_ent), cmp_ino);
+	return 0;
+
+sys_err:
+	free(buf);
+	w->nents = 0;
+	return -2;
+}
+
+
+static int
+cmp_ino(const void *a, const void *b)
+{
+	const struct walk_ent *x = a;
+	const struct walk_ent *y = b;
+
+	return ( x->ino > y->ino ) - ( x->ino < y->ino );
+}
@@ -0,0 +1,142 @@
+#ifndef _MYDIR_H
+#define _MYDIR_H
+
+#include <inttypes.h> // uint64_t
+#include <limits.h>   // PATH_MAX
+
+#include "myproto.h"  // struct proto_info
+
+/* DATA DEFINITION */
+
+#define DIR_BUF_LEN		(1 << 15)	// directory entries read with one system call
+
+/* directory being read */
+struct dir_reader {
+	int     fd;           // directory
+	char    *pattern;     // names to be listed (fnmatch() pattern), NULL for all
+	uint8_t *buf;         // raw entries (getdents64)
+	int     len;          // bytes in buf
+	int     pos;          // next entry in buf
+	int     end;          // all entries read
+};
+
+/* entry of a directory */
+struct dir_entry {
+	const char        *name;  // valid until the next dir_next()
+	int               isdir;  // directory (info.size is 0)
+	struct proto_info info;
+};
+
+/* directory of a tree still to be walked */
+struct walk_dir {
+	char            *path;    // relative to the root
+	struct walk_dir *next;
+};
+
+/* entry of the directory being walked */
+struct walk_ent {
+	uint64_t ino;
+	size_t   name;            // offset in names
+};
+
+/* tree being walked, one directory at a time */
+struct dir_walk {
+	int             rootfd;   // root of the tree
+	struct walk_dir *todo;    // directories still to be walked, in the order found
+	struct walk_dir *last;
+	struct walk_dir *cur;     // directory being walked
+	int             curfd;
+	struct walk_ent *ents;    // its entries, by inode
+	int             nents;
+	int             next;     // next entry
+	char            *names;   // names of the entries
+	size_t          nlen;     // bytes used in names
+	size_t          nsize;    // bytes allocated
+	int             amax;     // entries allocated
+	char            path[PATH_MAX]; // last entry, relative to the root
+};
+
+/* entry of a tree */
+struct walk_entry {
+	const char        *path;  // relative to the root, valid until the next walk_next()
+	int               isdir;  // directory (info.size is 0)
+	int               fd;     // regular file: opened for reading, to be closed by the caller
+	struct proto_info info;
+};
+
+/* FUNCTIONS */
+
+/**
+ * @brief Opens a directory to be read one entry at a time, without loading
+ *        it whole
+ *
+ * @param d             reader
+ * @param path          directory
+ * @param pattern       names to be listed (fnmatch() pattern), NULL for all
+ *
+ * @return  0 if OK
+ * @return -1 if the directory cannot be opened
+ * @return -2 on system error
+ */
+int dir_open(struct dir_reader *d, const char *path, const char *pattern);
+
+/**
+ * @brief Reads the next regular file or directory matching the pattern
+ *        (symbolic links are followed, "." and ".." are skipped)
+ *
+ * NOTE: entries are read in batches with getdents64(), their info is got
+ *       with statx() relative to the directory (no path lookup)
+ *
+ * @param d             reader
+ * @param ent           entry (output)
+ *
+ * @return  1 if OK
+ * @return  0 at the end of the directory
+ * @return -1 on error reading the directory
+ */
+int dir_next(struct dir_reader *d, struct dir_entry *ent);
+
+/**
+ * @brief Closes a directory
+ *
+ * @param d             reader
+ */
+void dir_close(struct dir_reader *d);
+
+/**
+ * @brief Opens a tree to be walked for disk locality: the entries of each
+ *        directory by inode, the subdirectories after it
+ *
+ * @param w             walk
+ * @param root          root directory
+ *
+ * @return  0 if OK
+ * @return -1 if the directory cannot be opened
+ * @return -2 on system error
+ */
+int walk_open(struct dir_walk *w, const char *root);
+
+/**
+ * @brief Gets the next regular file (opened) or directory of a tree; a
+ *        directory comes before its entries. Symbolic links and other file
+ *        types are skipped, as the entries whose path is too long and the
+ *        directories that cannot be opened.
+ *
+ * @param w             walk
+ * @param ent           entry (output)
+ *
+ * @return  1 if OK
+ * @return  0 at the end of the tree
+ * @return -1 on error reading a directory
+ * @return -2 on system error
+ */
+int walk_next(struct dir_walk *w, struct walk_entry *ent);
+
+/**
+ * @brief Ends a walk
+ *
+ * @param w             walk
+ */
+void walk_close(struct dir_walk *w);
+
+#endif
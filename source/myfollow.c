@@ -0,0 +1,102 @@
+/** ---------------------------------------------------------------------------
+ * Assignment - Watches on files being followed (FOLLOW)
+ *
+ * @author dcr
+ * ----------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/inotify.h>
+
+#include "myfollow.h"
+
+#define WATCH_EVENTS	(IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF)
+#define EVENT_BUF_LEN	(4096)
+
+/* a watched file, shared by its followers */
+struct watch {
+	int          wd;
+	int          refs;
+	struct watch *next;
+};
+
+static int          ifd     = -1;   // inotify instance
+static int          nwatch  = 0;    // nr. of watches
+static struct watch *watches = NULL;
+
+
+int
+follow_watch(const char *path)
+{
+	struct watch *w = NULL;
+	int wd = 0;
+
+	if ( ( ifd < 0 ) && ( ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC) ) < 0 )
+		return -1;
+
+	/* NOTE: the same file (inode) always gets the same watch */
+	if ( ( wd = inotify_add_watch(ifd, path, WATCH_EVENTS) ) < 0 )
+		return -1;
+
+	for ( w = watches; ( w != NULL ) && ( w->wd != wd ); w = w->next );
+
+	if ( w == NULL ) {
+		if ( ( w = calloc(1, sizeof(struct watch)) ) == NULL ) {
+			inotify_rm_watch(ifd, wd);
+			return -1;
+		}
+		w->wd   = wd;
+		w->next = watches;
+		watches = w;
+		++nwatch;
+	}
+
+	++(w->refs);
+	return wd;
+}
+
+
+void
+follow_unwatch(int wd)
+{
+	struct watch **p = NULL;
+	struct watch *w  = NULL;
+
+	for ( p = &watches; ( *p != NULL ) && ( (*p)->wd != wd ); p = &((*p)->next) );
+
+	if ( ( w = *p ) == NULL || --(w->refs) > 0 )
+		return;
+
+	inotify_rm_watch(ifd, wd); // fails if the file was removed, the watch is gone anyway
+	*p = w->next;
+	free(w);
+	--nwatch;
+}
+
+
+int
+follow_fd(void)
+{
+	return ifd;
+}
+
+
+int
+follow_active(void)
+{
+	return nwatch;
+}
+
+
+void
+follow_drain(void)
+{
+	char buf[EVENT_BUF_LEN] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+	if ( ifd < 0 )
+		return;
+
+	while ( ( read(ifd, buf, sizeof(buf)) > 0 ) || ( errno == EINTR ) );
+}
@@ -0,0 +1,53 @@
+#ifndef _MYFOLLOW_H
+#define _MYFOLLOW_H
+
+/* DATA DEFINITION */
+
+#define FOLLOW_TICK_MS		(100)	// idle timeouts are checked this often while following
+
+/* FUNCTIONS */
+
+/**
+ * @brief Watches a file being followed for appends, truncation, removal
+ *        (inotify, one instance per process)
+ *
+ * NOTE: a file watched many times has one watch, removed with the last
+ *       follow_unwatch()
+ *
+ * @param path          file name
+ *
+ * @return  the watch (> 0) if OK
+ * @return -1 on error
+ */
+int follow_watch(const char *path);
+
+/**
+ * @brief Stops watching a file
+ *
+ * @param wd            watch got from follow_watch()
+ */
+void follow_unwatch(int wd);
+
+/**
+ * @brief Descriptor to be selected for reading: readable when a watched file
+ *        changed
+ *
+ * @return  the inotify descriptor
+ * @return -1 if no file was ever watched
+ */
+int follow_fd(void);
+
+/**
+ * @brief Nr. of files watched (the server must wake up every FOLLOW_TICK_MS
+ *        while there are some)
+ *
+ * @return  nr. of watches
+ */
+int follow_active(void);
+
+/**
+ * @brief Discards the pending events (the followers check their files)
+ */
+void follow_drain(void);
+
+#endif
@@ -75,6 +75,7 @@ ssize_t
 Readn(int fd, void *ptr, size_t nbytes)
 {
 	ssize_t n = 0;
+	ssize_t r = 0;
 
 #ifndef MSG_WAITALL
 	if ( ( n = readn(fd, ptr, nbytes) ) < 0)
@@ -82,8 +83,19 @@ Readn(int fd, void *ptr, size_t nbytes)
 #else
 	if ( ( n = recv(fd, ptr, nbytes, MSG_WAITALL) ) < 0 )
 		err_ret("ERROR socket [%d]", fd);
+	else if ( ( n > 0 ) && ( (size_t) n < nbytes ) ) { // cut short by a signal, or the peer closing
+		if ( ( r = readn(fd, (char *) ptr + n, nbytes - n) ) < 0 ) {
+			err_ret("ERROR socket [%d]", fd);
+			return -1;
+		}
+		n += r;
+	}
 #endif // MSG_WAITALL
 
+	/* NOTE: the bytes read before the peer closed are not the whole message */
+	if ( ( n >= 0 ) && ( (size_t) n < nbytes ) )
+		n = 0;
+
 	if ( n == 0 )
 		err_msg("ERROR socket [%d]: Connection reset by peer.", fd);
 
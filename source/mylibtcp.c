@@ -1,6 +1,7 @@
 
 
 #include <stdlib.h>
+#include <stdint.h>     // uint64_t
 #include <unistd.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -8,6 +9,8 @@
 #include <sys/types.h>
 #include <sys/time.h>   // FD_SETSIZE (earlier standards)
 #include <sys/select.h> // FD_SETSIZE
+#include <time.h>       // clock_gettime()
+#include <poll.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netdb.h>
@@ -17,19 +20,44 @@
 #include "error.h"
 
 #define	LISTENQ			(FD_SETSIZE) // max queue length of pending connections
-#define SEL_TIMEOUT		(5)
+#define SEL_TIMEOUT		(5)   // s, connection attempts given up (after the last one started)
+#define CONN_STAGGER_MS	(250) // next address tried if none connected yet (RFC 8305)
+
+static void sort_addrs(struct addrinfo *res, struct addrinfo **addrs);
+static uint64_t now_ms(void);
 
 int
 tcp_connect(const char *host, const char *serv)
 {
 	int sockfd = 0;
+
+	if ( ( sockfd = tcp_try_connect(host, serv) ) < 0 )
+		exit(1);
+
+	return(sockfd);
+}
+
+
+int
+tcp_try_connect(const char *host, const char *serv)
+{
+	int sockfd = -1;
 	int n      = 0;
+	int naddrs = 0;
+	int next   = 0;  // next address to try
+	int active = 0;  // connections in progress
+	int err    = ETIMEDOUT;
+	int hurry  = 0;  // a connection failed: the next one is started at once
+	int i      = 0;
 	struct addrinfo *res     = NULL;
 	struct addrinfo *ressave = NULL;
+	struct addrinfo **addrs  = NULL;
 	struct addrinfo	hints;
+	struct pollfd   *pfd     = NULL;
+	uint64_t started = 0;  // last connection started
+	uint64_t now     = 0;
+	int64_t  wait    = 0;
 
-	fd_set wset;
-	struct timeval tv;
 	int result = 0;
 	socklen_t sltresult = sizeof(result);
 
@@ -37,93 +65,188 @@ tcp_connect(const char *host, const char *serv)
 	hints.ai_family = AF_UNSPEC;
 	hints.ai_socktype = SOCK_STREAM;
 
-	if ( ( n = getaddrinfo(host, serv, &hints, &res) ) != 0 )
-		err_quit("tcp_connect error for %s, %s: %s", host, serv, gai_strerror(n));
+	if ( ( n = getaddrinfo(host, serv, &hints, &res) ) != 0 ) {
+		err_msg("tcp_connect error for %s, %s: %s", host, serv, gai_strerror(n));
+		return -1;
+	}
 
 	ressave = res;
+	for ( ; res != NULL; res = res->ai_next )
+		++naddrs;
+
+	if ( ( ( addrs = calloc(naddrs, sizeof(struct addrinfo *)) ) == NULL ) ||
+		 ( ( pfd = calloc(naddrs, sizeof(struct pollfd)) ) == NULL ) )
+		err_sys("ERROR: could not allocate addresses");
+
+	sort_addrs(ressave, addrs);
+
+	/* when connecting, if an address is unreachable tcp timeout takes a very
+	 * long time, so the addresses are raced (RFC 8305, "happy eyeballs"):
+	 * - every connection is started in non-blocking mode
+	 * - the next address is tried if none connected within CONN_STAGGER_MS
+	 *   (at once if all the ones started failed)
+	 * - the first one connected is kept, the others are closed
+	 * - the ones started are waited for SEL_TIMEOUT after the last one
+	 * NOTE: before returning set the socket to blocking mode
+	 */
+	for ( ; ; ) {
+
+		now = now_ms();
+
+		/* start the next connection */
+		if ( ( next < naddrs ) && ( ( active == 0 ) || hurry || ( now >= started + CONN_STAGGER_MS ) ) ) {
+			res   = addrs[next++];
+			hurry = 0;
+
+			if ( ( pfd[active].fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol) ) < 0 ) {
+				err   = errno;
+				hurry = 1;
+				continue; /* ignore this one */
+			}
 
-	do {
-		sockfd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
-		if ( sockfd < 0 )
-			continue;	/* ignore this one */
-
-		/* when connecting, if server IP or port are wrong tcp timeout takes a
-		 * very long time, to reduce this time I manage directly the connection
-		 * timeout:
-		 * - set socket to non-blocking mode
-		 * - try to connect
-		 * - wait for SEL_TIMEOUT for connect result if it doesn't connect immediately
-		 * - after the timeout if socket is connected correctly return the socket
-		 *   otherwise try next address
-		 * NOTE: before returning set the socket to blocking mode
-		 */
-
-		/* set socket to non-blocking mode */
-		if ( fcntl(sockfd, F_SETFL, (fcntl(sockfd, F_GETFL, 0) | O_NONBLOCK)) < 0 ) {
-			close(sockfd);
-			err_quit("fcntl error");
-		}
-
-
-		/* try to connect */
-		n = connect(sockfd, res->ai_addr, res->ai_addrlen);
+			/* set socket to non-blocking mode */
+			if ( fcntl(pfd[active].fd, F_SETFL, (fcntl(pfd[active].fd, F_GETFL, 0) | O_NONBLOCK)) < 0 ) {
+				close(pfd[active].fd);
+				err_quit("fcntl error");
+			}
 
-		if ( n == 0 ) { // connect success
+			n = connect(pfd[active].fd, res->ai_addr, res->ai_addrlen);
+			if ( n == 0 ) { // connect success
+				sockfd = pfd[active++].fd;
+				break;
+			}
 
-			/* set back socket to blocking mode */
-			if ( fcntl(sockfd, F_SETFL, (fcntl(sockfd, F_GETFL, 0) & (~O_NONBLOCK))) < 0 ) {
-				close(sockfd);
-				err_quit("fcntl error");
+			if ( errno != EINPROGRESS ) { // connect error
+				err   = errno;
+				hurry = 1;
+				close(pfd[active].fd);
+				continue;
 			}
-			break; // success
 
-		} else if ( n < 0 && errno == EINPROGRESS ) { // connect error
+			pfd[active].events  = POLLOUT;
+			pfd[active].revents = 0;
+			++active;
+			started = now;
+		}
 
-			/* wait for SEL_TIMEOUT and check if socket correctly connected */
-			FD_ZERO(&wset);
-			FD_SET(sockfd, &wset);
-			tv.tv_sec  = SEL_TIMEOUT;
-			tv.tv_usec = 0;
+		if ( active == 0 ) {
+			if ( next < naddrs )
+				continue;
+			break; // all failed
+		}
 
-			if ( Select(sockfd+1, NULL, &wset, NULL, &tv) == 1 ) {
+		/* wait for a connection, until the next one is to be started or the last one gives up */
+		wait = (int64_t) ( started + ( next < naddrs ? CONN_STAGGER_MS : SEL_TIMEOUT * 1000 ) ) - (int64_t) now;
+		if ( ( wait <= 0 ) || ( hurry && ( next < naddrs ) ) ) {
+			if ( next < naddrs )
+				continue;
+			err = ETIMEDOUT;
+			break; // timeout
+		}
 
-				/* reset socket to blocking mode */
-				if ( fcntl(sockfd, F_SETFL, (fcntl(sockfd, F_GETFL, 0) & (~O_NONBLOCK))) < 0 ) {
-					close(sockfd);
-					err_quit("fcntl error");
-				}
+		if ( ( n = poll(pfd, active, (int) wait) ) < 0 ) {
+			if ( errno == EINTR )
+				continue;
+			err_sys("ERROR: poll failed");
+		}
 
-				/* check if socket is connected correctly */
-				result    = 1;
-				sltresult = sizeof(result);
-				if ( getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &result, &sltresult) < 0 ) {
-					close(sockfd);
-					err_quit("ERROR: could not read socket options");
-				}
+		/* check if sockets are connected correctly */
+		for ( i = 0; ( n > 0 ) && ( i < active ) && ( sockfd < 0 ); i++ ) {
+			if ( pfd[i].revents == 0 )
+				continue;
 
-				if ( result == 0 )
-					break; // success
+			result    = 1;
+			sltresult = sizeof(result);
+			if ( getsockopt(pfd[i].fd, SOL_SOCKET, SO_ERROR, &result, &sltresult) < 0 )
+				err_sys("ERROR: could not read socket options");
 
+			if ( result == 0 ) {
+				sockfd = pfd[i].fd;
+				break; // success
 			}
+
+			/* failed: the next address is tried at once */
+			err = result;
+			close(pfd[i].fd);
+			pfd[i--] = pfd[--active];
+			hurry    = 1;
 		}
 
-		// if ( connect(sockfd, res->ai_addr, res->ai_addrlen) == 0 )
-		// 	break;		/* success */
+		if ( sockfd >= 0 )
+			break;
+	}
 
-		close(sockfd);	/* ignore this one */
-	} while ( (res = res->ai_next) != NULL );
+	/* the other connections are cancelled */
+	for ( i = 0; i < active; i++ ) {
+		if ( pfd[i].fd != sockfd )
+			close(pfd[i].fd);
+	}
 
-	if ( res == NULL ) {	/* errno set from final connect() */
-		freeaddrinfo(ressave);
+	free(pfd);
+	free(addrs);
+	freeaddrinfo(ressave);
+
+	if ( sockfd < 0 ) {
+		errno = err;
+		err_ret("tcp_connect error for %s, %s", host, serv);
+		return -1;
+	}
+
+	/* set back socket to blocking mode */
+	if ( fcntl(sockfd, F_SETFL, (fcntl(sockfd, F_GETFL, 0) & (~O_NONBLOCK))) < 0 ) {
 		close(sockfd);
-		err_sys("tcp_connect error for %s, %s", host, serv);
+		err_quit("fcntl error");
 	}
-	freeaddrinfo(ressave);
 
 	return(sockfd);
 }
 
 
+/**
+ * @brief Orders the addresses to be tried: the families alternate, starting
+ *        from the first one of getaddrinfo() (RFC 8305, section 4)
+ */
+static void
+sort_addrs(struct addrinfo *res, struct addrinfo **addrs)
+{
+	struct addrinfo *first = res; // next address of the preferred family
+	struct addrinfo *other = res; // next address of the other families
+	int n = 0;
+
+	for ( ; ; ) {
+		while ( ( first != NULL ) && ( first->ai_family != res->ai_family ) )
+			first = first->ai_next;
+		while ( ( other != NULL ) && ( other->ai_family == res->ai_family ) )
+			other = other->ai_next;
+
+		if ( ( first == NULL ) && ( other == NULL ) )
+			return;
+
+		if ( first != NULL ) {
+			addrs[n++] = first;
+			first = first->ai_next;
+		}
+		if ( other != NULL ) {
+			addrs[n++] = other;
+			other = other->ai_next;
+		}
+	}
+}
+
+
+/**
+ * @brief Monotonic time in milliseconds
+ */
+static uint64_t
+now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
 int
 tcp_listen(const char *host, const char *serv, socklen_t *addrlenp)
 {
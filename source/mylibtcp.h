@@ -4,5 +4,6 @@
 
 int tcp_listen(const char *host, const char *serv, socklen_t *addrlenp);
 int	tcp_connect(const char *, const char *);
+int	tcp_try_connect(const char *host, const char *serv); // as tcp_connect(), -1 instead of exiting
 
 #endif
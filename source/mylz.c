@@ -0,0 +1,262 @@
+/** ---------------------------------------------------------------------------
+ * Assignment - LZ compression library
+ *
+ * @author dcr
+ * ----------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>  // htonl()
+
+#include "mylz.h"
+
+#define MINMATCH		(4)
+#define HASH_LOG		(13)
+#define MFLIMIT			(12)	// no match starts in the last 12 bytes..
+#define LASTLITERALS	(5)		// ..nor ends in the last 5
+#define SKIP_TRIGGER	(6)		// search faster after (1 << 6) misses
+
+static uint8_t *put_seq(uint8_t *op, const uint8_t *oend, const uint8_t *lit, int litlen,
+						int off, int mlen);
+static int get_len(const uint8_t **ip, const uint8_t *iend, int *len);
+
+
+static uint32_t
+read32(const uint8_t *p)
+{
+	uint32_t v = 0;
+
+	memcpy(&v, p, 4);
+	return v;
+}
+
+
+static uint32_t
+hash4(uint32_t v)
+{
+	return ( v * 2654435761u ) >> ( 32 - HASH_LOG );
+}
+
+
+int
+lz_compress(const uint8_t *src, int srclen, uint8_t *dst, int dstcap)
+{
+	uint16_t table[1 << HASH_LOG]; // last position of each hash
+
+	const uint8_t *ip     = src;
+	const uint8_t *anchor = src; // first literal not yet written
+	const uint8_t *iend   = src + srclen;
+	const uint8_t *ref    = NULL;
+	const uint8_t *m      = NULL;
+	uint8_t *op   = dst;
+	uint8_t *oend = dst + dstcap;
+	uint32_t h      = 0;
+	uint32_t misses = 0;
+
+	if ( srclen > LZ_BLOCK_MAX )
+		return 0;
+
+	memset(table, 0, sizeof(table));
+
+	while ( ( srclen > MFLIMIT ) && ( ip < iend - MFLIMIT ) ) {
+
+		h   = hash4(read32(ip));
+		ref = src + table[h];
+		table[h] = ip - src;
+
+		if ( ( ref >= ip ) || ( read32(ref) != read32(ip) ) ) {
+			ip += 1 + ( misses++ >> SKIP_TRIGGER );
+			continue;
+		}
+
+		/* extend the match */
+		for ( m = ip + MINMATCH; ( m < iend - LASTLITERALS ) && ( *m == ref[m - ip] ); m++ );
+
+		if ( ( op = put_seq(op, oend, anchor, ip - anchor, ip - ref, m - ip) ) == NULL )
+			return 0;
+
+		ip     = m;
+		anchor = ip;
+		misses = 0;
+	}
+
+	if ( ( op = put_seq(op, oend, anchor, iend - anchor, 0, 0) ) == NULL )
+		return 0;
+
+	return op - dst;
+}
+
+
+int
+lz_decompress(const uint8_t *src, int srclen, uint8_t *dst, int dstlen)
+{
+	const uint8_t *ip   = src;
+	const uint8_t *iend = src + srclen;
+	uint8_t *op   = dst;
+	uint8_t *oend = dst + dstlen;
+	int token = 0;
+	int len   = 0;
+	int off   = 0;
+	int i     = 0;
+
+	while ( ip < iend ) {
+
+		/* literals */
+		token = *ip++;
+		len   = token >> 4;
+		if ( ( get_len(&ip, iend, &len) < 0 ) || ( len > iend - ip ) || ( len > oend - op ) )
+			return -1;
+
+		memcpy(op, ip, len);
+		op += len;
+		ip += len;
+
+		if ( ip == iend )
+			break; // last sequence
+
+		/* match */
+		if ( iend - ip < 2 )
+			return -1;
+		off = ip[0] | ( ip[1] << 8 );
+		ip += 2;
+
+		len = token & 0x0f;
+		if ( ( get_len(&ip, iend, &len) < 0 ) || ( off == 0 ) || ( off > op - dst ) ||
+			 ( len + MINMATCH > oend - op ) )
+			return -1;
+		len += MINMATCH;
+
+		if ( off >= len )
+			memcpy(op, op - off, len);
+		else
+			for ( i = 0; i < len; i++ ) // overlapping: repeats the last 'off' bytes
+				op[i] = op[i - off];
+		op += len;
+	}
+
+	return op - dst;
+}
+
+
+int
+lz_block(const uint8_t *raw, int rawlen, uint8_t *out)
+{
+	uint32_t rl = htonl(rawlen);
+	uint32_t cl = 0;
+	int clen = 0;
+
+	/* stored if it does not compress */
+	if ( ( rawlen > 0 ) && ( clen = lz_compress(raw, rawlen, out + LZ_HDR_LEN, rawlen - 1) ) == 0 ) {
+		memcpy(out + LZ_HDR_LEN, raw, rawlen);
+		clen = rawlen;
+	}
+
+	cl = htonl(clen);
+	memcpy(out,   &rl, 4);
+	memcpy(out+4, &cl, 4);
+
+	return LZ_HDR_LEN + clen;
+}
+
+
+int
+lz_pack(FILE *in, FILE *out)
+{
+	uint8_t *raw = NULL;
+	uint8_t *blk = NULL;
+	size_t  n    = 0;
+	int     ret  = -1;
+
+	if ( ( raw = malloc(LZ_BLOCK_MAX) ) == NULL || ( blk = malloc(LZ_HDR_LEN + LZ_BLOCK_MAX) ) == NULL )
+		goto out;
+
+	do {
+		n = fread(raw, 1, LZ_BLOCK_MAX, in);
+		if ( ( n == 0 ) && ferror(in) )
+			goto out;
+
+		n = lz_block(raw, n, blk); // n == 0: end of stream
+		if ( fwrite(blk, 1, n, out) < n )
+			goto out;
+	} while ( n > LZ_HDR_LEN );
+
+	ret = 0;
+
+out:
+	free(raw);
+	free(blk);
+	return ret;
+}
+
+
+/**
+ * @brief Writes a sequence: token, literals, offset, match length
+ *
+ * @return  pointer to the end of the sequence if OK
+ * @return  NULL if it does not fit the output buffer
+ */
+static uint8_t *
+put_seq(uint8_t *op, const uint8_t *oend, const uint8_t *lit, int litlen, int off, int mlen)
+{
+	uint8_t *token = op;
+	int n = 0;
+
+	/* worst case: token, lengths, literals, offset */
+	if ( 1 + litlen/255 + 1 + litlen + 2 + mlen/255 + 1 > oend - op )
+		return NULL;
+
+	++op;
+	if ( litlen >= 15 ) {
+		*token = 15 << 4;
+		for ( n = litlen - 15; n >= 255; n -= 255 )
+			*op++ = 255;
+		*op++ = n;
+	} else
+		*token = litlen << 4;
+
+	memcpy(op, lit, litlen);
+	op += litlen;
+
+	if ( mlen == 0 )
+		return op; // last sequence
+
+	*op++ = off & 0xff;
+	*op++ = off >> 8;
+
+	mlen -= MINMATCH;
+	if ( mlen >= 15 ) {
+		*token |= 15;
+		for ( n = mlen - 15; n >= 255; n -= 255 )
+			*op++ = 255;
+		*op++ = n;
+	} else
+		*token |= mlen;
+
+	return op;
+}
+
+
+/**
+ * @brief Reads the extra bytes of a length (if its nibble is 15)
+ *
+ * @return  0 if OK
+ * @return -1 on format error
+ */
+static int
+get_len(const uint8_t **ip, const uint8_t *iend, int *len)
+{
+	int b = 255;
+
+	if ( *len != 15 )
+		return 0;
+
+	while ( b == 255 ) {
+		if ( ( *ip >= iend ) || ( *len > LZ_BLOCK_MAX ) )
+			return -1;
+		b     = *(*ip)++;
+		*len += b;
+	}
+
+	return 0;
+}
@@ -0,0 +1,75 @@
+#ifndef _MYLZ_H
+#define _MYLZ_H
+
+#include <stdio.h>    // FILE
+#include <inttypes.h> // uint8_t
+
+/**
+ * LZ COMPRESSED STREAMS
+ *
+ * A file is compressed in independent blocks of at most LZ_BLOCK_MAX bytes:
+ *
+ *     [ |R|{4} |C|{4} \* C bytes *\ ]* |0|{4} |0|{4}
+ *
+ * R raw length of the block, C compressed length (numbers in network byte
+ * order). A block that does not compress is stored as is (C == R). A block
+ * with R == 0 ends the stream.
+ *
+ * Blocks are LZ77 sequences (LZ4-like): a token (literals length in the high
+ * nibble, match length - 4 in the low one, 15 meaning that more length bytes
+ * follow), the literals, the match offset (2 bytes, little endian). The last
+ * sequence has only literals.
+ */
+#define LZ_BLOCK_MAX	(1 << 16)	// max raw block length
+#define LZ_HDR_LEN		(8)			// block header length
+#define LZ_SUFFIX		".lz"		// precompressed file: "<filename>.lz"
+
+/**
+ * @brief Compresses a block
+ *
+ * @param src           raw data
+ * @param srclen        raw data length (at most LZ_BLOCK_MAX)
+ * @param dst           output buffer
+ * @param dstcap        output buffer length
+ *
+ * @return  compressed length if OK
+ * @return  0 if it does not fit the output buffer
+ */
+int lz_compress(const uint8_t *src, int srclen, uint8_t *dst, int dstcap);
+
+/**
+ * @brief Decompresses a block
+ *
+ * @param src           compressed data
+ * @param srclen        compressed data length
+ * @param dst           output buffer
+ * @param dstlen        output buffer length
+ *
+ * @return  decompressed length if OK
+ * @return -1 on format error
+ */
+int lz_decompress(const uint8_t *src, int srclen, uint8_t *dst, int dstlen);
+
+/**
+ * @brief Encodes a stream block: header + compressed (or stored) data
+ *
+ * @param raw           raw data
+ * @param rawlen        raw data length (at most LZ_BLOCK_MAX, 0 ends the stream)
+ * @param out           output buffer (at least LZ_HDR_LEN + rawlen bytes)
+ *
+ * @return  the block length
+ */
+int lz_block(const uint8_t *raw, int rawlen, uint8_t *out);
+
+/**
+ * @brief Compresses a whole file as a stream
+ *
+ * @param in            file to compress (read from its current position)
+ * @param out           output file
+ *
+ * @return  0 if OK
+ * @return -1 on error
+ */
+int lz_pack(FILE *in, FILE *out);
+
+#endif
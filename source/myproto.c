@@ -0,0 +1,238 @@
+/** ---------------------------------------------------------------------------
+ * Assignment - Protocol extensions library
+ *
+ * @author dcr
+ * ----------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>      // isspace()
+#include <arpa/inet.h>  // htonl()
+
+#include "myproto.h"
+
+static const struct {
+	const char   *token;
+	unsigned int  feat;
+} feats_table[] = {
+	{ "MGET", FEAT_MGET },
+	{ "REST", FEAT_REST },
+	{ "X64",  FEAT_X64  },
+	{ "MUX",  FEAT_MUX  },
+	{ "COND", FEAT_COND },
+	{ "DELTA", FEAT_DELTA },
+	{ "LZ",   FEAT_LZ   },
+	{ "CRC",  FEAT_CRC  },
+	{ "NERR", FEAT_NERR },
+	{ "LIST", FEAT_LIST },
+	{ "FOLLOW", FEAT_FOLLOW },
+	{ "BNDL", FEAT_BNDL },
+	{ "REDIR", FEAT_REDIR },
+	{ "PRIO", FEAT_PRIO },
+	{ "RANGE", FEAT_RANGE },
+	{ NULL,   0         }
+};
+
+
+unsigned int
+proto_parse_feats(const char *tokens)
+{
+	unsigned int feats = 0;
+	size_t len = 0;
+	int i      = 0;
+
+	while ( tokens != NULL && *tokens != '\0' ) {
+
+		while ( isspace((unsigned char) *tokens) ) { ++tokens; }
+		for ( len = 0; tokens[len] != '\0' && !isspace((unsigned char) tokens[len]); len++ );
+
+		for ( i = 0; feats_table[i].token != NULL; i++ ) {
+			if ( ( strlen(feats_table[i].token) == len ) &&
+				 ( strncmp(feats_table[i].token, tokens, len) == 0 ) )
+				feats |= feats_table[i].feat;
+		}
+
+		tokens += len;
+	}
+
+	return feats;
+}
+
+
+int
+proto_fmt_feats(char *buf, size_t buflen, unsigned int feats)
+{
+	size_t len = 0;
+	int n      = 0;
+	int i      = 0;
+
+	if ( buflen > 0 )
+		buf[0] = '\0';
+
+	for ( i = 0; feats_table[i].token != NULL; i++ ) {
+		if ( !(feats & feats_table[i].feat) )
+			continue;
+
+		n = snprintf(buf + len, buflen - len, " %s", feats_table[i].token);
+		if ( n < 0 || (size_t) n >= buflen - len )
+			return -1;
+		len += n;
+	}
+
+	return len;
+}
+
+
+static void
+put_u64(uint8_t *buf, uint64_t v)
+{
+	uint32_t hi = htonl(v >> 32);
+	uint32_t lo = htonl(v & 0xffffffffu);
+
+	memcpy(buf,   &hi, 4);
+	memcpy(buf+4, &lo, 4);
+}
+
+
+static uint64_t
+get_u64(const uint8_t *buf)
+{
+	uint32_t hi = 0;
+	uint32_t lo = 0;
+
+	memcpy(&hi, buf,   4);
+	memcpy(&lo, buf+4, 4);
+
+	return ( ((uint64_t) ntohl(hi)) << 32 ) | ntohl(lo);
+}
+
+
+static void
+put_u32(uint8_t *buf, uint32_t v)
+{
+	v = htonl(v);
+	memcpy(buf, &v, 4);
+}
+
+
+static uint32_t
+get_u32(const uint8_t *buf)
+{
+	uint32_t v = 0;
+
+	memcpy(&v, buf, 4);
+	return ntohl(v);
+}
+
+
+int
+proto_info_len(unsigned int feats)
+{
+	return ( feats & FEAT_X64 ? PROTO_INFO_LEN_X64 : PROTO_INFO_LEN );
+}
+
+
+int
+proto_off_len(unsigned int feats)
+{
+	return ( feats & FEAT_X64 ? 8 : 4 );
+}
+
+
+int
+proto_put_info(uint8_t *buf, const struct proto_info *info, unsigned int feats)
+{
+	if ( feats & FEAT_X64 ) {
+		put_u64(buf,    info->size);
+		put_u64(buf+8,  info->ts);
+		put_u32(buf+16, info->ts_ns);
+		return PROTO_INFO_LEN_X64;
+	}
+
+	if ( ( info->size > UINT32_MAX ) || ( info->ts > UINT32_MAX ) )
+		return -1; // file size > 4GB or timestamp > uint32_t max value
+
+	put_u32(buf,   info->size);
+	put_u32(buf+4, info->ts);
+	return PROTO_INFO_LEN;
+}
+
+
+int
+proto_get_info(const uint8_t *buf, struct proto_info *info, unsigned int feats)
+{
+	if ( feats & FEAT_X64 ) {
+		info->size  = get_u64(buf);
+		info->ts    = get_u64(buf+8);
+		info->ts_ns = get_u32(buf+16);
+		return PROTO_INFO_LEN_X64;
+	}
+
+	info->size  = get_u32(buf);
+	info->ts    = get_u32(buf+4);
+	info->ts_ns = PROTO_NS_ANY;
+	return PROTO_INFO_LEN;
+}
+
+
+int
+proto_put_off(uint8_t *buf, uint64_t off, unsigned int feats)
+{
+	if ( feats & FEAT_X64 ) {
+		put_u64(buf, off);
+		return 8;
+	}
+
+	if ( off > UINT32_MAX )
+		return -1;
+
+	put_u32(buf, off);
+	return 4;
+}
+
+
+int
+proto_get_off(const uint8_t *buf, uint64_t *off, unsigned int feats)
+{
+	if ( feats & FEAT_X64 ) {
+		*off = get_u64(buf);
+		return 8;
+	}
+
+	*off = get_u32(buf);
+	return 4;
+}
+
+
+void
+proto_put_frame(uint8_t *buf, uint32_t stream, int flags, int len)
+{
+	put_u32(buf, stream);
+	buf[4] = flags;
+	buf[5] = ( len >> 8 ) & 0xff;
+	buf[6] = len & 0xff;
+}
+
+
+int
+proto_get_frame(const uint8_t *buf, uint32_t *stream, int *flags, int *len)
+{
+	*stream = get_u32(buf);
+	*flags  = buf[4];
+	*len    = ( buf[5] << 8 ) | buf[6];
+
+	return ( *len > MUX_FRAME_MAX ? -1 : 0 );
+}
+
+
+const char *
+proto_strstatus(int status)
+{
+	switch ( status ) {
+		case PROTO_ST_OK:		return "OK";
+		case PROTO_ST_NOTFOUND:	return "file not found";
+		case PROTO_ST_TOOBIG:	return "file too big";
+		case PROTO_ST_IOERR:	return "cannot read file";
+		default:				return "unknown error";
+	}
+}
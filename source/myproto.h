@@ -0,0 +1,434 @@
+#ifndef _MYPROTO_H
+#define _MYPROTO_H
+
+#include <stddef.h>   // size_t
+#include <inttypes.h> // uint64_t
+#include <limits.h>   // NAME_MAX
+
+/**
+ * PROTOCOL EXTENSIONS
+ *
+ * As its first command a client may send the list of extensions it would like
+ * to use:
+ *
+ *     |F|E|A|T| \* [ |SP| token ]* *\ |CR|LF|
+ *
+ * the server replies with the ones it accepted (possibly none):
+ *
+ *     |+|O|K| \* [ |SP| token ]* *\ |CR|LF|
+ *
+ * A server implementing only the plain protocol replies "-ERR" and closes the
+ * connection: the client must reconnect and use plain GET requests.
+ */
+
+/* extensions (FEAT tokens) */
+#define FEAT_MGET		(1u << 0)	// "MGET": batch request with manifest
+#define FEAT_REST		(1u << 1)	// "REST": resume a transfer from an offset
+#define FEAT_X64		(1u << 2)	// "X64": 64-bit sizes and timestamps
+#define FEAT_MUX		(1u << 3)	// "MUX": replies interleaved in framed streams
+#define FEAT_COND		(1u << 4)	// "COND": send a file only if it changed
+#define FEAT_DELTA		(1u << 5)	// "DELTA": send only the changes to a file
+#define FEAT_LZ			(1u << 6)	// "LZ": compressed file content
+#define FEAT_CRC		(1u << 7)	// "CRC": checksum after file content
+#define FEAT_NERR		(1u << 8)	// "NERR": errors about a file keep the connection
+#define FEAT_LIST		(1u << 9)	// "LIST": directory manifests
+#define FEAT_FOLLOW		(1u << 10)	// "FOLLOW": growing files sent in chunks
+#define FEAT_BNDL		(1u << 11)	// "BNDL": directory trees sent as one archive
+#define FEAT_REDIR		(1u << 12)	// "REDIR": busy servers send clients to a peer
+#define FEAT_PRIO		(1u << 13)	// "PRIO": priority class of the requests
+#define FEAT_RANGE		(1u << 14)	// "RANGE": byte ranges of a file
+
+#define FEAT_ALL		(FEAT_MGET | FEAT_REST | FEAT_X64 | FEAT_MUX | FEAT_COND | FEAT_DELTA | \
+						 FEAT_LZ | FEAT_CRC | FEAT_NERR | FEAT_LIST | FEAT_FOLLOW | \
+						 FEAT_BNDL | FEAT_REDIR | FEAT_PRIO | FEAT_RANGE)
+
+#define PROTO_LINE_MAX	(NAME_MAX+64)	// max command line length (CR LF excluded)
+
+/**
+ * FILE INFO
+ *
+ * Replies describe a file with its size and timestamp: by default
+ *
+ *     |B1|B2|B3|B4|T1|T2|T3|T4|
+ *
+ * as in the plain protocol. With FEAT_X64 sizes and timestamps are 64 bits
+ * wide and the timestamp has nanoseconds precision:
+ *
+ *     |B|{8} |T|{8} |N|{4}
+ *
+ * Offsets in replies have the same width as sizes (4 or 8 bytes). Timestamps
+ * in commands are decimal seconds, optionally followed by '.' and nanoseconds.
+ */
+#define PROTO_INFO_LEN		(8)		// file info length (plain)
+#define PROTO_INFO_LEN_X64	(20)	// file info length (FEAT_X64)
+#define PROTO_NS_ANY		(UINT32_MAX)	// nanoseconds not specified
+
+struct proto_info {
+	uint64_t size;		// file size
+	uint64_t ts;		// last modification timestamp (Unix time)
+	uint32_t ts_ns;		// timestamp nanoseconds
+};
+
+/**
+ * MGET (FEAT_MGET)
+ *
+ *     |M|G|E|T| |N| |CR|LF| [ \* filename *\ |CR|LF| ]{N}
+ *
+ * the server replies with a manifest followed by the content of the files:
+ *
+ *     |+|O|K|CR|LF|N1|N2|N3|N4| [ |I|{4} |S| \* file info *\ ]{N} \* contents *\
+ *
+ * one entry per requested file: I index of the file in the request, S status
+ * and file info (all in network byte order). The server may list files
+ * in any order, e.g. by disk locality: contents follow in manifest order, only
+ * for files with status PROTO_ST_OK.
+ */
+#define MGET_MAX		(1024)		// max files in a MGET request
+#define MGET_ENTRY_HDR	(5)			// manifest entry length (file info excluded)
+
+/**
+ * RGET (FEAT_REST)
+ *
+ *     |R|G|E|T| |offset| |size| |timestamp| | \* filename *\ |CR|LF|
+ *
+ * (decimal numbers) requests a file from 'offset', provided that its size and
+ * timestamp are still the ones the client got when the transfer started. The
+ * server replies:
+ *
+ *     |+|O|K|CR|LF| \* file info *\ |O1|O2|O3|O4| \* file content *\
+ *
+ * O is the offset the content starts from: 0 (whole file) if the file changed
+ * since the partial transfer.
+ */
+
+/**
+ * CGET (FEAT_COND)
+ *
+ *     |C|G|E|T| |size| |timestamp| | \* filename *\ |CR|LF|
+ *
+ * requests a file only if its size or timestamp differ from the ones of the
+ * client's copy. If they don't the server replies
+ *
+ *     |=|O|K|CR|LF|
+ *
+ * (not modified), otherwise it replies as to a GET request.
+ */
+
+/**
+ * DGET (FEAT_DELTA)
+ *
+ *     |D|G|E|T| |size| |timestamp| |block| | \* filename *\ |CR|LF| \* signatures *\
+ *
+ * requests the changes to a file: size and timestamp are the ones of the
+ * client's copy, followed by the signatures of its size / block full blocks
+ * (see mydelta.h). The server replies "=OK" if the copy is up to date, "-ERR"
+ * if the file does not exist, otherwise:
+ *
+ *     |+|O|K|CR|LF| \* file info *\ |D1|D2|D3|D4| \* delta *\
+ *
+ * D is the length of the delta (as an offset, 4 or 8 bytes).
+ */
+
+/**
+ * LZ (FEAT_LZ)
+ *
+ * The content of the files sent in reply to GET and CGET is a compressed
+ * stream (see mylz.h), the file info is the one of the uncompressed file.
+ * Other replies (RGET, DGET, MGET) are not compressed.
+ */
+
+/**
+ * CRC (FEAT_CRC)
+ *
+ * The content of every file sent (or its delta, or its compressed stream) is
+ * followed by
+ *
+ *     |K1|K2|K3|K4|
+ *
+ * the CRC32C of the whole file (not only of the bytes sent, e.g. after an
+ * offset; a PGET range is the exception), in network byte order.
+ */
+#define PROTO_CRC_LEN	(4)
+
+/**
+ * NERR (FEAT_NERR)
+ *
+ * A file request (GET, RGET, CGET, DGET) that cannot be served because of
+ * the file (missing, not readable, too big...) is replied
+ *
+ *     |-|N|O|K|CR|LF| |S|
+ *
+ * S status (PROTO_ST_*), and the connection stays open. "-ERR" is only sent
+ * for protocol violations (e.g. an unknown command), and the server closes
+ * the connection. With MUX the reply is the payload of the request stream.
+ */
+#define PROTO_NOK_LEN	(7)
+
+/**
+ * LIST (FEAT_LIST)
+ *
+ *     |L|I|S|T| | \* path *\ |CR|LF|
+ *
+ * lists a directory, or the names in a directory matching a pattern when the
+ * last component of the path has '*', '?' or '[' ("logs/2024-*.gz", "*.c").
+ * The server replies with a manifest, built while it is sent:
+ *
+ *     |+|O|K|CR|LF| [ |L| \* name *\ |F| \* file info *\ [ |C|{4} ] ]* |0|
+ *
+ * one entry per regular file or directory, in directory order: L name length
+ * (1-255), F flags (PROTO_LIST_*), file info as in a GET reply (size 0 for
+ * a directory, 0 and 0 if it does not fit, PROTO_LIST_TOOBIG). With CRC the
+ * entry of a file whose checksum is known to the server (it is not computed)
+ * has PROTO_LIST_CRC and is followed by it. L == 0 ends the manifest. A path
+ * that is not a directory is replied as a missing file.
+ */
+#define PROTO_LIST_DIR		(0x01)	// directory
+#define PROTO_LIST_CRC		(0x02)	// followed by the file checksum
+#define PROTO_LIST_TOOBIG	(0x04)	// file info does not fit (no X64)
+#define PROTO_LIST_ENTRY_MAX	(1 + NAME_MAX + 1 + PROTO_INFO_LEN_X64 + PROTO_CRC_LEN)
+
+/**
+ * FOLLOW (FEAT_FOLLOW)
+ *
+ *     |F|G|E|T| |offset| |limit| |idle| | \* filename *\ |CR|LF|
+ *
+ * (decimal numbers) sends a file from 'offset', then the bytes appended to
+ * it as they are written, until the end condition: 'limit' bytes sent (0 for
+ * no limit), nothing appended for 'idle' milliseconds (0 to wait forever),
+ * a STOP command, or the file truncated, replaced or removed. The server
+ * replies:
+ *
+ *     |+|O|K|CR|LF| \* file info *\ |O1|O2|O3|O4| [ |L|{4} \* L bytes *\ ]* |0|{4} |R|
+ *
+ * file info when the request is served, O the offset the chunks start from
+ * (0 if the file is shorter than 'offset'), then chunks of data (L > 0) and
+ * the end of the reply: L == 0 and R the reason (PROTO_FOLLOW_*). There is no
+ * checksum (CRC) nor compression (LZ).
+ *
+ *     |S|T|O|P|CR|LF|   or   |S|T|O|P| |stream| |CR|LF|
+ *
+ * ends the oldest FGET being served (with MUX: the one of the stream given).
+ * STOP has no reply of its own, and does not open a stream (MUX).
+ */
+#define PROTO_FOLLOW_LIMIT	(0)		// 'limit' bytes sent
+#define PROTO_FOLLOW_IDLE	(1)		// nothing appended for 'idle' ms
+#define PROTO_FOLLOW_STOP	(2)		// STOP received
+#define PROTO_FOLLOW_GONE	(3)		// file truncated, replaced or removed
+#define PROTO_CHUNK_HDR		(4)		// chunk header length
+
+/**
+ * BNDL (FEAT_BNDL)
+ *
+ *     |B|N|D|L| | \* directory *\ |CR|LF|
+ *
+ * sends a directory tree as one archive, built while it is sent. The server
+ * replies:
+ *
+ *     |+|O|K|CR|LF| [ |T| |L1|L2| \* path *\ \* file info *\ [ \* data *\ [ |C|{4} ] ] ]* |0|
+ *
+ * one entry per regular file or directory: T type (PROTO_BNDL_*), L path
+ * length (1-PATH_MAX), path relative to the directory ('/' separated, no "."
+ * nor ".." components), file info as in a GET reply (size 0 for a directory).
+ * A file entry is followed by 'size' bytes of data and, with CRC, by its
+ * checksum. A directory comes before its entries; the entries of a directory
+ * are sent in inode order (disk locality), its subdirectories after them.
+ * Symbolic links, special files and files whose info does not fit (no X64)
+ * are not sent. A file that shrinks while sent is padded with zeros, and its
+ * checksum is wrong. T == 0 ends the archive. A path that is not a directory
+ * is replied as a missing file.
+ */
+#define PROTO_BNDL_END		(0)
+#define PROTO_BNDL_FILE		(1)
+#define PROTO_BNDL_DIR		(2)
+#define PROTO_BNDL_HDR_MAX	(1 + 2 + PATH_MAX + PROTO_INFO_LEN_X64 + PROTO_CRC_LEN)
+
+/**
+ * REDIR (FEAT_REDIR)
+ *
+ * A server with too many clients may send a new client to a peer instead of
+ * serving it. If the client offered REDIR the reply to FEAT is
+ *
+ *     |>| \* host *\ |SP| \* port *\ |CR|LF|
+ *
+ * and the connection is closed: the client connects to the peer and starts
+ * again with FEAT. A client that was redirected many times does not offer
+ * REDIR any more, so that it is served by the next server.
+ */
+
+/**
+ * PRIO (FEAT_PRIO)
+ *
+ *     |P|R|I|O| |class|CR|LF|
+ *
+ * (decimal) sets the priority class (PROTO_PRIO_*) of the next requests on
+ * the connection, PROTO_PRIO_NORMAL until the first PRIO. PRIO has no reply
+ * and does not open a stream (MUX). With MUX the streams of the highest class
+ * are served first (round robin among them), the others when they are done
+ * or wait; without MUX the replies keep the order of the requests. Among
+ * connections the ones with requests of a higher class are served first, the
+ * others get the bandwidth left, and the packets of a connection are marked
+ * with the class of its last PRIO (IP TOS and socket priority).
+ */
+#define PROTO_PRIO_INTERACTIVE	(0)		// latency first
+#define PROTO_PRIO_NORMAL		(1)
+#define PROTO_PRIO_BULK			(2)		// bandwidth left by the others
+#define PROTO_PRIO_LEVELS		(3)
+
+/**
+ * RANGE (FEAT_RANGE)
+ *
+ *     |P|G|E|T| |offset| |length| | \* filename *\ |CR|LF|
+ *
+ * (decimal numbers) requests 'length' bytes of a file from 'offset', so that
+ * a client can fetch the ranges of a large file over many connections. The
+ * server replies:
+ *
+ *     |+|O|K|CR|LF| \* file info *\ |O1|O2|O3|O4| \* range content *\
+ *
+ * file info when the request is served, O the offset the content starts from
+ * (the file size if the file is shorter than 'offset'), then min(length,
+ * size - O) bytes. The client tells that the file changed between ranges
+ * from the file info. With CRC the content is followed by the CRC32C of the
+ * range, not of the whole file. The content is never compressed (LZ).
+ */
+
+/* longest reply header: |+|O|K|CR|LF| + file info + offset */
+#define PROTO_REPLY_HDR_MAX	(5 + PROTO_INFO_LEN_X64 + 8)
+
+/**
+ * MUX (FEAT_MUX)
+ *
+ * Every command after FEAT opens a stream, whose id is the sequence number of
+ * the command on the connection (FEAT is 0, the next command 1 and so on).
+ * Replies are sent in frames, so that the server can interleave the replies
+ * to many commands:
+ *
+ *     |I1|I2|I3|I4|F|L1|L2| \* L bytes of the reply *\
+ * I stream id, F flags (MUX_FIN on the last frame of a reply), L payload
+ * length (at most MUX_FRAME_MAX). The replies are the ones of the plain
+ * protocol, but a "-ERR" reply to a file request only ends its stream. Errors
+ * that close the connection are sent on stream MUX_STREAM_CONN.
+ */
+#define MUX_HDR_LEN		(7)			// frame header length
+#define MUX_FRAME_MAX	(16384)		// max frame payload
+#define MUX_FIN			(0x01)		// last frame of a reply
+#define MUX_STREAM_CONN	(0)			// connection errors (FEAT stream)
+
+/* per-file status codes */
+#define PROTO_ST_OK			(0)
+#define PROTO_ST_NOTFOUND	(1)		// file does not exist or is not readable
+#define PROTO_ST_TOOBIG		(2)		// file size or timestamp do not fit the header
+#define PROTO_ST_IOERR		(3)		// file could not be read
+
+/**
+ * @brief Parses a list of space separated FEAT tokens
+ *
+ * @param tokens        the tokens list ('\0' terminated)
+ *
+ * @return  the extensions mask (unknown tokens are ignored)
+ */
+unsigned int proto_parse_feats(const char *tokens);
+
+/**
+ * @brief Formats an extensions mask as a list of FEAT tokens
+ *
+ * NOTE: each token is preceded by a space, e.g. " MGET"
+ *
+ * @param buf           output buffer
+ * @param buflen        output buffer length
+ * @param feats         extensions mask
+ *
+ * @return  the length of the list if OK
+ * @return  -1 if buffer is too small
+ */
+int proto_fmt_feats(char *buf, size_t buflen, unsigned int feats);
+
+/**
+ * @brief Length of file info with the negotiated extensions
+ *
+ * @param feats         extensions mask
+ *
+ * @return  the length
+ */
+int proto_info_len(unsigned int feats);
+
+/**
+ * @brief Length of offsets with the negotiated extensions
+ *
+ * @param feats         extensions mask
+ *
+ * @return  the length
+ */
+int proto_off_len(unsigned int feats);
+
+/**
+ * @brief Writes file info in network byte order
+ *
+ * @param buf           output buffer (at least proto_info_len() bytes)
+ * @param info          file info
+ * @param feats         extensions mask
+ *
+ * @return  the length of file info if OK
+ * @return  -1 if size or timestamp do not fit (no FEAT_X64)
+ */
+int proto_put_info(uint8_t *buf, const struct proto_info *info, unsigned int feats);
+
+/**
+ * @brief Reads file info in network byte order
+ *
+ * @param buf           input buffer (at least proto_info_len() bytes)
+ * @param info          file info
+ * @param feats         extensions mask
+ *
+ * @return  the length of file info
+ */
+int proto_get_info(const uint8_t *buf, struct proto_info *info, unsigned int feats);
+
+/**
+ * @brief Writes an offset in network byte order
+ *
+ * @return  the length of the offset if OK
+ * @return  -1 if it does not fit (no FEAT_X64)
+ */
+int proto_put_off(uint8_t *buf, uint64_t off, unsigned int feats);
+
+/**
+ * @brief Reads an offset in network byte order
+ *
+ * @return  the length of the offset
+ */
+int proto_get_off(const uint8_t *buf, uint64_t *off, unsigned int feats);
+
+/**
+ * @brief Writes a MUX frame header
+ *
+ * @param buf           output buffer (at least MUX_HDR_LEN bytes)
+ * @param stream        stream id
+ * @param flags         frame flags (MUX_FIN)
+ * @param len           payload length
+ */
+void proto_put_frame(uint8_t *buf, uint32_t stream, int flags, int len);
+
+/**
+ * @brief Reads a MUX frame header
+ *
+ * @param buf           input buffer (at least MUX_HDR_LEN bytes)
+ * @param stream        stream id (output)
+ * @param flags         frame flags (output)
+ * @param len           payload length (output)
+ *
+ * @return  0 if OK
+ * @return -1 if payload is longer than MUX_FRAME_MAX
+ */
+int proto_get_frame(const uint8_t *buf, uint32_t *stream, int *flags, int *len);
+
+/**
+ * @brief Describes a per-file status code
+ *
+ * @param status        status code
+ *
+ * @return  the description
+ */
+const char *proto_strstatus(int status);
+
+#endif
@@ -0,0 +1,2247 @@
+/** ---------------------------------------------------------------------------
+ * Assignment - Requests serving library (shared by server1 and server2)
+ *
+ * @author dcr
+ * ----------------------------------------------------------------------------
+ */
+#define _FILE_OFFSET_BITS 64 // files > 2GB on 32-bit systems
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <ctype.h>      // isdigit()
+#include <errno.h>      // errno
+#include <fcntl.h>      // open()
+#include <limits.h>     // NAME_MAX
+#include <netinet/in.h> // htonl()
+#include <netinet/ip.h> // IPTOS_LOWDELAY
+#include <netdb.h>      // NI_MAXHOST
+#include <sys/stat.h>   // struct stat
+#include <sys/mman.h>   // mmap()
+#include <sys/select.h> // FD_SETSIZE
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/xattr.h>  // getxattr()
+#include <time.h>       // clock_gettime()
+
+#include "error.h"
+#include "mylibsock.h"
+#include "myclients.h"
+#include "myproto.h"
+#include "mydelta.h"
+#include "mylz.h"
+#include "mycache.h"
+#include "mycrc.h"
+#include "mydir.h"
+#include "myfollow.h"
+#include "myserve.h"
+
+#define OK_LEN			(5)  // |+|O|K|CR|LF|
+#define MUX_ACTIVE_MAX	(32) // max streams served at the same time (open files)
+#define LZ_CACHE_FILE_MAX	(8 << 20) // files up to 8MB are compressed at once and cached
+
+/* LZ: buffer of a file compressed while sent, block + end of stream + raw block */
+#define LZ_ZRAW_OFF		(2*LZ_HDR_LEN + LZ_BLOCK_MAX)
+#define LZ_ZBUF_LEN		(LZ_ZRAW_OFF + LZ_BLOCK_MAX)
+
+/* CRC: checksums are also kept in an extended attribute of the file:
+ * |K|{4} + file info (X64), so that they survive restarts */
+#ifndef CRC_XATTR
+#define CRC_XATTR		(1)
+#endif
+#define CRC_XATTR_NAME	"user.dp1.crc32c"
+#define CRC_XATTR_LEN	(PROTO_CRC_LEN + PROTO_INFO_LEN_X64)
+
+#define LIST_ZBUF_LEN	(1 << 14) // manifest entries built at a time
+#define BNDL_ZBUF_LEN	(1 << 16) // archive bytes built at a time
+
+/* REDIR: peers busy servers send clients to */
+struct peer {
+	char host[NI_MAXHOST];
+	char serv[NI_MAXSERV];
+};
+
+static struct peer peers[REDIR_PEERS_MAX];
+static int         npeers    = 0;
+static int         next_peer = 0;
+
+struct mget_entry {
+	char        *filename;
+	uint32_t    idx;        // index in request
+	int         status;     // PROTO_ST_*
+	struct stat st;
+	struct proto_info info;
+};
+
+static int read_line(int sock, char *buf, int buflen);
+static int serve_feat(int client_socket, struct sclient *client);
+static int serve_mget(int client_socket, struct sclient *client);
+static int serve_rget(int client_socket, struct sclient *client);
+static int serve_cget(int client_socket, struct sclient *client);
+static int serve_pget(int client_socket, struct sclient *client);
+static int same_file(const struct proto_info *info, const struct proto_info *known);
+static int parse_u64(char **str, uint64_t *val);
+static int parse_ts(char **str, struct proto_info *info);
+static void stat_to_info(const struct stat *sfile, struct proto_info *info);
+static int cmp_mget_entry(const void *a, const void *b);
+static int fill_reply(struct sclient *client, uint8_t *buf, int buflen);
+static int fill_frames(struct sclient *client, uint8_t *buf, int buflen);
+static struct sfiles *next_stream_client(struct sclient *client);
+static int read_req(struct sclient *client, struct sfiles *req, uint8_t *buf, int buflen);
+static int add_file_err_client(struct sclient *client, int status);
+static int serve_dget(int client_socket, struct sclient *client);
+static FILE *make_delta(struct sfiles *req, uint64_t *len);
+static int lz_open(struct sfiles *req, const struct proto_info *info);
+static int lz_refill(struct sfiles *req);
+static int lz_read(struct sfiles *req, uint8_t *buf, int buflen);
+static int req_done(const struct sfiles *req);
+static int crc_open(struct sfiles *req, int stream);
+static int crc_lookup(const char *path, const struct proto_info *info, uint32_t *crc);
+static int crc_peek(const char *path, const struct proto_info *info, uint32_t *crc);
+static int crc_xattr(const char *path, const struct proto_info *info, uint32_t *crc);
+static void crc_cache(const char *path, const struct proto_info *info, uint32_t crc);
+static void crc_store(const char *path, const struct proto_info *info, uint32_t crc);
+static int put_trailer(struct sfiles *req, uint8_t *buf, int buflen);
+static int serve_list(int client_socket, struct sclient *client);
+static int list_open(struct sfiles *req);
+static int list_refill(struct sclient *client, struct sfiles *req);
+static int list_read(struct sclient *client, struct sfiles *req, uint8_t *buf, int buflen);
+static int serve_fget(int client_socket, struct sclient *client);
+static int serve_stop(int client_socket, struct sclient *client);
+static int follow_open(struct sfiles *req);
+static int follow_read(struct sfiles *req, uint8_t *buf, int buflen);
+static uint64_t now_ms(void);
+static int serve_bndl(int client_socket, struct sclient *client);
+static int bndl_open(struct sfiles *req);
+static int bndl_refill(struct sclient *client, struct sfiles *req);
+static int serve_prio(int client_socket, struct sclient *client);
+
+
+int
+serve_client_rd(int client_socket,
+				struct sclient *client)
+{
+	char inbuf[PROTO_LINE_MAX+1];
+	int  fnlen = 0; // filename length
+
+	/* read data from client */
+	if ( (Readn(client_socket, inbuf, 4)) <= 0 )
+		return -1;
+
+	++(client->nrequests);
+
+	/* identify command received */
+	if ( strncmp((char*) inbuf, "QUIT", 4) == 0 ) {
+		Readn(client_socket, inbuf, 2); // consume '\r\n'
+		return 2;
+	}
+
+	if ( strncmp(inbuf, "GET ", 4) == 0 ) {
+
+		/* get file name */
+		if ( ( fnlen = read_line(client_socket, inbuf, NAME_MAX+2) ) == -1 )
+			return -1;
+
+		/* if file exists add it to files waiting to be uploaded */
+		if ( ( fnlen > 0 ) && ( access(inbuf, F_OK) != -1 ) ) {
+			if ( ( add_file_client(inbuf, fnlen, client) ) < 0 )
+				client->sendError = 1;
+			return 0;
+		}
+
+		/* notify user 'file not found' (ERR) after previous requests */
+		if ( ( add_file_err_client(client, PROTO_ST_NOTFOUND) ) < 0 )
+			client->sendError = 1;
+		return 0;
+	}
+
+	if ( strncmp(inbuf, "FEAT", 4) == 0 )
+		return serve_feat(client_socket, client);
+
+	if ( ( strncmp(inbuf, "MGET", 4) == 0 ) && ( client->features & FEAT_MGET ) )
+		return serve_mget(client_socket, client);
+
+	if ( ( strncmp(inbuf, "RGET", 4) == 0 ) && ( client->features & FEAT_REST ) )
+		return serve_rget(client_socket, client);
+
+	if ( ( strncmp(inbuf, "CGET", 4) == 0 ) && ( client->features & FEAT_COND ) )
+		return serve_cget(client_socket, client);
+
+	if ( ( strncmp(inbuf, "PGET", 4) == 0 ) && ( client->features & FEAT_RANGE ) )
+		return serve_pget(client_socket, client);
+
+	if ( ( strncmp(inbuf, "DGET", 4) == 0 ) && ( client->features & FEAT_DELTA ) )
+		return serve_dget(client_socket, client);
+
+	if ( ( strncmp(inbuf, "LIST", 4) == 0 ) && ( client->features & FEAT_LIST ) )
+		return serve_list(client_socket, client);
+
+	if ( ( strncmp(inbuf, "FGET", 4) == 0 ) && ( client->features & FEAT_FOLLOW ) )
+		return serve_fget(client_socket, client);
+
+	if ( ( strncmp(inbuf, "STOP", 4) == 0 ) && ( client->features & FEAT_FOLLOW ) )
+		return serve_stop(client_socket, client);
+
+	if ( ( strncmp(inbuf, "BNDL", 4) == 0 ) && ( client->features & FEAT_BNDL ) )
+		return serve_bndl(client_socket, client);
+
+	if ( ( strncmp(inbuf, "PRIO", 4) == 0 ) && ( client->features & FEAT_PRIO ) )
+		return serve_prio(client_socket, client);
+
+	/* wrong command, notify it after previous requests were served */
+	if ( ( add_error_client(client) ) < 0 )
+		client->sendError = 1;
+	return 0;
+}
+
+
+int
+serve_client_wr(int client_socket,
+				struct sclient *client,
+				int buflen)
+{
+	struct sfiles *head = get_next_req_client(client);
+	unsigned char *outbuf = NULL;
+	int n = 0;
+
+	if ( ( outbuf = calloc(buflen, sizeof(unsigned char)) ) == NULL ) {
+		err_ret("ERROR: could not malloc buffer");
+		return -2; // sys error
+	}
+
+	/* client must be notified of an error, connection will be closed */
+	if ( client->sendError ) {
+
+		if ( client->features & FEAT_MUX ) {
+			proto_put_frame(outbuf, MUX_STREAM_CONN, MUX_FIN, 6);
+			n = MUX_HDR_LEN;
+		}
+		memcpy(outbuf+n, "-ERR\r\n", 6);
+		Writen(client_socket, outbuf, n+6);
+
+		free(outbuf);
+		return -1; // user will be deleted
+	}
+
+	/* NOTE: FEAT reply is never framed, MUX is enabled by it */
+	if ( ( client->features & FEAT_MUX ) && ( head != NULL ) && ( head->stream != MUX_STREAM_CONN ) )
+		n = fill_frames(client, outbuf, buflen);
+	else
+		n = fill_reply(client, outbuf, buflen);
+
+	if ( n == -2 ) {
+		free(outbuf);
+		return -2; // sys error
+	}
+
+	/* send data to client */
+	if ( ( n > 0 ) && ( Writen(client_socket, outbuf, n) ) < 0 ) {
+		free(outbuf);
+		return -1; // user will be deleted
+	}
+
+	free(outbuf);
+
+	if ( client->sendError )
+		return 0; // error to send to user
+
+	if ( there_are_more_files(client) )
+		return ( n == 0 ? 3 : 0 ); // nothing sent: files to be followed did not grow
+
+	return 1; // sent all client-requested files till now
+}
+
+
+int
+get_info_file(char* filename, struct proto_info *info)
+{
+	struct stat sfile;
+
+	if ( (stat(filename, &sfile)) < 0 ) {
+		err_ret("ERROR: could not get file stat");
+		return -1;
+	}
+
+	stat_to_info(&sfile, info);
+
+	return 0;
+}
+
+
+/**
+ * @brief Fills file info from file stat
+ */
+static void
+stat_to_info(const struct stat *sfile, struct proto_info *info)
+{
+	info->size  = sfile->st_size;
+	info->ts    = sfile->st_mtim.tv_sec;
+	info->ts_ns = sfile->st_mtim.tv_nsec;
+}
+
+
+/**
+ * @brief Reads a command line up to CR LF
+ *
+ * NOTE: the line is '\0' terminated, CR LF excluded. If the line is too long
+ *       it is truncated and the rest of it is consumed.
+ *
+ * @param sock		client socket
+ * @param buf		line buffer
+ * @param buflen	line buffer length
+ *
+ * @return  line length if OK
+ * @return -1 on connection error
+ * @return -2 if line is too long
+ */
+static int
+read_line(int sock, char *buf, int buflen)
+{
+	char c    = '\0';
+	char prev = '\0';
+	int  len  = 0;
+	int  trunc = 0;
+
+	for ( ; ; ) {
+		if ( (Readn(sock, &c, 1)) <= 0 )
+			return -1;
+
+		if ( ( prev == '\r' ) && ( c == '\n' ) )
+			break;
+
+		if ( len < buflen - 1 )
+			buf[len++] = c;
+		else
+			trunc = 1;
+
+		prev = c;
+	}
+
+	/* remove CR */
+	if ( !trunc )
+		--len;
+	buf[len] = '\0';
+
+	return ( trunc ? -2 : len );
+}
+
+
+/**
+ * @brief Serves a FEAT command: negotiates the protocol extensions
+ *
+ * NOTE: it must be the first command on the connection, replies are built
+ *       when sent and must not change format while pipelined.
+ *
+ * @return  0 if OK (reply queued)
+ * @return -1 on error
+ */
+static int
+serve_feat(int client_socket,
+		   struct sclient *client)
+{
+	char inbuf[PROTO_LINE_MAX+1];
+	uint8_t *reply = NULL;
+	int n = 0;
+
+	if ( ( n = read_line(client_socket, inbuf, sizeof(inbuf)) ) == -1 )
+		return -1;
+
+	if ( ( n < 0 ) || ( client->nrequests > 1 ) ) {
+		if ( ( add_error_client(client) ) < 0 )
+			client->sendError = 1;
+		return 0;
+	}
+
+	client->features = proto_parse_feats(inbuf) & FEAT_ALL;
+
+	/* busy: the client is sent to a peer, nothing was queued before FEAT */
+	if ( ( client->peer >= 0 ) && ( client->features & FEAT_REDIR ) ) {
+		n = snprintf(inbuf, sizeof(inbuf), ">%s %s\r\n", peers[client->peer].host, peers[client->peer].serv);
+		Writen(client_socket, inbuf, n);
+		return 2;
+	}
+
+	/* reply: "+OK" + accepted tokens + CR LF */
+	if ( ( reply = malloc(PROTO_LINE_MAX) ) == NULL ) {
+		client->sendError = 1;
+		return 0;
+	}
+
+	memcpy(reply, "+OK", 3);
+	n = proto_fmt_feats((char *) reply+3, PROTO_LINE_MAX-5, client->features);
+	if ( n < 0 ) {
+		free(reply);
+		client->sendError = 1;
+		return 0;
+	}
+	memcpy(reply+3+n, "\r\n", 2);
+
+	if ( ( add_data_client(reply, n+5, client) ) < 0 ) {
+		free(reply);
+		client->sendError = 1;
+	}
+
+	return 0;
+}
+
+
+/**
+ * @brief Serves a MGET command: reads the filenames, queues the manifest and
+ *        the files with status OK sorted by disk locality (device, inode).
+ *
+ * @return  0 if OK (reply queued)
+ * @return -1 on error
+ */
+static int
+serve_mget(int client_socket,
+		   struct sclient *client)
+{
+	char inbuf[PROTO_LINE_MAX+1];
+	uint8_t info_buf[PROTO_INFO_LEN_X64];
+	struct mget_entry *entries = NULL;
+	uint8_t *manifest = NULL;
+	uint8_t *p = NULL;
+	int  entry_len = MGET_ENTRY_HDR + proto_info_len(client->features);
+	long nfiles = 0;
+	long i      = 0;
+	int  n      = 0;
+	int  ret    = 0;
+	char *endp  = NULL;
+
+	if ( ( n = read_line(client_socket, inbuf, sizeof(inbuf)) ) == -1 )
+		return -1;
+
+	nfiles = strtol(inbuf, &endp, 10);
+	if ( ( n <= 0 ) || ( *endp != '\0' ) || ( nfiles < 1 ) || ( nfiles > MGET_MAX ) ) {
+		/* the filenames that follow can't be skipped, connection will be closed */
+		if ( ( add_error_client(client) ) < 0 )
+			client->sendError = 1;
+		return 0;
+	}
+
+	if ( ( entries = calloc(nfiles, sizeof(struct mget_entry)) ) == NULL ) {
+		client->sendError = 1;
+		return 0;
+	}
+
+	/* read filenames and get their info */
+	for ( i = 0; i < nfiles; i++ ) {
+
+		if ( ( n = read_line(client_socket, inbuf, NAME_MAX+2) ) == -1 ) {
+			ret = -1;
+			goto out;
+		}
+
+		entries[i].idx    = i;
+		entries[i].status = PROTO_ST_NOTFOUND;
+
+		if ( ( n <= 0 ) || ( stat(inbuf, &(entries[i].st)) < 0 ) ||
+			 ( !S_ISREG(entries[i].st.st_mode) ) || ( access(inbuf, R_OK) < 0 ) )
+			continue;
+
+		stat_to_info(&(entries[i].st), &(entries[i].info));
+		if ( proto_put_info(info_buf, &(entries[i].info), client->features) < 0 ) {
+			entries[i].status = PROTO_ST_TOOBIG;
+			continue;
+		}
+
+		if ( ( entries[i].filename = strdup(inbuf) ) == NULL ) {
+			client->sendError = 1;
+			goto out;
+		}
+		entries[i].status = PROTO_ST_OK;
+	}
+
+	/* plan reads for the whole batch */
+	qsort(entries, nfiles, sizeof(struct mget_entry), cmp_mget_entry);
+
+	/* prepare manifest */
+	if ( ( manifest = calloc(4 + nfiles*entry_len, sizeof(uint8_t)) ) == NULL ) {
+		client->sendError = 1;
+		goto out;
+	}
+
+	*((uint32_t*) manifest) = htonl(nfiles);
+	for ( i = 0, p = manifest+4; i < nfiles; i++, p += entry_len ) {
+		*((uint32_t*) (p))   = htonl(entries[i].idx);
+		*(p+4)               = entries[i].status;
+		if ( entries[i].status == PROTO_ST_OK )
+			proto_put_info(p+MGET_ENTRY_HDR, &(entries[i].info), client->features);
+	}
+
+	/* queue "+OK\r\n", manifest and files contents */
+	if ( ( p = malloc(5) ) == NULL ) {
+		client->sendError = 1;
+		goto out;
+	}
+	memcpy(p, "+OK\r\n", 5);
+
+	if ( ( add_data_client(p, 5, client) ) < 0 ) {
+		free(p);
+		client->sendError = 1;
+		goto out;
+	}
+
+	if ( ( add_data_client(manifest, 4 + nfiles*entry_len, client) ) < 0 ) {
+		client->sendError = 1;
+		goto out;
+	}
+	manifest = NULL; // owned by client's list
+
+	for ( i = 0; i < nfiles; i++ ) {
+		if ( entries[i].status != PROTO_ST_OK )
+			continue;
+
+		if ( ( add_body_client(entries[i].filename, entries[i].info.size, client) ) < 0 ) {
+			client->sendError = 1;
+			goto out;
+		}
+	}
+
+out:
+	for ( i = 0; i < nfiles; i++ )
+		free(entries[i].filename);
+	free(entries);
+	free(manifest);
+
+	return ret;
+}
+
+
+/**
+ * @brief Serves a RGET command: "RGET <offset> <size> <timestamp> <filename>"
+ *
+ * @return  0 if OK (reply queued)
+ * @return -1 on error
+ */
+static int
+serve_rget(int client_socket,
+		   struct sclient *client)
+{
+	char inbuf[PROTO_LINE_MAX+1];
+	char *p = inbuf;
+	struct proto_info info;
+	uint64_t offset = 0;
+	int n = 0;
+
+	if ( ( n = read_line(client_socket, inbuf, sizeof(inbuf)) ) == -1 )
+		return -1;
+
+	if ( ( n > 0 ) && ( parse_u64(&p, &offset) == 0 ) && ( parse_u64(&p, &(info.size)) == 0 ) &&
+		 ( parse_ts(&p, &info) == 0 ) && ( *p == ' ' ) && ( *(p+1) != '\0' ) &&
+		 ( strlen(p+1) <= NAME_MAX ) && ( access(p+1, F_OK) != -1 ) ) {
+
+		if ( ( add_rest_client(p+1, strlen(p+1), offset, &info, client) ) < 0 )
+			client->sendError = 1;
+		return 0;
+	}
+
+	/* notify user 'file not found' or wrong command (ERR) after previous requests */
+	if ( ( add_file_err_client(client, PROTO_ST_NOTFOUND) ) < 0 )
+		client->sendError = 1;
+	return 0;
+}
+
+
+/**
+ * @brief Serves a PGET command: "PGET <offset> <length> <filename>"
+ *
+ * @return  0 if OK (reply queued)
+ * @return -1 on error
+ */
+static int
+serve_pget(int client_socket,
+		   struct sclient *client)
+{
+	char inbuf[PROTO_LINE_MAX+1];
+	char *p = inbuf;
+	uint64_t offset = 0;
+	uint64_t length = 0;
+	int n = 0;
+
+	if ( ( n = read_line(client_socket, inbuf, sizeof(inbuf)) ) == -1 )
+		return -1;
+
+	if ( ( n > 0 ) && ( parse_u64(&p, &offset) == 0 ) && ( parse_u64(&p, &length) == 0 ) &&
+		 ( *p == ' ' ) && ( *(p+1) != '\0' ) && ( strlen(p+1) <= NAME_MAX ) && ( access(p+1, F_OK) != -1 ) ) {
+
+		if ( ( add_range_client(p+1, strlen(p+1), offset, length, client) ) < 0 )
+			client->sendError = 1;
+		return 0;
+	}
+
+	/* notify user 'file not found' or wrong command (ERR) after previous requests */
+	if ( ( add_file_err_client(client, PROTO_ST_NOTFOUND) ) < 0 )
+		client->sendError = 1;
+	return 0;
+}
+
+
+/**
+ * @brief Serves a CGET command: "CGET <size> <timestamp> <filename>"
+ *
+ * @return  0 if OK (reply queued)
+ * @return -1 on error
+ */
+static int
+serve_cget(int client_socket,
+		   struct sclient *client)
+{
+	char inbuf[PROTO_LINE_MAX+1];
+	char *p = inbuf;
+	struct proto_info info;
+	int n = 0;
+
+	if ( ( n = read_line(client_socket, inbuf, sizeof(inbuf)) ) == -1 )
+		return -1;
+
+	if ( ( n > 0 ) && ( parse_u64(&p, &(info.size)) == 0 ) && ( parse_ts(&p, &info) == 0 ) &&
+		 ( *p == ' ' ) && ( *(p+1) != '\0' ) && ( strlen(p+1) <= NAME_MAX ) &&
+		 ( access(p+1, F_OK) != -1 ) ) {
+
+		if ( ( add_cond_client(p+1, strlen(p+1), &info, client) ) < 0 )
+			client->sendError = 1;
+		return 0;
+	}
+
+	/* notify user 'file not found' or wrong command (ERR) after previous requests */
+	if ( ( add_file_err_client(client, PROTO_ST_NOTFOUND) ) < 0 )
+		client->sendError = 1;
+	return 0;
+}
+
+
+/**
+ * @brief Serves a DGET command: "DGET <size> <timestamp> <block> <filename>"
+ *        followed by the signatures of the client's copy
+ *
+ * @return  0 if OK (reply queued)
+ * @return -1 on error
+ */
+static int
+serve_dget(int client_socket,
+		   struct sclient *client)
+{
+	char inbuf[PROTO_LINE_MAX+1];
+	char *p = inbuf;
+	struct proto_info info;
+	uint64_t block   = 0;
+	uint64_t nblocks = 0;
+	uint8_t  *sigs   = NULL;
+	int n = 0;
+
+	if ( ( n = read_line(client_socket, inbuf, sizeof(inbuf)) ) == -1 )
+		return -1;
+
+	if ( ( n <= 0 ) || ( parse_u64(&p, &(info.size)) < 0 ) || ( parse_ts(&p, &info) < 0 ) ||
+		 ( parse_u64(&p, &block) < 0 ) || ( block < DELTA_BLOCK_MIN ) || ( block > DELTA_BLOCK_MAX ) ||
+		 ( ( nblocks = info.size / block ) > DELTA_BLOCKS_MAX ) ||
+		 ( *p != ' ' ) || ( *(p+1) == '\0' ) || ( strlen(p+1) > NAME_MAX ) ) {
+		/* the signatures that follow can't be skipped, connection will be closed */
+		if ( ( add_error_client(client) ) < 0 )
+			client->sendError = 1;
+		return 0;
+	}
+
+	if ( ( sigs = malloc(nblocks * DELTA_SIG_LEN + 1) ) == NULL ) {
+		client->sendError = 1;
+		return 0;
+	}
+
+	if ( ( nblocks > 0 ) && ( Readn(client_socket, sigs, nblocks * DELTA_SIG_LEN) ) <= 0 ) {
+		free(sigs);
+		return -1;
+	}
+
+	if ( access(p+1, F_OK) == -1 ) {
+		free(sigs);
+		if ( ( add_file_err_client(client, PROTO_ST_NOTFOUND) ) < 0 )
+			client->sendError = 1;
+		return 0;
+	}
+
+	if ( ( add_delta_client(p+1, strlen(p+1), &info, block, sigs, nblocks, client) ) < 0 ) {
+		free(sigs);
+		client->sendError = 1;
+	}
+
+	return 0;
+}
+
+
+/**
+ * @brief Computes the delta of a file against the client's signatures
+ *
+ * NOTE: the delta is written on an anonymous temporary file, then sent as
+ *       file content
+ *
+ * @param req		SF_DELTA request
+ * @param len		delta length (output)
+ *
+ * @return  the delta file, at its beginning, if OK
+ * @return  NULL on error
+ */
+static FILE *
+make_delta(struct sfiles *req, uint64_t *len)
+{
+	struct stat sfile;
+	FILE    *out  = NULL;
+	uint8_t *data = NULL;
+	int     fd    = -1;
+	off_t   end   = 0;
+
+	if ( ( fd = open(req->filename, O_RDONLY) ) < 0 || ( fstat(fd, &sfile) < 0 ) ) {
+		err_ret("ERROR: could not open file\"%s\"", req->filename);
+		goto err;
+	}
+
+	if ( ( sfile.st_size > 0 ) &&
+		 ( data = mmap(NULL, sfile.st_size, PROT_READ, MAP_PRIVATE, fd, 0) ) == MAP_FAILED ) {
+		err_ret("ERROR: could not map file\"%s\"", req->filename);
+		data = NULL;
+		goto err;
+	}
+
+	if ( data != NULL )
+		madvise(data, sfile.st_size, MADV_SEQUENTIAL);
+
+	if ( ( out = tmpfile() ) == NULL ) {
+		err_ret("ERROR: could not create delta file");
+		goto err;
+	}
+
+	if ( ( delta_generate(out, data, sfile.st_size, req->data, req->size, req->block) < 0 ) ||
+		 ( fflush(out) == EOF ) || ( ( end = ftello(out) ) < 0 ) ) {
+		err_ret("ERROR: could not write delta file");
+		goto err;
+	}
+	rewind(out);
+	*len = end;
+
+	if ( data != NULL )
+		munmap(data, sfile.st_size);
+	close(fd);
+	return out;
+
+err:
+	if ( out != NULL )
+		fclose(out);
+	if ( data != NULL )
+		munmap(data, sfile.st_size);
+	if ( fd >= 0 )
+		close(fd);
+	return NULL;
+}
+
+
+/**
+ * @brief Checks if a file is still the one the client knows (same size and
+ *        timestamp, nanoseconds only if the client specified them)
+ *
+ * @return  1 to say YES
+ * @return  0 to say NO
+ */
+static int
+same_file(const struct proto_info *info,
+		  const struct proto_info *known)
+{
+	return ( ( info->size == known->size ) && ( info->ts == known->ts ) &&
+			 ( ( known->ts_ns == PROTO_NS_ANY ) || ( info->ts_ns == known->ts_ns ) ) );
+}
+
+
+/**
+ * @brief Queues an error about a requested file (e.g. "file not found")
+ *
+ * NOTE: with NERR the error is "-NOK" + status, with MUX "-ERR" that only
+ *       ends the request stream, otherwise the connection will be closed
+ *
+ * @return  1 if OK
+ * @return -2 on system error
+ */
+static int
+add_file_err_client(struct sclient *client, int status)
+{
+	uint8_t *reply = NULL;
+	int     len    = ( client->features & FEAT_NERR ? PROTO_NOK_LEN : 6 );
+
+	if ( !(client->features & ( FEAT_NERR | FEAT_MUX )) )
+		return add_error_client(client);
+
+	if ( ( reply = malloc(len) ) == NULL )
+		return -2;
+
+	if ( client->features & FEAT_NERR ) {
+		memcpy(reply, "-NOK\r\n", PROTO_NOK_LEN-1);
+		reply[PROTO_NOK_LEN-1] = status;
+	} else
+		memcpy(reply, "-ERR\r\n", 6);
+
+	if ( ( add_data_client(reply, len, client) ) < 0 ) {
+		free(reply);
+		return -2;
+	}
+
+	return 1;
+}
+
+
+/**
+ * @brief Parses a space-prefixed decimal number and moves past it
+ *
+ * @return  0 if OK
+ * @return -1 on error
+ */
+static int
+parse_u64(char **str, uint64_t *val)
+{
+	unsigned long long v = 0;
+	char *endp = NULL;
+
+	if ( ( **str != ' ' ) || !isdigit((unsigned char) *(*str+1)) )
+		return -1;
+
+	errno = 0;
+	v = strtoull(*str+1, &endp, 10);
+	if ( ( errno != 0 ) || ( v > UINT64_MAX ) )
+		return -1;
+
+	*val = v;
+	*str = endp;
+	return 0;
+}
+
+
+/**
+ * @brief Parses a space-prefixed timestamp "<seconds>[.<nanoseconds>]" and
+ *        moves past it
+ *
+ * @return  0 if OK
+ * @return -1 on error
+ */
+static int
+parse_ts(char **str, struct proto_info *info)
+{
+	uint64_t ns = 0;
+
+	if ( parse_u64(str, &(info->ts)) < 0 )
+		return -1;
+
+	info->ts_ns = PROTO_NS_ANY;
+	if ( **str != '.' )
+		return 0;
+
+	**str = ' '; // parse nanoseconds as a number
+	if ( ( parse_u64(str, &ns) < 0 ) || ( ns > 999999999 ) )
+		return -1;
+
+	info->ts_ns = ns;
+	return 0;
+}
+
+
+/**
+ * @brief Sorts MGET entries: errors first, then files by device and inode
+ */
+static int
+cmp_mget_entry(const void *a, const void *b)
+{
+	const struct mget_entry *ea = a;
+	const struct mget_entry *eb = b;
+
+	int oka = ( ea->status == PROTO_ST_OK );
+	int okb = ( eb->status == PROTO_ST_OK );
+
+	if ( oka != okb )
+		return ( oka - okb ); // errors first, they have no content
+
+	if ( !oka )
+		return ( ea->idx < eb->idx ? -1 : 1 );
+
+	if ( ea->st.st_dev != eb->st.st_dev )
+		return ( ea->st.st_dev < eb->st.st_dev ? -1 : 1 );
+
+	if ( ea->st.st_ino != eb->st.st_ino )
+		return ( ea->st.st_ino < eb->st.st_ino ? -1 : 1 );
+
+	return ( ea->idx < eb->idx ? -1 : 1 );
+}
+
+
+/**
+ * @brief Fills the buffer with the reply to the oldest request
+ *
+ * NOTE: on errors sets client->sendError
+ *
+ * @return  nr. of bytes to be sent
+ * @return -2 on system error
+ */
+static int
+fill_reply(struct sclient *client,
+		   uint8_t *buf,
+		   int buflen)
+{
+	struct sfiles *req = get_next_req_client(client);
+	int n = 0;
+
+	if ( req == NULL )
+		return 0; // nothing to send
+
+	if ( req->type == SF_ERR ) {
+		client->sendError = 1; // queued error, all previous requests were served
+		return 0;
+	}
+
+	if ( req->waiting )
+		return 0; // file to be followed did not grow
+
+	if ( ( n = read_req(client, req, buf, buflen) ) < 0 ) {
+		if ( n == -1 )
+			client->sendError = 1;
+		return ( n == -2 ? -2 : 0 );
+	}
+
+	if ( req_done(req) )
+		rm_head_file_client(client);
+
+	return n;
+}
+
+
+/**
+ * @brief Fills the buffer with MUX frames, one stream after the other
+ *
+ * NOTE: on errors sets client->sendError
+ *
+ * @return  nr. of bytes to be sent
+ * @return -2 on system error
+ */
+static int
+fill_frames(struct sclient *client,
+			uint8_t *buf,
+			int buflen)
+{
+	struct sfiles *req = NULL;
+	int len  = 0; // bytes in buffer
+	int flen = 0; // max frame payload
+	int fin  = 0;
+	int n    = 0;
+
+	while ( ( req = next_stream_client(client) ) != NULL ) {
+
+		flen = buflen - len - MUX_HDR_LEN;
+		if ( flen > MUX_FRAME_MAX )
+			flen = MUX_FRAME_MAX;
+		if ( flen < PROTO_REPLY_HDR_MAX )
+			break; // buffer full
+
+		if ( ( n = read_req(client, req, buf+len+MUX_HDR_LEN, flen) ) < 0 ) {
+			if ( n == -1 )
+				client->sendError = 1;
+			return ( n == -2 ? -2 : len );
+		}
+
+		client->last_stream = req->stream;
+
+		if ( ( n == 0 ) && !req_done(req) )
+			continue; // file to be followed did not grow, now waiting
+
+		/* a reply may be made of many requests (MGET), FIN on the last one */
+		fin = 0;
+		if ( req_done(req) ) {
+			fin = ( ( req->next_file == NULL ) || ( req->next_file->stream != req->stream ) );
+			rm_req_client(client, req);
+		}
+
+		proto_put_frame(buf+len, client->last_stream, ( fin ? MUX_FIN : 0 ), n);
+		len += MUX_HDR_LEN + n;
+	}
+
+	/* queued error, all previous requests were served */
+	if ( ( client->files != NULL ) && ( client->files->type == SF_ERR ) )
+		client->sendError = 1;
+
+	return len;
+}
+
+
+/**
+ * @brief Picks the next stream to be served: round robin among the streams
+ *        of the highest priority class (PRIO)
+ *
+ * NOTE: only the first MUX_ACTIVE_MAX streams of each class are served, the
+ *       requests after a queued error wait for it. Streams waiting for their
+ *       file to grow (FOLLOW) are skipped.
+ *
+ * @return  the first request of the stream if OK
+ * @return  NULL if there are no streams to serve
+ */
+static struct sfiles *
+next_stream_client(struct sclient *client)
+{
+	struct sfiles *p     = NULL;
+	struct sfiles *prev  = NULL;
+	struct sfiles *first = NULL; // first stream of the best class
+	struct sfiles *next  = NULL; // next one of the best class, round robin
+	int nstreams[PROTO_PRIO_LEVELS] = { 0 };
+	int best = PROTO_PRIO_LEVELS;
+
+	for ( p = client->files; ( p != NULL ) && ( p->type != SF_ERR ); prev = p, p = p->next_file ) {
+
+		if ( ( prev != NULL ) && ( prev->stream == p->stream ) )
+			continue; // not the first request of its stream
+
+		/* NOTE: without PRIO every stream is of the same class */
+		if ( ++(nstreams[p->prio]) > MUX_ACTIVE_MAX ) {
+			if ( !(client->features & FEAT_PRIO) )
+				break;
+			continue;
+		}
+
+		if ( p->waiting || ( p->prio > best ) )
+			continue; // file to be followed did not grow, lower class
+
+		if ( p->prio < best ) {
+			best  = p->prio;
+			first = p;
+			next  = NULL;
+		}
+
+		if ( ( next == NULL ) && ( p->stream > client->last_stream ) ) {
+			next = p;
+			if ( !(client->features & FEAT_PRIO) )
+				break;
+		}
+	}
+
+	return ( next != NULL ? next : first ); // wrap around
+}
+
+
+/**
+ * @brief Reads the next bytes of a reply: header (on first call) and data
+ *
+ * @param client	client info
+ * @param req		request being served
+ * @param buf		output buffer
+ * @param buflen	output buffer length (at least PROTO_REPLY_HDR_MAX)
+ *
+ * @return  nr. of bytes read if OK (see req_done()), with NERR or MUX the
+ *          reply may be an error about the file
+ * @return -1 on request error (e.g. file removed or too big)
+ * @return -2 on system error
+ */
+static int
+read_req(struct sclient *client,
+		 struct sfiles *req,
+		 uint8_t *buf,
+		 int buflen)
+{
+	struct proto_info info;  // file size and timestamp
+	uint64_t offset = 0;     // offset of first byte to be sent
+	int      hlen   = 0;     // response header length
+	int      status = PROTO_ST_IOERR; // file error (NERR)
+	int      n      = 0;
+
+	if ( !(req->started) ) {
+
+		switch ( req->type ) {
+
+			case SF_DATA: // in-memory reply
+				req->left = req->size;
+				break;
+
+			case SF_FOLLOW: // header + chunks of the file as it grows
+				if ( ( get_info_file(req->filename, &info) ) < 0 ) {
+					status = PROTO_ST_NOTFOUND;
+					goto file_err;
+				}
+
+				memcpy(buf, "+OK\r\n", OK_LEN);
+				if ( ( n = proto_put_info(buf+OK_LEN, &info, client->features) ) < 0 ) {
+					err_msg("ERROR: file size or timestamp too big.");
+					status = PROTO_ST_TOOBIG;
+					goto file_err;
+				}
+				hlen = OK_LEN + n;
+
+				if ( req->offset > info.size )
+					req->offset = 0; // file truncated since
+				hlen += proto_put_off(buf+hlen, req->offset, client->features); // offset <= size, fits
+
+				if ( ( n = follow_open(req) ) < 0 )
+					goto file_err;
+				break;
+
+			case SF_LIST: // header + manifest built while sent
+				if ( ( n = list_open(req) ) < 0 ) {
+					status = PROTO_ST_NOTFOUND;
+					goto file_err;
+				}
+				memcpy(buf, "+OK\r\n", OK_LEN);
+				hlen = OK_LEN;
+				break;
+
+			case SF_BNDL: // header + archive built while sent
+				if ( ( n = bndl_open(req) ) < 0 ) {
+					status = PROTO_ST_NOTFOUND;
+					goto file_err;
+				}
+				memcpy(buf, "+OK\r\n", OK_LEN);
+				hlen = OK_LEN;
+				break;
+
+			case SF_BODY: // header already sent, only file content
+				req->left = req->size;
+
+				if ( client->features & FEAT_CRC ) {
+					if ( ( get_info_file(req->filename, &(req->info)) ) < 0 )
+						return -1;
+					if ( ( n = crc_open(req, 1) ) < 0 )
+						return n;
+				}
+				break;
+
+			default: // SF_FILE, SF_REST, SF_COND, SF_DELTA, SF_RANGE
+
+				/* read file size and timestamp */
+				if ( ( get_info_file(req->filename, &info) ) < 0 ) {
+					status = PROTO_ST_NOTFOUND;
+					goto file_err;
+				}
+
+				/* client's copy is up to date, reply "not modified" */
+				if ( ( ( req->type == SF_COND ) || ( req->type == SF_DELTA ) ) &&
+					 same_file(&info, &(req->info)) ) {
+					memcpy(buf, "=OK\r\n", OK_LEN);
+					req->left    = 0;
+					req->started = 1;
+					return OK_LEN;
+				}
+
+				/* prepare response header */
+				memcpy(buf, "+OK\r\n", OK_LEN);
+				if ( ( n = proto_put_info(buf+OK_LEN, &info, client->features) ) < 0 ) {
+					err_msg("ERROR: file size or timestamp too big.");
+					status = PROTO_ST_TOOBIG; // file may be bigger than 2^32, there would be overflow
+					goto file_err;
+				}
+				hlen = OK_LEN + n;
+
+				if ( req->type == SF_REST ) {
+					/* resume only if the file is the one partially sent */
+					if ( same_file(&info, &(req->info)) && ( req->offset <= info.size ) )
+						offset = req->offset;
+
+					hlen += proto_put_off(buf+hlen, offset, client->features); // offset <= size, fits
+				}
+
+				if ( req->type == SF_RANGE ) {
+					offset = ( req->offset < info.size ? req->offset : info.size );
+					hlen  += proto_put_off(buf+hlen, offset, client->features); // offset <= size, fits
+				}
+				req->left = info.size - offset; // bytes to be sent
+				if ( ( req->type == SF_RANGE ) && ( req->size < req->left ) )
+					req->left = req->size;
+
+				/* compressed file content */
+				if ( ( client->features & FEAT_LZ ) && ( ( req->type == SF_FILE ) || ( req->type == SF_COND ) ) &&
+					 ( ( n = lz_open(req, &info) ) < 0 ) )
+					goto file_err;
+
+				if ( req->type == SF_DELTA ) {
+					/* send the delta instead of the file */
+					if ( ( req->fp = make_delta(req, &(req->left)) ) == NULL )
+						goto file_err;
+
+					if ( ( n = proto_put_off(buf+hlen, req->left, client->features) ) < 0 ) {
+						err_msg("ERROR: delta too big.");
+						status = PROTO_ST_TOOBIG;
+						goto file_err;
+					}
+					hlen += n;
+				}
+
+				/* checksum of a range: computed while sending it */
+				if ( ( client->features & FEAT_CRC ) && ( req->type == SF_RANGE ) ) {
+					req->info    = info;
+					req->tleft   = PROTO_CRC_LEN;
+					req->crc     = 0;
+					req->crc_run = 1;
+
+				/* checksum: cached, computed while sending the whole file, or now */
+				} else if ( client->features & FEAT_CRC ) {
+					req->info = info;
+					if ( ( n = crc_open(req, ( req->zbuf != NULL ) ||
+											 ( ( req->fp == NULL ) && ( req->cent == NULL ) && ( offset == 0 ) )) ) < 0 )
+						goto file_err;
+				}
+				break;
+		}
+
+		/* open file */
+		if ( ( req->type != SF_DATA ) && ( req->type != SF_LIST ) && ( req->type != SF_BNDL ) &&
+			 ( req->fp == NULL ) && ( req->cent == NULL ) ) {
+			if ( ( req->fp = fopen(req->filename, "rb") ) == NULL ) {
+				err_ret("ERROR: could not open file\"%s\"", req->filename);
+				status = PROTO_ST_NOTFOUND;
+				goto file_err;
+			}
+
+			if ( ( offset > 0 ) && ( fseeko(req->fp, offset, SEEK_SET) < 0 ) ) {
+				err_ret("ERROR: could not seek file\"%s\"", req->filename);
+				goto file_err;
+			}
+		}
+
+		req->started = 1;
+	}
+
+	if ( ( req->type == SF_LIST ) || ( req->type == SF_BNDL ) ) {
+		if ( ( n = list_read(client, req, buf+hlen, buflen-hlen) ) < 0 )
+			return n;
+
+	} else if ( req->type == SF_FOLLOW ) {
+		if ( ( n = follow_read(req, buf+hlen, buflen-hlen) ) < 0 )
+			return n;
+
+	} else if ( req->zbuf != NULL ) { // compressed while sent
+		if ( ( n = lz_read(req, buf+hlen, buflen-hlen) ) < 0 )
+			return n;
+
+	} else {
+		n = ( req->left < ((uint64_t) (buflen-hlen)) ? req->left : ((uint64_t) (buflen-hlen)) ); // NOTE: buflen is always < INT_MAX
+
+		if ( req->type == SF_DATA ) {
+			memcpy(buf+hlen, req->data + (req->size - req->left), n);
+
+		} else if ( req->cent != NULL ) {
+			memcpy(buf+hlen, req->cent->data + (req->cent->len - req->left), n);
+
+		} else if ( ( n > 0 ) && ( fread(buf+hlen, sizeof(uint8_t), n, req->fp) ) < (size_t) n ) {
+			if ( feof(req->fp) || ferror(req->fp) ) {
+				err_msg("ERROR: cannot read file.");
+				return -1; // error reading file, notify user
+			} else
+				return -2; // sys error
+		}
+
+		if ( req->crc_run )
+			req->crc = crc32c(req->crc, buf+hlen, n);
+
+		req->left -= n; // update n. of bytes to be sent
+	}
+
+	/* checksum after the file content */
+	if ( ( req->tleft > 0 ) && ( req->left == 0 ) && ( req->zpos == req->zlen ) )
+		n += put_trailer(req, buf+hlen+n, buflen-hlen-n);
+
+	return hlen + n;
+
+file_err:
+	/* NERR or MUX: the error is the reply (nothing was sent yet), the connection goes on (see add_file_err_client()) */
+	if ( ( n == -2 ) || !(client->features & ( FEAT_NERR | FEAT_MUX )) || ( req->type == SF_BODY ) )
+		return ( n == -2 ? -2 : -1 );
+
+	if ( client->features & FEAT_NERR ) {
+		memcpy(buf, "-NOK\r\n", PROTO_NOK_LEN-1);
+		buf[PROTO_NOK_LEN-1] = status;
+		n = PROTO_NOK_LEN;
+	} else {
+		memcpy(buf, "-ERR\r\n", 6); // only ends the stream
+		n = 6;
+	}
+
+	req->started = 1;
+	req->left    = 0;
+	req->zpos    = req->zlen = 0;
+	req->tleft   = 0;
+	req->crc_run = 0;
+	return n;
+}
+
+
+/**
+ * @brief Checks if a reply was completely read
+ *
+ * @return  1 to say YES
+ * @return  0 to say NO
+ */
+static int
+req_done(const struct sfiles *req)
+{
+	return ( req->started && ( req->left == 0 ) && ( req->zpos == req->zlen ) && ( req->tleft == 0 ) );
+}
+
+
+/**
+ * @brief Prepares the compressed content of a file: the precompressed file
+ *        if newer than the file, the cached one, or compresses it (at once
+ *        and cached if small, while sent otherwise)
+ *
+ * NOTE: req->left is set to the bytes to be sent (raw bytes if compressed
+ *       while sent)
+ *
+ * @return  0 if OK
+ * @return -1 on request error
+ * @return -2 on system error
+ */
+static int
+lz_open(struct sfiles *req, const struct proto_info *info)
+{
+	char        zname[PATH_MAX];
+	struct stat sz;
+	FILE        *mem  = NULL;
+	char        *data = NULL;
+	size_t      len   = 0;
+	int         ret   = 0;
+
+	if ( ( snprintf(zname, sizeof(zname), "%s" LZ_SUFFIX, req->filename) < (int) sizeof(zname) ) &&
+		 ( stat(zname, &sz) == 0 ) && S_ISREG(sz.st_mode) &&
+		 ( ( (uint64_t) sz.st_mtim.tv_sec > info->ts ) ||
+		   ( ( (uint64_t) sz.st_mtim.tv_sec == info->ts ) && ( sz.st_mtim.tv_nsec > (long) info->ts_ns ) ) ) &&
+		 ( ( req->fp = fopen(zname, "rb") ) != NULL ) ) {
+		req->left = sz.st_size;
+		return 0;
+	}
+
+	if ( ( req->cent = cache_get(CACHE_LZ, req->filename, info) ) != NULL ) {
+		req->left = req->cent->len;
+		return 0;
+	}
+
+	if ( ( req->fp = fopen(req->filename, "rb") ) == NULL ) {
+		err_ret("ERROR: could not open file\"%s\"", req->filename);
+		return -1;
+	}
+
+	if ( info->size > LZ_CACHE_FILE_MAX ) {
+		if ( ( req->zbuf = malloc(LZ_ZBUF_LEN) ) == NULL )
+			return -2;
+		req->left = info->size;
+		req->zpos = req->zlen = 0; // first block compressed by lz_read, once the CRC is set up
+		return 0;
+	}
+
+	if ( ( mem = open_memstream(&data, &len) ) == NULL )
+		return -2;
+
+	ret = lz_pack(req->fp, mem);
+	if ( ( fclose(mem) == EOF ) || ( ret < 0 ) ) {
+		free(data);
+		err_msg("ERROR: cannot compress file.");
+		return -1;
+	}
+
+	fclose(req->fp);
+	req->fp = NULL;
+
+	if ( ( req->cent = cache_put(CACHE_LZ, req->filename, info, (uint8_t *) data, len) ) == NULL ) {
+		free(data);
+		return -2;
+	}
+	req->left = len;
+
+	return 0;
+}
+
+
+/**
+ * @brief Compresses the next block of a file compressed while sent (the
+ *        last one is followed by the end of stream)
+ *
+ * @return  0 if OK
+ * @return -1 on request error
+ */
+static int
+lz_refill(struct sfiles *req)
+{
+	uint8_t *raw = req->zbuf + LZ_ZRAW_OFF;
+	int n = ( req->left < LZ_BLOCK_MAX ? req->left : LZ_BLOCK_MAX );
+
+	if ( ( n > 0 ) && ( fread(raw, sizeof(uint8_t), n, req->fp) ) < (size_t) n ) {
+		err_msg("ERROR: cannot read file.");
+		return -1;
+	}
+	req->left -= n;
+
+	if ( req->crc_run )
+		req->crc = crc32c(req->crc, raw, n);
+
+	req->zlen = lz_block(raw, n, req->zbuf);
+	req->zpos = 0;
+
+	if ( ( n > 0 ) && ( req->left == 0 ) )
+		req->zlen += lz_block(NULL, 0, req->zbuf + req->zlen);
+
+	return 0;
+}
+
+
+/**
+ * @brief Reads the next bytes of a file compressed while sent
+ *
+ * @return  nr. of bytes read if OK
+ * @return -1 on request error
+ */
+static int
+lz_read(struct sfiles *req, uint8_t *buf, int buflen)
+{
+	int len = 0;
+	int n   = 0;
+
+	while ( len < buflen ) {
+
+		if ( req->zpos == req->zlen ) {
+			if ( req->left == 0 )
+				break; // end of stream sent
+			if ( lz_refill(req) < 0 )
+				return -1;
+		}
+
+		n = ( buflen - len < req->zlen - req->zpos ? buflen - len : req->zlen - req->zpos );
+		memcpy(buf+len, req->zbuf + req->zpos, n);
+		req->zpos += n;
+		len       += n;
+	}
+
+	return len;
+}
+
+
+/**
+ * @brief Prepares the checksum of the file being sent (CRC): from cache, or
+ *        computed while sending it ('stream': the whole file is read), or by
+ *        reading the file now
+ *
+ * NOTE: req->info is the info of the file being sent
+ *
+ * @return  0 if OK
+ * @return -1 on request error
+ */
+static int
+crc_open(struct sfiles *req, int stream)
+{
+	FILE *fp = NULL;
+	int  ret = 0;
+
+	req->tleft   = PROTO_CRC_LEN;
+	req->crc     = 0;
+	req->crc_run = 0;
+
+	if ( crc_lookup(req->filename, &(req->info), &(req->crc)) == 0 )
+		return 0;
+
+	if ( stream ) {
+		req->crc_run = 1;
+		return 0;
+	}
+
+	if ( ( fp = fopen(req->filename, "rb") ) == NULL ) {
+		err_ret("ERROR: could not open file\"%s\"", req->filename);
+		return -1;
+	}
+
+	ret = crc32c_file(fp, req->info.size, &(req->crc));
+	fclose(fp);
+
+	if ( ret < 0 ) {
+		err_msg("ERROR: cannot read file.");
+		return -1;
+	}
+
+	crc_store(req->filename, &(req->info), req->crc);
+	return 0;
+}
+
+
+/**
+ * @brief Looks for the checksum of a file in cache, then in its extended
+ *        attribute (then cached)
+ *
+ * @return  0 if found
+ * @return -1 otherwise
+ */
+static int
+crc_lookup(const char *path, const struct proto_info *info, uint32_t *crc)
+{
+	if ( crc_peek(path, info, crc) == 0 )
+		return 0;
+
+	if ( crc_xattr(path, info, crc) < 0 )
+		return -1;
+
+	crc_cache(path, info, *crc);
+	return 0;
+}
+
+
+/**
+ * @brief Looks for the checksum of a file in cache
+ *
+ * @return  0 if found
+ * @return -1 otherwise
+ */
+static int
+crc_peek(const char *path, const struct proto_info *info, uint32_t *crc)
+{
+	struct cache_ent *ent = NULL;
+
+	if ( ( ent = cache_get(CACHE_CRC, path, info) ) == NULL )
+		return -1;
+
+	memcpy(crc, ent->data, sizeof(uint32_t));
+	cache_release(ent);
+	return 0;
+}
+
+
+/**
+ * @brief Reads the checksum of a file from its extended attribute
+ *
+ * @return  0 if found (and the file did not change since)
+ * @return -1 otherwise
+ */
+static int
+crc_xattr(const char *path, const struct proto_info *info, uint32_t *crc)
+{
+	struct proto_info xinfo;
+	uint8_t xattr[CRC_XATTR_LEN];
+	uint32_t v = 0;
+
+	if ( !CRC_XATTR || ( getxattr(path, CRC_XATTR_NAME, xattr, CRC_XATTR_LEN) != CRC_XATTR_LEN ) )
+		return -1;
+
+	proto_get_info(xattr + PROTO_CRC_LEN, &xinfo, FEAT_X64);
+	if ( ( xinfo.size != info->size ) || ( xinfo.ts != info->ts ) || ( xinfo.ts_ns != info->ts_ns ) )
+		return -1; // file changed since
+
+	memcpy(&v, xattr, PROTO_CRC_LEN);
+	*crc = ntohl(v);
+	return 0;
+}
+
+
+/**
+ * @brief Keeps the checksum of a file in cache
+ *
+ * NOTE: failures are ignored
+ */
+static void
+crc_cache(const char *path, const struct proto_info *info, uint32_t crc)
+{
+	struct cache_ent *ent = NULL;
+	uint8_t *data = NULL;
+
+	if ( ( data = malloc(sizeof(uint32_t)) ) == NULL )
+		return;
+
+	memcpy(data, &crc, sizeof(uint32_t));
+	if ( ( ent = cache_put(CACHE_CRC, path, info, data, sizeof(uint32_t)) ) == NULL )
+		free(data);
+	cache_release(ent);
+}
+
+
+/**
+ * @brief Keeps the checksum of a file in cache and in its extended attribute
+ *
+ * NOTE: failures are ignored (e.g. file system without extended attributes)
+ */
+static void
+crc_store(const char *path, const struct proto_info *info, uint32_t crc)
+{
+	uint8_t xattr[CRC_XATTR_LEN];
+	uint32_t v = htonl(crc);
+
+	crc_cache(path, info, crc);
+
+	if ( !CRC_XATTR )
+		return;
+
+	memcpy(xattr, &v, PROTO_CRC_LEN);
+	proto_put_info(xattr + PROTO_CRC_LEN, info, FEAT_X64);
+	setxattr(path, CRC_XATTR_NAME, xattr, CRC_XATTR_LEN, 0);
+}
+
+
+/**
+ * @brief Writes the next bytes of the checksum after the file content
+ *
+ * @return  nr. of bytes written
+ */
+static int
+put_trailer(struct sfiles *req, uint8_t *buf, int buflen)
+{
+	int n = 0;
+
+	/* computed while sending the file, now complete (a range is not the file) */
+	if ( req->crc_run ) {
+		if ( req->type != SF_RANGE )
+			crc_store(req->filename, &(req->info), req->crc);
+		req->crc_run = 0;
+	}
+
+	for ( ; ( req->tleft > 0 ) && ( n < buflen ); n++, req->tleft-- )
+		buf[n] = ( req->crc >> ( 8 * ( req->tleft - 1 ) ) ) & 0xff;
+
+	return n;
+}
+
+
+/**
+ * @brief Serves a LIST command: "LIST <directory>" or "LIST [<directory>/]<pattern>"
+ *
+ * @return  0 if OK (reply queued)
+ * @return -1 on error
+ */
+static int
+serve_list(int client_socket,
+		   struct sclient *client)
+{
+	char inbuf[PROTO_LINE_MAX+1];
+	char *path    = inbuf+1; // after ' '
+	char *slash   = NULL;
+	char *dir     = path;
+	char *pattern = NULL;
+	struct stat sdir;
+	int n = 0;
+
+	if ( ( n = read_line(client_socket, inbuf, sizeof(inbuf)) ) == -1 )
+		return -1;
+
+	if ( ( n > 1 ) && ( inbuf[0] == ' ' ) ) {
+		/* a pattern in the last component: list the directory before it */
+		slash = strrchr(path, '/');
+		if ( strpbrk(( slash != NULL ? slash+1 : path ), "*?[") != NULL ) {
+			pattern = ( slash != NULL ? slash+1 : path );
+			if ( slash == NULL )
+				dir = ".";
+			else if ( slash == path )
+				dir = "/";
+			else
+				*slash = '\0';
+		}
+
+		if ( ( stat(dir, &sdir) == 0 ) && S_ISDIR(sdir.st_mode) ) {
+			if ( ( add_list_client(dir, strlen(dir), pattern, client) ) < 0 )
+				client->sendError = 1;
+			return 0;
+		}
+	}
+
+	/* notify user 'file not found' or wrong command (ERR) after previous requests */
+	if ( ( add_file_err_client(client, PROTO_ST_NOTFOUND) ) < 0 )
+		client->sendError = 1;
+	return 0;
+}
+
+
+/**
+ * @brief Opens the directory of a LIST request
+ *
+ * NOTE: req->left stays 1 until the end of the manifest is built
+ *
+ * @return  0 if OK
+ * @return -1 if the directory cannot be read
+ * @return -2 on system error
+ */
+static int
+list_open(struct sfiles *req)
+{
+	int ret = 0;
+
+	if ( ( req->zbuf = malloc(LIST_ZBUF_LEN) ) == NULL ||
+		 ( req->dir = malloc(sizeof(struct dir_reader)) ) == NULL )
+		return -2;
+
+	if ( ( ret = dir_open(req->dir, req->filename, (char *) req->data) ) < 0 ) {
+		free(req->dir);
+		req->dir = NULL;
+		if ( ret == -1 )
+			err_ret("ERROR: could not open directory\"%s\"", req->filename);
+		return ret;
+	}
+
+	req->left = 1;
+	req->zlen = req->zpos = 0;
+	return 0;
+}
+
+
+/**
+ * @brief Builds the next manifest entries of a LIST request (the last ones
+ *        are followed by the end of the manifest)
+ *
+ * @return  0 if OK
+ * @return -1 on request error
+ */
+static int
+list_refill(struct sclient *client, struct sfiles *req)
+{
+	char path[PATH_MAX];
+	struct dir_entry ent;
+	uint8_t  *p   = req->zbuf;
+	uint8_t  *end = req->zbuf + LIST_ZBUF_LEN - PROTO_LIST_ENTRY_MAX;
+	uint8_t  *flags = NULL;
+	uint32_t crc = 0;
+	int      len = 0;
+	int      n   = 0;
+
+	while ( p <= end ) {
+
+		if ( ( n = dir_next(req->dir, &ent) ) < 0 ) {
+			err_ret("ERROR: could not read directory\"%s\"", req->filename);
+			return -1;
+		}
+
+		if ( n == 0 ) {
+			*p++ = 0; // end of manifest
+			req->left = 0;
+			break;
+		}
+
+		len = strlen(ent.name);
+		*p++ = len;
+		memcpy(p, ent.name, len);
+		p += len;
+
+		flags  = p++;
+		*flags = ( ent.isdir ? PROTO_LIST_DIR : 0 );
+
+		if ( ( n = proto_put_info(p, &(ent.info), client->features) ) < 0 ) {
+			*flags |= PROTO_LIST_TOOBIG;
+			n = proto_info_len(client->features);
+			memset(p, 0, n);
+		}
+		p += n;
+
+		/* checksum only if known: cached or in the extended attribute */
+		if ( ( client->features & FEAT_CRC ) && !ent.isdir &&
+			 ( snprintf(path, sizeof(path), "%s/%s", req->filename, ent.name) < (int) sizeof(path) ) &&
+			 ( ( crc_peek(path, &(ent.info), &crc) == 0 ) || ( crc_xattr(path, &(ent.info), &crc) == 0 ) ) ) {
+			*flags |= PROTO_LIST_CRC;
+			crc = htonl(crc);
+			memcpy(p, &crc, PROTO_CRC_LEN);
+			p += PROTO_CRC_LEN;
+		}
+	}
+
+	req->zlen = p - req->zbuf;
+	req->zpos = 0;
+	return 0;
+}
+
+
+/**
+ * @brief Reads the next bytes of a LIST manifest or a BNDL archive
+ *
+ * @return  nr. of bytes read if OK
+ * @return -1 on request error
+ * @return -2 on system error
+ */
+static int
+list_read(struct sclient *client, struct sfiles *req, uint8_t *buf, int buflen)
+{
+	int len = 0;
+	int n   = 0;
+
+	while ( len < buflen ) {
+
+		if ( req->zpos == req->zlen ) {
+			if ( req->left == 0 )
+				break; // end of manifest sent
+			if ( ( n = ( req->type == SF_BNDL ? bndl_refill(client, req) : list_refill(client, req) ) ) < 0 )
+				return n;
+		}
+
+		n = ( buflen - len < req->zlen - req->zpos ? buflen - len : req->zlen - req->zpos );
+		memcpy(buf+len, req->zbuf + req->zpos, n);
+		req->zpos += n;
+		len       += n;
+	}
+
+	return len;
+}
+
+
+int
+prio_client(const struct sclient *client)
+{
+	const struct sfiles *p = NULL;
+	int best = PROTO_PRIO_LEVELS;
+
+	for ( p = client->files; ( p != NULL ) && ( best > 0 ); p = p->next_file ) {
+		if ( !(p->waiting) && ( p->prio < best ) )
+			best = p->prio;
+	}
+
+	return best;
+}
+
+
+int
+serve_add_peer(const char *peer)
+{
+	const char *colon = strrchr(peer, ':');
+	const char *host  = peer;
+	size_t     len    = 0;
+
+	if ( ( npeers == REDIR_PEERS_MAX ) || ( colon == NULL ) || ( colon[1] == '\0' ) ||
+		 ( strlen(colon+1) >= NI_MAXSERV ) || ( strpbrk(peer, " \r\n") != NULL ) )
+		return -1;
+
+	len = colon - peer;
+	if ( ( len > 2 ) && ( peer[0] == '[' ) && ( peer[len-1] == ']' ) ) { // IPv6 address
+		++host;
+		len -= 2;
+	}
+	if ( ( len == 0 ) || ( len >= NI_MAXHOST ) )
+		return -1;
+
+	memcpy(peers[npeers].host, host, len);
+	peers[npeers].host[len] = '\0';
+	strcpy(peers[npeers].serv, colon+1);
+	++npeers;
+
+	return 0;
+}
+
+
+int
+serve_pick_peer(void)
+{
+	if ( npeers == 0 )
+		return -1;
+
+	next_peer = ( next_peer + 1 ) % npeers;
+	return next_peer;
+}
+
+
+int
+follow_wake_client(struct sclient *client)
+{
+	struct sfiles *p = NULL;
+	int ret = 0;
+
+	for ( p = client->files; p != NULL; p = p->next_file ) {
+		if ( p->waiting ) {
+			p->waiting = 0;
+			ret = 1;
+		}
+	}
+
+	return ret;
+}
+
+
+/**
+ * @brief Serves a FGET command: "FGET <offset> <limit> <idle> <filename>"
+ *
+ * @return  0 if OK (reply queued)
+ * @return -1 on error
+ */
+static int
+serve_fget(int client_socket,
+		   struct sclient *client)
+{
+	char inbuf[PROTO_LINE_MAX+1];
+	char *p = inbuf;
+	uint64_t offset = 0;
+	uint64_t limit  = 0;
+	uint64_t idle   = 0;
+	int n = 0;
+
+	if ( ( n = read_line(client_socket, inbuf, sizeof(inbuf)) ) == -1 )
+		return -1;
+
+	if ( ( n > 0 ) && ( parse_u64(&p, &offset) == 0 ) && ( parse_u64(&p, &limit) == 0 ) &&
+		 ( parse_u64(&p, &idle) == 0 ) && ( idle <= UINT32_MAX ) && ( *p == ' ' ) &&
+		 ( *(p+1) != '\0' ) && ( strlen(p+1) <= NAME_MAX ) && ( access(p+1, F_OK) != -1 ) ) {
+
+		if ( ( add_follow_client(p+1, strlen(p+1), offset, limit, idle, client) ) < 0 )
+			client->sendError = 1;
+		return 0;
+	}
+
+	/* notify user 'file not found' or wrong command (ERR) after previous requests */
+	if ( ( add_file_err_client(client, PROTO_ST_NOTFOUND) ) < 0 )
+		client->sendError = 1;
+	return 0;
+}
+
+
+/**
+ * @brief Serves a STOP command: "STOP" or "STOP <stream>", ends the oldest
+ *        FGET being served (of the stream given)
+ *
+ * NOTE: STOP has no reply and does not open a stream
+ *
+ * @return  1 if OK (no FGET to stop)
+ * @return  0 if OK (the FGET ends)
+ * @return -1 on error
+ */
+static int
+serve_stop(int client_socket,
+		   struct sclient *client)
+{
+	char inbuf[PROTO_LINE_MAX+1];
+	char *p = inbuf;
+	struct sfiles *req = NULL;
+	uint64_t stream = 0;
+	int n = 0;
+
+	--(client->nrequests);
+
+	if ( ( n = read_line(client_socket, inbuf, sizeof(inbuf)) ) == -1 )
+		return -1;
+
+	if ( ( n != 0 ) && ( ( parse_u64(&p, &stream) < 0 ) || ( *p != '\0' ) ) ) {
+		if ( ( add_error_client(client) ) < 0 )
+			client->sendError = 1;
+		return 0;
+	}
+
+	for ( req = client->files; req != NULL; req = req->next_file ) {
+		if ( ( req->type == SF_FOLLOW ) && !(req->stop) && ( ( n == 0 ) || ( req->stream == stream ) ) ) {
+			req->stop    = 1;
+			req->waiting = 0;
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+
+/**
+ * @brief Opens the file of a FGET request from req->offset and watches it
+ *
+ * NOTE: req->left stays 1 until the end of the reply is built
+ *
+ * @return  0 if OK
+ * @return -1 on request error
+ */
+static int
+follow_open(struct sfiles *req)
+{
+	if ( ( req->fp = fopen(req->filename, "rb") ) == NULL ) {
+		err_ret("ERROR: could not open file\"%s\"", req->filename);
+		return -1;
+	}
+
+	if ( ( req->offset > 0 ) && ( fseeko(req->fp, req->offset, SEEK_SET) < 0 ) ) {
+		err_ret("ERROR: could not seek file\"%s\"", req->filename);
+		return -1;
+	}
+
+	if ( ( req->wd = follow_watch(req->filename) ) < 0 ) {
+		err_ret("ERROR: could not watch file\"%s\"", req->filename);
+		req->wd = 0;
+		return -1;
+	}
+
+	req->left    = 1;
+	req->idle_at = now_ms() + req->block;
+	return 0;
+}
+
+
+/**
+ * @brief Reads the next chunk of a file being followed, or the end of the
+ *        reply; sets req->waiting if there is nothing to send yet
+ *
+ * NOTE: the bytes written before the file was replaced or removed are sent
+ *       before the end of the reply
+ *
+ * @return  nr. of bytes read if OK
+ * @return -1 on request error
+ */
+static int
+follow_read(struct sfiles *req, uint8_t *buf, int buflen)
+{
+	struct stat st;
+	struct stat sname;
+	uint64_t avail  = 0;
+	uint32_t v      = 0;
+	int      reason = -1;
+	size_t   n      = 0;
+
+	if ( buflen < PROTO_CHUNK_HDR + 1 )
+		return 0; // room for the first chunk after the reply header
+
+	if ( fstat(fileno(req->fp), &st) < 0 ) {
+		err_ret("ERROR: could not get file stat");
+		return -1; // only this client is dropped
+	}
+
+	if ( req->stop )
+		reason = PROTO_FOLLOW_STOP;
+	else if ( req->size == 0 )
+		reason = PROTO_FOLLOW_LIMIT;
+	else if ( (uint64_t) st.st_size < req->offset )
+		reason = PROTO_FOLLOW_GONE; // truncated
+	else
+		avail = st.st_size - req->offset;
+
+	/* next chunk */
+	if ( avail > 0 ) {
+		n = ( avail < (uint64_t) ( buflen - PROTO_CHUNK_HDR ) ? avail : (uint64_t) ( buflen - PROTO_CHUNK_HDR ) );
+		if ( n > req->size )
+			n = req->size;
+
+		clearerr(req->fp);
+		if ( ( n = fread(buf + PROTO_CHUNK_HDR, sizeof(uint8_t), n, req->fp) ) > 0 ) {
+			v = htonl(n);
+			memcpy(buf, &v, PROTO_CHUNK_HDR);
+
+			req->offset += n;
+			req->size   -= ( req->size != UINT64_MAX ? n : 0 );
+			req->idle_at = now_ms() + req->block;
+			return PROTO_CHUNK_HDR + n;
+		}
+		reason = PROTO_FOLLOW_GONE; // truncated meanwhile
+	}
+
+	/* nothing appended: replaced, removed, idle or wait */
+	if ( ( reason < 0 ) &&
+		 ( ( st.st_nlink == 0 ) || ( stat(req->filename, &sname) < 0 ) ||
+		   ( sname.st_ino != st.st_ino ) || ( sname.st_dev != st.st_dev ) ) )
+		reason = PROTO_FOLLOW_GONE;
+
+	if ( ( reason < 0 ) && ( req->block > 0 ) && ( now_ms() >= req->idle_at ) )
+		reason = PROTO_FOLLOW_IDLE;
+
+	if ( reason < 0 ) {
+		req->waiting = 1;
+		return 0;
+	}
+
+	memset(buf, 0, PROTO_CHUNK_HDR);
+	buf[PROTO_CHUNK_HDR] = reason;
+	req->left = 0;
+	return PROTO_CHUNK_HDR + 1;
+}
+
+
+/**
+ * @brief Monotonic time in milliseconds
+ */
+static uint64_t
+now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+/**
+ * @brief Serves a BNDL command: "BNDL <directory>"
+ *
+ * @return  0 if OK (reply queued)
+ * @return -1 on error
+ */
+static int
+serve_bndl(int client_socket,
+		   struct sclient *client)
+{
+	char inbuf[PROTO_LINE_MAX+1];
+	char *path = inbuf+1; // after ' '
+	struct stat sdir;
+	int n = 0;
+
+	if ( ( n = read_line(client_socket, inbuf, sizeof(inbuf)) ) == -1 )
+		return -1;
+
+	if ( ( n > 1 ) && ( inbuf[0] == ' ' ) && ( stat(path, &sdir) == 0 ) && S_ISDIR(sdir.st_mode) ) {
+		if ( ( add_bndl_client(path, n-1, client) ) < 0 )
+			client->sendError = 1;
+		return 0;
+	}
+
+	/* notify user 'file not found' or wrong command (ERR) after previous requests */
+	if ( ( add_file_err_client(client, PROTO_ST_NOTFOUND) ) < 0 )
+		client->sendError = 1;
+	return 0;
+}
+
+
+/**
+ * @brief Opens the directory tree of a BNDL request
+ *
+ * NOTE: req->left stays 1 until the end of the archive is built
+ *
+ * @return  0 if OK
+ * @return -1 if the directory cannot be read
+ * @return -2 on system error
+ */
+static int
+bndl_open(struct sfiles *req)
+{
+	int ret = 0;
+
+	if ( ( req->zbuf = malloc(BNDL_ZBUF_LEN) ) == NULL ||
+		 ( req->walk = malloc(sizeof(struct dir_walk)) ) == NULL )
+		return -2;
+
+	if ( ( ret = walk_open(req->walk, req->filename) ) < 0 ) {
+		free(req->walk);
+		req->walk = NULL;
+		if ( ret == -1 )
+			err_ret("ERROR: could not open directory\"%s\"", req->filename);
+		return ret;
+	}
+
+	req->left = 1;
+	req->bfd  = -1;
+	req->zlen = req->zpos = 0;
+	return 0;
+}
+
+
+/**
+ * @brief Builds the next bytes of a BNDL archive: entries and file data, as
+ *        many as fit in the buffer (many small files are sent together)
+ *
+ * @return  0 if OK
+ * @return -1 on request error (a directory could not be read)
+ * @return -2 on system error
+ */
+static int
+bndl_refill(struct sclient *client, struct sfiles *req)
+{
+	struct walk_entry ent;
+	uint8_t  *p    = req->zbuf;
+	uint8_t  *end  = req->zbuf + BNDL_ZBUF_LEN;
+	uint32_t crc   = 0;
+	int      tlen  = ( client->features & FEAT_CRC ? PROTO_CRC_LEN : 0 );
+	int      len   = 0;
+	ssize_t  n     = 0;
+
+	while ( p < end ) {
+
+		/* data of the file being sent, room left for its checksum */
+		if ( ( req->bfd >= 0 ) && ( req->size > 0 ) ) {
+			if ( ( len = end - p - tlen ) <= 0 )
+				break;
+			if ( (uint64_t) len > req->size )
+				len = req->size;
+
+			if ( ( n = read(req->bfd, p, len) ) < 0 && ( errno == EINTR ) )
+				continue;
+
+			if ( n <= 0 ) {
+				/* NOTE: its size was sent already, the client gets a wrong checksum */
+				err_msg("ERROR: file \"%s/%s\" shrank or could not be read.", req->filename, req->walk->path);
+				memset(p, 0, len);
+				n = len;
+				req->crc_run = 0;
+			}
+
+			if ( tlen > 0 )
+				req->crc = crc32c(req->crc, p, n);
+			p         += n;
+			req->size -= n;
+			continue;
+		}
+
+		/* end of the file being sent */
+		if ( req->bfd >= 0 ) {
+			close(req->bfd);
+			req->bfd = -1;
+
+			if ( tlen > 0 ) {
+				crc = htonl( req->crc_run ? req->crc : ~(req->crc) );
+				memcpy(p, &crc, PROTO_CRC_LEN);
+				p += PROTO_CRC_LEN;
+			}
+			continue;
+		}
+
+		/* next entry */
+		if ( end - p < PROTO_BNDL_HDR_MAX )
+			break;
+
+		if ( ( n = walk_next(req->walk, &ent) ) == -1 ) {
+			err_ret("ERROR: could not read directory \"%s\"", req->filename);
+			return -1; // only this client is dropped
+		} else if ( n < 0 )
+			return -2;
+
+		if ( n == 0 ) {
+			*p++ = PROTO_BNDL_END;
+			req->left = 0;
+			break;
+		}
+
+		len = strlen(ent.path);
+		p[0] = ( ent.isdir ? PROTO_BNDL_DIR : PROTO_BNDL_FILE );
+		p[1] = ( len >> 8 ) & 0xff;
+		p[2] = len & 0xff;
+		memcpy(p+3, ent.path, len);
+
+		if ( ( n = proto_put_info(p+3+len, &(ent.info), client->features) ) < 0 ) {
+			err_msg("ERROR: file \"%s/%s\" size or timestamp too big, not sent.", req->filename, ent.path);
+			if ( ent.fd >= 0 )
+				close(ent.fd);
+			continue;
+		}
+		p += 3 + len + n;
+
+		if ( !ent.isdir ) {
+			req->bfd     = ent.fd;
+			req->size    = ent.info.size;
+			req->crc     = 0;
+			req->crc_run = 1;
+		}
+	}
+
+	req->zlen = p - req->zbuf;
+	req->zpos = 0;
+	return 0;
+}
+
+
+/**
+ * @brief Serves a PRIO command: "PRIO <class>", the class of the next
+ *        requests, also marking the packets of the connection
+ *
+ * @return  1 if OK (no reply)
+ * @return  0 if an error reply was queued
+ * @return -1 on error
+ */
+static int
+serve_prio(int client_socket,
+		   struct sclient *client)
+{
+	static const int tos[PROTO_PRIO_LEVELS]  = { IPTOS_LOWDELAY, 0, 0x20 }; // bulk: CS1, lower effort
+	static const int prio[PROTO_PRIO_LEVELS] = { 6, 0, 2 }; // TC_PRIO_INTERACTIVE, BESTEFFORT, BULK
+	char inbuf[PROTO_LINE_MAX+1];
+	char *p = inbuf;
+	uint64_t cls = 0;
+
+	--(client->nrequests); // not a stream
+
+	if ( read_line(client_socket, inbuf, sizeof(inbuf)) == -1 )
+		return -1;
+
+	if ( ( parse_u64(&p, &cls) < 0 ) || ( *p != '\0' ) || ( cls >= PROTO_PRIO_LEVELS ) ) {
+		if ( ( add_error_client(client) ) < 0 )
+			client->sendError = 1;
+		return 0;
+	}
+
+	client->prio = cls;
+
+	/* NOTE: best effort, IP_TOS fails on IPv6 sockets; IP_TOS also sets the priority */
+	setsockopt(client_socket, IPPROTO_IP, IP_TOS, &(tos[cls]), sizeof(int));
+#ifdef SO_PRIORITY
+	setsockopt(client_socket, SOL_SOCKET, SO_PRIORITY, &(prio[cls]), sizeof(int));
+#endif
+
+	return 1;
+}
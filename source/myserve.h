@@ -0,0 +1,107 @@
+#ifndef _MYSERVE_H
+#define _MYSERVE_H
+
+#include <inttypes.h> // uint32_t
+
+#include "myproto.h"
+#include "myclients.h"
+
+/* DATA DEFINITION */
+
+#define REDIR_PEERS_MAX		(16)	// max peers clients are redirected to
+
+/* FUNCTIONS */
+
+/**
+ * @brief Serves a client reading what he has sent
+ *
+ * @param client_socket     client socket
+ * @param client            client info
+ *
+ * @return  2 if client requested to close connection
+ * @return  1 if OK,
+ * @return  0 if OK and there is data to be sent to the client,
+ * @return -1 on error
+ */
+int serve_client_rd(int client_socket,
+                    struct sclient *client);
+
+/**
+ * @brief Serves a client sending him data.
+ *
+ * NOTE: while all the requests being served wait for their files to grow
+ *       (FOLLOW) the socket must not be selected for writing: the client is
+ *       woken up by follow_wake_client()
+ *
+ * @param client_socket     client socket
+ * @param client            client info
+ * @param buflen            send buffer lenght
+ *
+ * @return  3 if OK and the requests wait for their files to grow,
+ * @return  1 if OK and all data sent to client,
+ * @return  0 if OK and there is data to be sent to the client,
+ * @return -1 on function error (close client connection)
+ * @return -2 on system error (server shutdown)
+ */
+int serve_client_wr(int client_socket,
+                    struct sclient *client,
+                    int buflen);
+
+/**
+ * @brief Retrieves file size and last modified timestamp
+ *
+ * @param filename          file name
+ * @param info              reference to file info
+ *
+ * @return   0 if OK
+ * @return  -1 on error
+ */
+int get_info_file(char* filename, struct proto_info *info);
+
+/**
+ * @brief Gets the highest priority class of the requests of a client that
+ *        have something to send (PRIO): the clients of the highest class
+ *        ready for writing are served first
+ *
+ * @param client            client info
+ *
+ * @return  the class (PROTO_PRIO_*)
+ * @return  PROTO_PRIO_LEVELS if there is nothing to send
+ */
+int prio_client(const struct sclient *client);
+
+/**
+ * @brief Adds a peer new clients can be sent to when the server is busy
+ *        (REDIR)
+ *
+ * @param peer              "<host>:<port>" ("[<IPv6 address>]:<port>")
+ *
+ * @return   0 if OK
+ * @return  -1 on wrong format or too many peers (REDIR_PEERS_MAX)
+ */
+int serve_add_peer(const char *peer);
+
+/**
+ * @brief Picks the peer the next redirected client is sent to (round robin)
+ *
+ * NOTE: a client is redirected on its FEAT command if it offered REDIR and
+ *       its 'peer' was set
+ *
+ * @return  peer index if OK
+ * @return -1 if there are no peers
+ */
+int serve_pick_peer(void);
+
+/**
+ * @brief Wakes up the requests of a client waiting for their files to grow
+ *        (FOLLOW), after a change of a watched file (see follow_fd()) or
+ *        every FOLLOW_TICK_MS (idle timeouts)
+ *
+ * @param client            client info
+ *
+ * @return  1 if the client has data to send (select it for writing)
+ * @return  0 otherwise
+ */
+int follow_wake_client(struct sclient *client);
+
+#endif
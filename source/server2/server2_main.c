@@ -24,22 +24,20 @@
 #include "../mylibsock.h"
 #include "../mylibtcp.h"
 #include "../myclients.h"
+#include "../myserve.h"
+#include "../myfollow.h"
 
 
 #ifndef CHILD_MAX
 #define CHILD_MAX 128
 #endif
 
-#define BUF_MAX			(NAME_MAX+7)
 #define SO_SNDBUF_MAX	(8120)
 #define SEL_TIMEOUT		(10)
 #define ATTEMPTS_MAX	(2)
+#define USAGE			"ERROR - usage: %s [-r <peer host>:<port>]... [-L <max clients>] [-Q <max requests>] [-B <max bytes>] <server port>"
 
 /* FUCNTIONS PROTOTYPES */
-int     serve_client_rd(int client_socket, struct sclient **client);
-int     serve_client_wr(int client_socket, struct sclient **client, \
-						int buflen);
-int     get_info_file(char* filename, uint32_t* ts, uint32_t* size);
 int 	get_SO_SNDBUF(int sock);
 void 	init_server(struct sclient **client);
 
@@ -69,9 +67,37 @@ int main (int argc, char *argv[])
 	fd_set active_rset, active_wset;
 	fd_set ready_rset, ready_wset;
 	struct timeval tv;
+	int load_max = -1;  // REDIR: clients served before sending new ones to peers (-1 no limit, 0 none)
+	int peer     = -1; // REDIR: peer the new client is sent to
+	int opt      = 0;
+
+	while ( ( opt = getopt(argc, argv, "r:L:Q:B:") ) != -1 ) {
+		switch ( opt ) {
+			case 'r':
+				if ( serve_add_peer(optarg) < 0 )
+					err_quit("ERROR: wrong peer \"%s\" (or more than %d).", optarg, REDIR_PEERS_MAX);
+				break;
+			case 'L':
+				if ( ( load_max = atoi(optarg) ) < 0 )
+					err_quit("ERROR: max clients must be at least 0.");
+				break;
+			case 'Q':
+				if ( atol(optarg) < 1 || atol(optarg) > INT32_MAX )
+					err_quit("ERROR: max queued requests must be in [1, %d].", INT32_MAX);
+				set_queue_limits(atol(optarg), 0);
+				break;
+			case 'B':
+				if ( atoll(optarg) < 1 )
+					err_quit("ERROR: max queued bytes must be at least 1.");
+				set_queue_limits(0, atoll(optarg));
+				break;
+			default:
+				err_quit(USAGE, argv[0]);
+		}
+	}
 
-	if ( argc < 2 )
-		err_quit("ERROR - usage: %s <server port>", argv[0]);
+	if ( argc - optind < 1 )
+		err_quit(USAGE, argv[0]);
 
 	dadpid = getpid();
 	Signal(SIGINT, handle_SIGINT);
@@ -79,7 +105,7 @@ int main (int argc, char *argv[])
 
 	init_server(client); // initialize variables
 
-	if ( ( listen_socket = tcp_listen(NULL, argv[1], &addrlen) ) < 0 )
+	if ( ( listen_socket = tcp_listen(NULL, argv[optind], &addrlen) ) < 0 )
 		exit(-1);
 
 	/* get socket options rcvbuflen */
@@ -93,6 +119,9 @@ int main (int argc, char *argv[])
 			continue;
 		}
 
+		/* busy: the new client will be sent to a peer (REDIR), picked here for round robin */
+		peer = ( ( load_max >= 0 ) && ( nchilds >= load_max ) ? serve_pick_peer() : -1 );
+
 		if ( ( new_pid = fork() ) < 0 ) {
 
 			/* ERROR */
@@ -117,6 +146,7 @@ int main (int argc, char *argv[])
 				close(new_socket);
 				exit(-1);
 			}
+			client[0]->peer = peer;
 
 			/* initialize sets */
 			FD_ZERO(&active_rset);
@@ -125,12 +155,14 @@ int main (int argc, char *argv[])
 
 			for ( attempts = 0; attempts < ATTEMPTS_MAX ; ) {
 
-				/* select active socket */
+				/* select active socket (and followed files, checked every tick) */
 				memcpy((char *) &ready_rset, (char *) &active_rset, sizeof(fd_set));
 				memcpy((char *) &ready_wset, (char *) &active_wset, sizeof(fd_set));
+				if ( follow_fd() >= 0 )
+					FD_SET(follow_fd(), &ready_rset);
 				/* initialize time */
-				tv.tv_sec  = SEL_TIMEOUT;
-				tv.tv_usec = 0;
+				tv.tv_sec  = ( follow_active() ? 0 : SEL_TIMEOUT );
+				tv.tv_usec = ( follow_active() ? FOLLOW_TICK_MS * 1000 : 0 );
 
 				n = Select(FD_SETSIZE, &ready_rset, &ready_wset, NULL, &tv);
 				if ( n < 0 ) {
@@ -139,6 +171,16 @@ int main (int argc, char *argv[])
 					exit(-1); // select failed
 				}
 
+				/* a followed file changed, or tick: a client following files is not idle */
+				if ( ( ( n == 0 ) && follow_active() ) ||
+					 ( ( follow_fd() >= 0 ) && FD_ISSET(follow_fd(), &ready_rset) ) ) {
+					follow_drain();
+					if ( follow_wake_client(client[0]) )
+						FD_SET(new_socket, &active_wset);
+					attempts = 0;
+					continue;
+				}
+
 				if ( n == 0 ) {
 					++attempts;
 					continue;
@@ -147,7 +189,7 @@ int main (int argc, char *argv[])
 				if ( FD_ISSET(new_socket, &ready_rset) ) {
 
 					attempts = 0;
-					switch ( serve_client_rd(new_socket, client) ) {
+					switch ( serve_client_rd(new_socket, client[0]) ) {
 
 						case 2: // client received all files
 							rm_client(0, client, NULL);
@@ -174,12 +216,17 @@ int main (int argc, char *argv[])
 							break;
 					}
 
+					/* request queue full: the socket is read again once some requests were served */
+					if ( queue_full(client[0]) )
+						FD_CLR(new_socket, &active_rset);
+
 				} else if ( FD_ISSET(new_socket, &ready_wset) ) {
 
 					attempts = 0;
-					switch ( serve_client_wr(new_socket, client, sndbuflen) ) {
+					switch ( serve_client_wr(new_socket, client[0], sndbuflen) ) {
 
 						case 1: // OK, all data sent to client
+						case 3: // OK, waiting for followed files to grow
 							FD_SET(new_socket, &active_rset);
 							FD_CLR(new_socket, &active_wset);
 							break;
@@ -203,6 +250,9 @@ int main (int argc, char *argv[])
 							exit(-1);
 							break;
 					}
+
+					if ( queue_full(client[0]) )
+						FD_CLR(new_socket, &active_rset);
 				}
 			}
 			rm_client(0, client, NULL);
@@ -215,246 +265,6 @@ int main (int argc, char *argv[])
 }
 
 
-/**
- * @brief Serves a client reading what he has sent
- *
- * @param csock		Client socket
- * @param client	Client info
- *
- * @return  2 if client requested to close connection
- * @return  1 if OK,
- * @return  0 if OK and there is data to be sent to the client,
- * @return -1 on error
- */
-int
-serve_client_rd(int client_socket,
-				struct sclient **client)
-{
-	int cid   = 0; // client ID, only one client in this case
-	int fnlen = 0; // filename length
-	char inbuf[BUF_MAX];
-	int there_is_data_to_send = 0;
-
-
-	/* read data from client */
-	if ( (Readn(client_socket, inbuf, 4)) <= 0 )
-		return -1; // remove client and exit
-
-	/* identify command received */
-	if ( strncmp((char*) inbuf, "QUIT", 4) == 0 ) {
-		Readn(client_socket, inbuf, 2); // consume '\r\n'
-		return 2; // remove client and exit gracefully
-	}
-
-	if ( strncmp((char*) inbuf, "GET ", 4) != 0 ) {
-		/* wrong command */
-		client[cid]->sendError = 1;
-		return 0;
-
-	} else {
-
-		/* get file name */
-		for ( fnlen = 0; fnlen < BUF_MAX ; fnlen++ ) {
-			if ( (Readn(client_socket, inbuf+fnlen, 1)) <= 0 )
-				return -1;
-
-			if ( fnlen < 2 ) continue;	// filename len at least 1
-
-			if ( (inbuf[fnlen-1] == '\r') && (inbuf[fnlen] == '\n') ){
-				inbuf[fnlen-1] = '\0';
-				break;
-			}
-		}
-		inbuf[fnlen] = '\0'; // if fnlen == BUF_MAX
-
-		/* if file exists add it to files waiting to be uploaded */
-		if ( access(inbuf, F_OK) != -1 ) {
-
-			if ( ( add_file_client(inbuf, fnlen, client[cid]) ) < 0 ) {
-				client[cid]->sendError = 1;
-				return 0; // notify user there was an error (ERR)
-			}
-
-			there_is_data_to_send = 1;
-
-		} else {
-			client[cid]->sendError = 1;
-			return 0; // notify user 'file not found' (ERR)
-		}
-
-		if ( there_is_data_to_send )
-			return 0;
-	}
-
-	/* should never get here */
-	return -1;
-}
-
-
-/**
- * @brief Serves a client sending him data.
- *
- * @param csock		Client socket
- * @param client	Client info
- * @param buflen	Send buffer lenght
- *
- * @return  1 if OK and all data sent to client,
- * @return  0 if OK and there is data to be sent to the client,
- * @return -1 on function error (close client connection)
- * @return -2 on system error (server shutdown)
- */
-int
-serve_client_wr(int client_socket,
-				struct sclient **client,
-				int buflen)
-{
-	int cid        = 0; // client ID, only one client in this case
-
-	FILE     **fp    = &(client[cid]->cfp);
-	int      sError  = client[cid]->sendError;
-	uint32_t *btbwcf = &(client[cid]->bytesToBeWrittenCF);
-
-	char* filename     = NULL;
-	uint32_t file_ts   = 0; // file timestamp
-	uint32_t file_size = 0; // file size
-
-	unsigned char *outbuf = NULL;
-	int n    = 0;
-	int serr = 0;
-
-	if ( ( outbuf = calloc(buflen, sizeof(unsigned char)) ) == NULL ){
-		err_ret("ERROR: could not malloc buffer");
-		return -2;
-	}
-
-	/* client must be notified of an error, connection will be closed */
-	if ( sError ) {
-
-		if ( ( snprintf((char*) outbuf, 7, "-ERR\r\n") ) < 0 ) {
-			free(outbuf);
-			return -2; // sys error
-		} else {
-			Writen(client_socket, outbuf, 6);
-		}
-
-		free(outbuf);
-		return -1; // user will be deleted, process terminated
-	}
-
-
-	if ( (*fp) != NULL ) {
-
-		/* if a file was already being uploaded,read new data from file
-		 * and send it
-		 */
-		n = ( (*btbwcf) < ((uint32_t) buflen) ? (*btbwcf) : buflen ); // NOTE: buflen is always < INT_MAX
-
-		/* read new data from file */
-		if ( (serr = fread(outbuf, sizeof(unsigned char), n, *fp)) < n ) {
-			if ( feof(*fp) || ferror(*fp) ) {
-				err_msg("ERROR: cannot read file.");
-				client[cid]->sendError = 1;
-				free(outbuf);
-				return 0; // error reading file, notify user
-			} else {
-				free(outbuf);
-				return -2; // sys error
-			}
-		}
-
-		/* upload new data */
-		if ( (Writen(client_socket, outbuf, serr)) < 0 ) {
-			free(outbuf);
-			return -1; // user will be deleted, process terminated
-		}
-
-		*btbwcf -= serr; // update n. of Bytes To Be Written from Current File
-
-	} else {
-
-		/* if no file was being uploaded
-		 * - read files list and retrieve next filename
-		 * - read size and last modified timestamp for file
-		 * - open file and send header + first bytes from file
-		 */
-
-		/* get next file name to send to client */
-		if ( ( filename = get_next_file_client(client[cid]) ) == NULL ) {
-			free(outbuf);
-			return 1; // sent all client-requested files till now
-		}
-
-		/* read file size and timestamp */
-		if ( ( get_info_file(filename, &file_ts, &file_size) ) < 0 ){
-			err_msg("ERROR: file size or timestamp too big.");
-			client[cid]->sendError = 1;
-			free(outbuf);
-			return 0; // file may be bigger than 2^32, there would be overflow
-		}
-		*btbwcf = file_size; // save file size into client structure
-
-		/* open file */
-		if ( ( (*fp) = fopen(filename, "rb") ) == NULL ) {
-			err_ret("ERROR: could not open file\"%s\"", filename);
-			client[cid]->sendError = 1;
-			free(outbuf);
-			return 0;
-		}
-
-		/* prepare response header */
-		if ( snprintf((char*) outbuf, 6,"+OK\r\n") < 0 ) {
-			free(outbuf);
-			return -2; // sys error
-		}
-
-		*((uint32_t*) (outbuf+5)) = htonl(file_size);
-		*((uint32_t*) (outbuf+9)) = htonl(file_ts);
-
-		/* read also some bytes from file */
-		n = ( (*btbwcf) < ((uint32_t) (buflen-13)) ? (*btbwcf) : (buflen-13) );
-		if ( (serr = fread(outbuf+13, sizeof(unsigned char), n, *fp) ) < n ) {
-			if ( feof(*fp) || ferror(*fp) ) {
-				err_msg("ERROR: cannot read file.");
-				client[cid]->sendError = 1;
-				free(outbuf);
-				return 0; // error reading file, notify user
-			} else {
-				free(outbuf);
-				return -2;
-			}
-		}
-		/* send data to client */
-		if ( ( Writen(client_socket, outbuf, n+13) ) < 0 ) {
-			free(outbuf);
-			return -1; // user will be deleted, process terminated
-		}
-
-		*btbwcf -= serr; // update n. of Bytes To Be Written in Current File
-	}
-
-	free(outbuf);
-
-	/* if all file was sent, check if there is another file to send */
-	if ( (*btbwcf) == 0 ) {
-		fclose(*fp);
-		*fp = NULL;
-
-		if ( ( rm_head_file_client(client[cid]) ) < 0 )
-			return -1; // user will be deleted, process terminated
-
-		if ( there_are_more_files(client[cid]) )
-			return 0; // more data to send to user
-	 	else
-			return 1; // no more data to send to user
-
-	} else
-		return 0; // there is still data to be sent from current file
-
-	/* should never get here */
-	return -1;
-}
-
-
 /**
  * @brief Gets the default length of the output socket buffer
  *
@@ -484,34 +294,6 @@ get_SO_SNDBUF(int sock)
 
 
 
-/**
- * @brief Retrieves file size and last modified timestamp
- *
- * @param filename			file name
- * @param ts				reference to file timestamp
- * @param size				reference to file size
- *
- * @return	 0 if OK
- * @return	-1 on error
- */
-int
-get_info_file(char* filename, uint32_t* ts, uint32_t* size)
-{
-	struct stat sfile;
-
-	if ( (stat(filename, &sfile)) < 0 ) {
-		err_ret("ERROR: could not get file stat");
-		return -1;
-	}
-
-	if ( ( sfile.st_size > UINT32_MAX ) || ( sfile.st_mtime > UINT32_MAX ) )
-		return -1; // file size > 4GB or timestamp > int32_t max value
-
-	*ts		= sfile.st_mtime;
-	*size 	= sfile.st_size;
-	return 0;
-}
-
 void
 init_server(struct sclient **client)
 {
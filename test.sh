@@ -12,6 +12,7 @@ SERVER1="server1_sol"
 SERVER1_DIR="server1"
 CLIENT1="client1_sol"
 CLIENT1_DIR="client1"
+MIRROR1="mirror1_sol"	# second instance of the student's server
 
 TESTCLIENT1="client1_ref"
 TESTSERVER1="server1_ref"
@@ -36,7 +37,7 @@ MAX_WAITING_TIME=5	# This parameter must be a positive integer
 # Kill al the client and server processes that are still running
 function killProcesses
 {
-    killall -9 $SERVER1 $TESTSERVER1 $CLIENT1 $TESTCLIENT1 2>&1 &> /dev/null
+    killall -9 $SERVER1 $MIRROR1 $TESTSERVER1 $CLIENT1 $TESTCLIENT1 2>&1 &> /dev/null
 }
 
 
@@ -221,11 +222,12 @@ function setupTempClientDir
 # $1: the server to be run (including path relative to server directory)
 # $2: the directory of the server to be run
 # $3: the file for recording the server standard output and error
+# $4: if given, the port to listen on (a free port is found otherwise)
 # Return value: the listening port or -1 in case of error
 function runServer
 {
     pushd $2 >> /dev/null
-    local FREE_PORT=`./$PORTFINDER`     # This will find a free port
+    local FREE_PORT=${4:-`./$PORTFINDER`}     # This will find a free port
     $1 $FREE_PORT &> $3 &               # Launch server with free port on cmd line
     res=$(ensureServerStarted $FREE_PORT)
     if [[ $res != "0" ]] ; then
@@ -347,6 +349,49 @@ function ensureServerStarted
 	echo "-1"
 }
 
+#*************************************RUN CLIENT WITH OPTIONS********************************************
+# Runs the specified client in the specified directory, with options before the server address
+# Arguments:
+# $1: the client to be run (name of executable file)
+# $2: the directory of the client to be run
+# $3: the file for recording the client standard output and error
+# $4...: the arguments of the client (options, address, port, files)
+# Sets $rc to the client exit code
+function runClientArgs
+{
+    local cli=$1
+    local cli_dir=$2
+    local out=$3
+    shift 3
+    echo "Running client $cli (arguments: $@) ..."
+    ( cd "$cli_dir" && $TIMEOUT $MAX_EXEC_TIME ./$cli "$@" &> "$out" )
+    rc=$?
+}
+
+#*************************************TEST A CONDITION***************************************************
+# Records the result of a check as the next test
+# Stores result ("passed" or "failed") in global var $result
+# Arguments:
+# $1: what is checked
+# $2: "0" if the check passed
+# $3: the message printed if it failed
+function testCondition
+{
+    test_number=$(($test_number + 1))
+    echo -e "\n\n[TEST $test_suite.$test_number] Checking $1 ..."
+    local tname="TEST_$test_suite$test_number"
+    local tname+="_PASSED"
+    if [[ $2 == "0" ]] ; then
+        echo -e "\t[++TEST $test_suite.$test_number PASSED++] "
+        eval ${tname}=true
+        result=passed
+    else
+        echo -e "\t[--TEST $test_suite.$test_number FAILED--] $3"
+        eval ${tname}=false
+        result=failed
+    fi
+}
+
 #*************************************TEST CLIENT-SERVER INTERACTION*************************************
 # Runs the specified server and client and performs a number of tests
 # Arguments:
@@ -394,6 +439,765 @@ function testClientServerInteraction
 
 }
 
+#*************************************TEST COMPRESSED AND VERIFIED TRANSFER******************************
+# Runs the specified server and client on a file bigger than the compression cache (compressed while
+# sent): fetches it compressed and verified, then verified only (checksum stored by the first fetch)
+# Arguments:
+# $1: server to be run (name of executable file)
+# $2: client to be run (name of executable file)
+#
+function testLzCrcLargeFile
+{
+    local fname="big_file1.txt"
+
+    setupTempServerDir "$1" "/tmp/temp_server_dir_$$"
+    setupTempClientDir "$2" "/tmp/temp_client_dir_$$"
+    seq 1 1500000 > "/tmp/temp_server_dir_$$/$fname"	# more than 8 MiB
+
+    echo -e "Running server $1 ...\n\n"
+    server_port=$(runServer "./$1" "/tmp/temp_server_dir_$$" "$1output$test_suite.txt")
+    if [[ $server_port -eq "-1" ]] ; then
+        echo -e "Server did not start."
+        return
+    else
+        echo -e "\t $1 [PORT $server_port] Ok!"
+    fi
+
+    for opts in "-z -v" "-v"
+    do
+        rm -f "/tmp/temp_client_dir_$$/$fname"
+        echo "Running client $2 (options $opts, server 127.0.0.1, port $server_port, file $fname) ..."
+        ( cd "/tmp/temp_client_dir_$$" && $TIMEOUT $MAX_EXEC_TIME ./$2 $opts "127.0.0.1" "$server_port" "$fname" &> /dev/null )
+        rc=$?
+
+        test_number=$(($test_number + 1))
+        echo -e "\n\n[TEST $test_suite.$test_number] Checking the client completed the transfer ..."
+        local tname="TEST_$test_suite$test_number"
+        local tname+="_PASSED"
+        if [[ $rc == 0 ]] ; then
+            echo -e "\t[++TEST $test_suite.$test_number PASSED++] "
+            eval ${tname}=true
+        else
+            echo -e "\t[--TEST $test_suite.$test_number FAILED--] Client exited with code $rc"
+            eval ${tname}=false
+        fi
+
+        testFilesEquality "/tmp/temp_server_dir_$$" "/tmp/temp_client_dir_$$" "$fname"
+    done
+}
+
+#*************************************TEST STREAMED OUTPUT***********************************************
+# Runs the specified server and client with the files written on the standard output (-o 1), then
+# splits the stream by its "<size> <timestamp> <filename>" lines and compares every file
+# Arguments:
+# $1: server to be run (name of executable file)
+# $2: client to be run (name of executable file)
+#
+function testStreamOutput
+{
+    local sdir="/tmp/temp_server_dir_$$"
+    local cdir="/tmp/temp_client_dir_$$"
+    local stream="/tmp/temp_stream_$$"
+    local size=""
+    local tstamp=""
+    local fname=""
+    local names=""
+    local line=""
+    local off=0
+
+    setupTempServerDir "$1" "$sdir"
+    setupTempClientDir "$2" "$cdir"
+    seq 1 1500000 > "$sdir/big_file1.txt"
+    head -c 100000 /dev/urandom > "$sdir/binary_file1.bin"
+    : > "$sdir/empty_file1.txt"
+
+    echo -e "Running server $1 ...\n\n"
+    server_port=$(runServer "./$1" "$sdir" "$1output$test_suite.txt")
+    if [[ $server_port -eq "-1" ]] ; then
+        echo -e "Server did not start."
+        return
+    else
+        echo -e "\t $1 [PORT $server_port] Ok!"
+    fi
+
+    echo "Running client $2 (options -o 1, server 127.0.0.1, port $server_port) ..."
+    ( cd "$cdir" && $TIMEOUT $MAX_EXEC_TIME ./$2 -o 1 "127.0.0.1" "$server_port" "$TEST_FILE" big_file1.txt \
+        missing_file1.txt empty_file1.txt binary_file1.bin > "$stream" 2> /dev/null )
+    testCondition "the client completed the transfer" "$?" "Client exited with an error"
+
+    # split the stream: each file is preceded by its "<size> <timestamp> <filename>" line
+    while (( $off < $(stat -c %s "$stream") ))
+    do
+        line=$(tail -c +$(($off + 1)) "$stream" | head -n 1)
+        read -r size tstamp fname <<< "$line"
+        if [[ ! $size =~ ^[0-9]+$ ]] || [[ ! $tstamp =~ ^[0-9]+$ ]] || [[ -z $fname ]] ; then
+            names+=" (bad line)"
+            break
+        fi
+        off=$(($off + ${#line} + 1))
+        tail -c +$(($off + 1)) "$stream" | head -c "$size" > "$cdir/$fname"
+        off=$(($off + $size))
+        names+=" $fname"
+    done
+    [[ $names == " $TEST_FILE big_file1.txt empty_file1.txt binary_file1.bin" ]]
+    testCondition "the stream holds the files received, in order" "$?" "Files streamed:$names"
+
+    for fname in "$TEST_FILE" big_file1.txt empty_file1.txt binary_file1.bin
+    do
+        testFilesEquality "$sdir" "$cdir" "$fname"
+    done
+}
+
+#*************************************TEST MIRROR FAILOVER***********************************************
+# Runs two instances of the specified server with the same files and fetches them from both (-M),
+# killing one of them while the files are received; then fetches them from two servers that both die
+# Arguments:
+# $1: server to be run (name of executable file)
+# $2: client to be run (name of executable file)
+#
+function testMirrorFailover
+{
+    local sdir="/tmp/temp_server_dir_$$"
+    local mdir="/tmp/temp_mirror_dir_$$"
+    local cdir="/tmp/temp_client_dir_$$"
+    local out="/tmp/temp_client_output_$$"
+    local mirror=$MIRROR1
+    local files="$TEST_FILE"
+    local mirror_port=""
+    local cli_pid=""
+    local fname=""
+    local i=0
+
+    setupTempServerDir "$1" "$sdir"
+    setupTempServerDir "$1" "$mdir"
+    mv -f "$mdir/$1" "$mdir/$mirror"	# to be killed alone
+    setupTempClientDir "$2" "$cdir"
+    for (( i=1; i<=8; i++ ))
+    do
+        seq $i 1500000 > "$sdir/big_file$i.txt"	# more than 8 MiB each
+        cp -f "$sdir/big_file$i.txt" "$mdir"
+        files+=" big_file$i.txt"
+    done
+
+    echo -e "Running servers $1 and $mirror ...\n\n"
+    server_port=$(runServer "./$1" "$sdir" "$1output$test_suite.txt")
+    mirror_port=$(runServer "./$mirror" "$mdir" "$mirror""output$test_suite.txt")
+    if [[ $server_port -eq "-1" ]] || [[ $mirror_port -eq "-1" ]] ; then
+        echo -e "Server did not start."
+        return
+    else
+        echo -e "\t $1 [PORT $server_port] $mirror [PORT $mirror_port] Ok!"
+    fi
+
+    # the mirror is killed as soon as the files are being received
+    echo "Running client $2 (arguments: -M 127.0.0.1:$mirror_port 127.0.0.1 $server_port $files) ..."
+    ( cd "$cdir" && $TIMEOUT $MAX_EXEC_TIME ./$2 -M "127.0.0.1:$mirror_port" "127.0.0.1" "$server_port" $files &> "$out" ) &
+    cli_pid=$!
+    for (( i=1; i<=500; i++ ))
+    do
+        ls "$cdir"/*.part &> /dev/null && break
+        sleep 0.01
+    done
+    killall -STOP $mirror &> /dev/null
+    sleep 0.5
+    killall -9 $mirror &> /dev/null
+    wait $cli_pid
+    testCondition "the client completed the transfer after a mirror died" "$?" "Client exited with an error"
+
+    for fname in $files
+    do
+        testFilesEquality "$sdir" "$cdir" "$fname"
+    done
+
+    ! ls "$cdir"/*.part "$cdir"/*.resume &> /dev/null
+    testCondition "no partial file was left" "$?" "Partial files left: $(cd "$cdir" && ls *.part *.resume 2> /dev/null)"
+
+    # every server dies while the client waits for them
+    mirror_port=$(runServer "./$mirror" "$mdir" "$mirror""output$test_suite.txt")
+    rm -f "$cdir"/big_file*
+    killall -STOP $1 $mirror &> /dev/null
+    echo "Running client $2 (arguments: -M 127.0.0.1:$mirror_port 127.0.0.1 $server_port $files) ..."
+    ( cd "$cdir" && $TIMEOUT $MAX_EXEC_TIME ./$2 -M "127.0.0.1:$mirror_port" "127.0.0.1" "$server_port" $files &> "$out" ) &
+    cli_pid=$!
+    sleep 0.5
+    killall -9 $1 $mirror &> /dev/null
+    wait $cli_pid
+    rc=$?
+    [[ $rc != 0 ]] && [[ $rc != 124 ]] && grep -q "all connections lost" "$out"
+    testCondition "the client failed when every server died" "$?" "Client exited with code $rc: $(tail -n 1 "$out")"
+}
+
+#*************************************TEST PARALLEL TRANSFERS********************************************
+# Runs the specified server and client over 4 connections (-j 4) on large and small files and a missing
+# one
+# Arguments:
+# $1: server to be run (name of executable file)
+# $2: client to be run (name of executable file)
+#
+function testParallelJobs
+{
+    local sdir="/tmp/temp_server_dir_$$"
+    local cdir="/tmp/temp_client_dir_$$"
+    local out="/tmp/temp_client_output_$$"
+    local files="$TEST_FILE"
+    local i=0
+
+    setupTempServerDir "$1" "$sdir"
+    setupTempClientDir "$2" "$cdir"
+    for (( i=1; i<=3; i++ ))
+    do
+        seq $i 1500000 > "$sdir/big_file$i.txt"	# more than 8 MiB each
+        files+=" big_file$i.txt"
+    done
+    for (( i=1; i<=20; i++ ))
+    do
+        seq $i $(($i * 100)) > "$sdir/tiny_file$i.txt"	# not to overwrite $TEST_FILE
+        files+=" tiny_file$i.txt"
+    done
+
+    echo -e "Running server $1 ...\n\n"
+    server_port=$(runServer "./$1" "$sdir" "$1output$test_suite.txt")
+    if [[ $server_port -eq "-1" ]] ; then
+        echo -e "Server did not start."
+        return
+    else
+        echo -e "\t $1 [PORT $server_port] Ok!"
+    fi
+
+    runClientArgs "$2" "$cdir" "$out" -j 4 "127.0.0.1" "$server_port" $files missing_file1.txt
+    testCondition "the client completed the transfer" "$rc" "Client exited with code $rc"
+
+    testAllFilesEquality "$sdir" "$cdir" $files
+
+    [[ $(grep -c "missing_file1.txt" "$out") == 1 ]] && [[ ! -e "$cdir/missing_file1.txt" ]]
+    testCondition "the missing file was reported once" "$?" "Reported $(grep -c "missing_file1.txt" "$out") times"
+}
+
+#*************************************TEST ADAPTIVE PARALLELISM******************************************
+# Runs the specified client with adaptive parallelism (-A 4) on one server, then on two instances of the
+# specified server (-M)
+# Arguments:
+# $1: server to be run (name of executable file)
+# $2: client to be run (name of executable file)
+#
+function testAdaptive
+{
+    local sdir="/tmp/temp_server_dir_$$"
+    local mdir="/tmp/temp_mirror_dir_$$"
+    local cdir="/tmp/temp_client_dir_$$"
+    local out="/tmp/temp_client_output_$$"
+    local files="$TEST_FILE"
+    local mirror_port=""
+    local i=0
+
+    setupTempServerDir "$1" "$sdir"
+    setupTempServerDir "$1" "$mdir"
+    mv -f "$mdir/$1" "$mdir/$MIRROR1"
+    setupTempClientDir "$2" "$cdir"
+    for (( i=1; i<=3; i++ ))
+    do
+        seq $i 1500000 > "$sdir/big_file$i.txt"	# more than 8 MiB each
+        files+=" big_file$i.txt"
+    done
+    for (( i=1; i<=100; i++ ))
+    do
+        seq $i $(($i * 100)) > "$sdir/tiny_file$i.txt"	# not to overwrite $TEST_FILE
+        files+=" tiny_file$i.txt"
+    done
+    cp -f "$sdir"/*_file* "$mdir"
+
+    echo -e "Running servers $1 and $MIRROR1 ...\n\n"
+    server_port=$(runServer "./$1" "$sdir" "$1output$test_suite.txt")
+    mirror_port=$(runServer "./$MIRROR1" "$mdir" "$MIRROR1""output$test_suite.txt")
+    if [[ $server_port -eq "-1" ]] || [[ $mirror_port -eq "-1" ]] ; then
+        echo -e "Server did not start."
+        return
+    else
+        echo -e "\t $1 [PORT $server_port] $MIRROR1 [PORT $mirror_port] Ok!"
+    fi
+
+    runClientArgs "$2" "$cdir" "$out" -A 4 "127.0.0.1" "$server_port" $files
+    testCondition "the client completed the transfer" "$rc" "Client exited with code $rc"
+    testAllFilesEquality "$sdir" "$cdir" $files
+
+    rm -f "$cdir"/*_file*
+    runClientArgs "$2" "$cdir" "$out" -A 4 -M "127.0.0.1:$mirror_port" "127.0.0.1" "$server_port" $files
+    testCondition "the client completed the transfer from both servers" "$rc" "Client exited with code $rc"
+    testAllFilesEquality "$sdir" "$cdir" $files
+}
+
+#*************************************TEST PIPELINED PLAIN REQUESTS*************************************
+# Runs the specified server and client with the plain protocol and 4 requests in flight (-P -w 4), the
+# second one for a missing file: the server closes the connection after its -ERR, so only the first
+# file is received and the two after it are dropped
+# Arguments:
+# $1: server to be run (name of executable file)
+# $2: client to be run (name of executable file)
+#
+function testPlainWindow
+{
+    local sdir="/tmp/temp_server_dir_$$"
+    local cdir="/tmp/temp_client_dir_$$"
+    local out="/tmp/temp_client_output_$$"
+
+    setupTempServerDir "$1" "$sdir"
+    setupTempClientDir "$2" "$cdir"
+    seq 1 1000 > "$sdir/window_file2.txt"
+    seq 2 1000 > "$sdir/window_file3.txt"
+
+    echo -e "Running server $1 ...\n\n"
+    server_port=$(runServer "./$1" "$sdir" "$1output$test_suite.txt")
+    if [[ $server_port -eq "-1" ]] ; then
+        echo -e "Server did not start."
+        return
+    else
+        echo -e "\t $1 [PORT $server_port] Ok!"
+    fi
+
+    runClientArgs "$2" "$cdir" "$out" -P -w 4 "127.0.0.1" "$server_port" "$TEST_FILE" missing_file1.txt \
+        window_file2.txt window_file3.txt
+    [[ $rc != 0 ]] && [[ $rc != 124 ]]
+    testCondition "the client reported the closed connection" "$?" "Client exited with code $rc"
+
+    testFilesEquality "$sdir" "$cdir" "$TEST_FILE"
+
+    [[ ! -e "$cdir/window_file2.txt" ]] && [[ ! -e "$cdir/window_file3.txt" ]] && [[ ! -e "$cdir/missing_file1.txt" ]]
+    testCondition "the files after the missing one were not received" "$?" "Files received: $(cd "$cdir" && ls *_file*)"
+
+    grep -q "error for \"missing_file1.txt\"" "$out" && grep -q "2 pending requests dropped" "$out"
+    testCondition "the missing file and the dropped requests were reported" "$?" "Client output: $(cat "$out")"
+}
+
+#*************************************TEST MISSING FILES AMONG GOOD ONES*********************************
+# Runs the specified server and client on files with missing ones among them, with MUX (the default)
+# and with MGET (-m): each missing file is only reported (-NOK), the connection stays open and every
+# existing file is received
+# Arguments:
+# $1: server to be run (name of executable file)
+# $2: client to be run (name of executable file)
+#
+function testMissingFiles
+{
+    local sdir="/tmp/temp_server_dir_$$"
+    local cdir="/tmp/temp_client_dir_$$"
+    local out="/tmp/temp_client_output_$$"
+    local files="$TEST_FILE"
+    local args=""
+    local opts=""
+    local fname=""
+    local i=0
+
+    setupTempServerDir "$1" "$sdir"
+    setupTempClientDir "$2" "$cdir"
+    seq 1 1500000 > "$sdir/big_file1.txt"	# more than 8 MiB
+    files+=" big_file1.txt"
+    for (( i=1; i<=10; i++ ))
+    do
+        seq $i $(($i * 100)) > "$sdir/tiny_file$i.txt"
+        files+=" tiny_file$i.txt"
+    done
+
+    # a missing file after every two good ones
+    i=0
+    for fname in $files
+    do
+        args+=" $fname"
+        i=$(($i + 1))
+        if (( $i % 2 == 0 )) ; then
+            args+=" missing_file$i.txt"
+        fi
+    done
+
+    echo -e "Running server $1 ...\n\n"
+    server_port=$(runServer "./$1" "$sdir" "$1output$test_suite.txt")
+    if [[ $server_port -eq "-1" ]] ; then
+        echo -e "Server did not start."
+        return
+    else
+        echo -e "\t $1 [PORT $server_port] Ok!"
+    fi
+
+    for opts in "" "-m"
+    do
+        rm -f "$cdir"/*_file*
+        runClientArgs "$2" "$cdir" "$out" $opts "127.0.0.1" "$server_port" $args
+        testCondition "the client completed the transfer (options: ${opts:-none})" "$rc" "Client exited with code $rc"
+
+        testAllFilesEquality "$sdir" "$cdir" $files
+
+        [[ $(grep -c "error for \"missing_file" "$out") == 6 ]] && ! ls "$cdir"/missing_file* &> /dev/null
+        testCondition "the 6 missing files were reported" "$?" "Reported $(grep -c "error for \"missing_file" "$out")"
+    done
+}
+
+#*************************************TEST DIRECTORY TREES***********************************************
+# Runs the specified server and client on a directory tree (-b) with nested directories and symbolic
+# links to a file and a directory outside of it, which must be neither sent nor followed
+# Arguments:
+# $1: server to be run (name of executable file)
+# $2: client to be run (name of executable file)
+#
+function testBundle
+{
+    local sdir="/tmp/temp_server_dir_$$"
+    local cdir="/tmp/temp_client_dir_$$"
+    local odir="/tmp/temp_outside_dir_$$"
+    local out="/tmp/temp_client_output_$$"
+    local opts=""
+
+    setupTempServerDir "$1" "$sdir"
+    setupTempClientDir "$2" "$cdir"
+    rm -r -f "$odir"
+    mkdir -p "$sdir/tree/sub/deeper" "$sdir/tree/empty_dir" "$odir"
+    seq 1 1000 > "$sdir/tree/tiny_file1.txt"
+    seq 1 1500000 > "$sdir/tree/sub/big_file1.txt"	# more than 8 MiB
+    head -c 100000 /dev/urandom > "$sdir/tree/sub/deeper/binary_file1.bin"
+    cp -f "$TOOLS_DIR/$TEST_FILE" "$sdir/tree/sub/deeper"
+    echo "outside of the tree" > "$odir/outside_file1.txt"
+    ln -s "$odir" "$sdir/tree/outside_dir"
+    ln -s "$odir/outside_file1.txt" "$sdir/tree/sub/outside_file"
+
+    echo -e "Running server $1 ...\n\n"
+    server_port=$(runServer "./$1" "$sdir" "$1output$test_suite.txt")
+    if [[ $server_port -eq "-1" ]] ; then
+        echo -e "Server did not start."
+        return
+    else
+        echo -e "\t $1 [PORT $server_port] Ok!"
+    fi
+
+    for opts in "" "-v"
+    do
+        rm -r -f "$cdir/tree"
+        runClientArgs "$2" "$cdir" "$out" -b $opts "127.0.0.1" "$server_port" tree
+        testCondition "the client completed the transfer (options: -b${opts:+ $opts})" "$rc" "Client exited with code $rc"
+
+        diff -r -x outside_dir -x outside_file "$sdir/tree" "$cdir/tree" &> /dev/null
+        testCondition "the received tree equals the original one" "$?" \
+            "$(diff -r -x outside_dir -x outside_file "$sdir/tree" "$cdir/tree" 2>&1 | head -n 3)"
+
+        [[ ! -e "$cdir/tree/outside_dir" ]] && [[ ! -L "$cdir/tree/outside_dir" ]] && \
+            [[ ! -e "$cdir/tree/sub/outside_file" ]] && [[ ! -L "$cdir/tree/sub/outside_file" ]] && \
+            [[ -z $(find "$cdir" -name "outside_file1.txt") ]]
+        testCondition "the symbolic links were neither sent nor followed" "$?" \
+            "Found: $(find "$cdir" -name "outside_*")"
+    done
+}
+
+#*************************************TEST REDIRECT LOOP*************************************************
+# Runs two instances of the specified server that send every client to each other (-L 0 -r): the client
+# must stop offering REDIR after 4 redirects, and be served
+# Arguments:
+# $1: server to be run (name of executable file)
+# $2: client to be run (name of executable file)
+#
+function testRedirectLoop
+{
+    local sdir="/tmp/temp_server_dir_$$"
+    local mdir="/tmp/temp_mirror_dir_$$"
+    local cdir="/tmp/temp_client_dir_$$"
+    local out="/tmp/temp_client_output_$$"
+    local files="$TEST_FILE"
+    local mirror_port=""
+    local i=0
+
+    setupTempServerDir "$1" "$sdir"
+    setupTempServerDir "$1" "$mdir"
+    mv -f "$mdir/$1" "$mdir/$MIRROR1"
+    setupTempClientDir "$2" "$cdir"
+    for (( i=1; i<=10; i++ ))
+    do
+        seq $i $(($i * 100)) > "$sdir/tiny_file$i.txt"
+        files+=" tiny_file$i.txt"
+    done
+    cp -f "$sdir"/*_file* "$mdir"
+
+    echo -e "Running servers $1 -L 0 and $MIRROR1 -L 0, each sending the clients to the other ...\n\n"
+    mirror_port=$(cd "$mdir" && ./$PORTFINDER)
+    server_port=$(runServer "./$1 -L 0 -r 127.0.0.1:$mirror_port" "$sdir" "$1output$test_suite.txt")
+    if [[ $server_port -eq "-1" ]] ; then
+        echo -e "Server did not start."
+        return
+    fi
+    mirror_port=$(runServer "./$MIRROR1 -L 0 -r 127.0.0.1:$server_port" "$mdir" "$MIRROR1""output$test_suite.txt" "$mirror_port")
+    if [[ $mirror_port -eq "-1" ]] ; then
+        echo -e "Server did not start."
+        return
+    else
+        echo -e "\t $1 [PORT $server_port] $MIRROR1 [PORT $mirror_port] Ok!"
+    fi
+
+    runClientArgs "$2" "$cdir" "$out" "127.0.0.1" "$server_port" $files
+    testCondition "the client completed the transfer" "$rc" "Client exited with code $rc"
+
+    [[ $(grep -c "^Redirected by" "$out") == 4 ]]
+    testCondition "the client was redirected 4 times" "$?" "Redirected $(grep -c "^Redirected by" "$out") times"
+
+    testAllFilesEquality "$sdir" "$cdir" $files
+}
+
+#*************************************TEST STRIPED TRANSFERS*********************************************
+# Runs the specified server and client on a large and a small file in verified stripes of 1 MiB over 4
+# connections (-s 1 -j 4 -v)
+# Arguments:
+# $1: server to be run (name of executable file)
+# $2: client to be run (name of executable file)
+#
+function testStriped
+{
+    local sdir="/tmp/temp_server_dir_$$"
+    local cdir="/tmp/temp_client_dir_$$"
+    local out="/tmp/temp_client_output_$$"
+
+    setupTempServerDir "$1" "$sdir"
+    setupTempClientDir "$2" "$cdir"
+    seq 1 1500000 > "$sdir/big_file1.txt"	# more than 8 MiB
+
+    echo -e "Running server $1 ...\n\n"
+    server_port=$(runServer "./$1" "$sdir" "$1output$test_suite.txt")
+    if [[ $server_port -eq "-1" ]] ; then
+        echo -e "Server did not start."
+        return
+    else
+        echo -e "\t $1 [PORT $server_port] Ok!"
+    fi
+
+    runClientArgs "$2" "$cdir" "$out" -s 1 -j 4 -v "127.0.0.1" "$server_port" big_file1.txt "$TEST_FILE"
+    testCondition "the client completed the transfer" "$rc" "Client exited with code $rc"
+
+    testFilesEquality "$sdir" "$cdir" big_file1.txt
+    testFilesEquality "$sdir" "$cdir" "$TEST_FILE"
+
+    ! ls "$cdir"/*.part &> /dev/null
+    testCondition "no partial file was left" "$?" "Partial files left: $(cd "$cdir" && ls *.part 2> /dev/null)"
+}
+
+#*************************************TEST CONDITIONAL REQUESTS******************************************
+# Runs the specified server and client on the same files three times with conditional requests (-c):
+# the second run must find every file not modified, the third one must fetch only the file touched on
+# the server
+# Arguments:
+# $1: server to be run (name of executable file)
+# $2: client to be run (name of executable file)
+#
+function testConditional
+{
+    local sdir="/tmp/temp_server_dir_$$"
+    local cdir="/tmp/temp_client_dir_$$"
+    local out="/tmp/temp_client_output_$$"
+    local files="$TEST_FILE big_file1.txt tiny_file1.txt"
+
+    setupTempServerDir "$1" "$sdir"
+    setupTempClientDir "$2" "$cdir"
+    seq 1 1500000 > "$sdir/big_file1.txt"	# more than 8 MiB
+    seq 1 100 > "$sdir/tiny_file1.txt"
+
+    echo -e "Running server $1 ...\n\n"
+    server_port=$(runServer "./$1" "$sdir" "$1output$test_suite.txt")
+    if [[ $server_port -eq "-1" ]] ; then
+        echo -e "Server did not start."
+        return
+    else
+        echo -e "\t $1 [PORT $server_port] Ok!"
+    fi
+
+    runClientArgs "$2" "$cdir" "$out" -c "127.0.0.1" "$server_port" $files
+    [[ $rc == 0 ]] && [[ $(grep -c "^Written" "$out") == 3 ]]
+    testCondition "the client fetched the 3 files" "$?" "Client exited with code $rc: $(cat "$out")"
+    testAllFilesEquality "$sdir" "$cdir" $files
+
+    runClientArgs "$2" "$cdir" "$out" -c "127.0.0.1" "$server_port" $files
+    [[ $rc == 0 ]] && [[ $(grep -c "not modified" "$out") == 3 ]] && ! grep -q "^Written" "$out"
+    testCondition "the 3 files were not modified" "$?" "Client exited with code $rc: $(cat "$out")"
+
+    touch "$sdir/big_file1.txt"
+    runClientArgs "$2" "$cdir" "$out" -c "127.0.0.1" "$server_port" $files
+    [[ $rc == 0 ]] && [[ $(grep -c "not modified" "$out") == 2 ]] && grep -q "^Written .* \"big_file1.txt\"" "$out"
+    testCondition "only the file touched on the server was fetched" "$?" "Client exited with code $rc: $(cat "$out")"
+    testAllFilesEquality "$sdir" "$cdir" $files
+}
+
+#*************************************TEST DELTA TRANSFERS***********************************************
+# Runs the specified server and client with verified delta transfers (-d -v) over local copies that were
+# truncated or altered: the rebuilt files must equal the original ones
+# Arguments:
+# $1: server to be run (name of executable file)
+# $2: client to be run (name of executable file)
+#
+function testDelta
+{
+    local sdir="/tmp/temp_server_dir_$$"
+    local cdir="/tmp/temp_client_dir_$$"
+    local out="/tmp/temp_client_output_$$"
+    local files="big_file1.txt big_file2.txt big_file3.txt"
+    local fname=""
+
+    setupTempServerDir "$1" "$sdir"
+    setupTempClientDir "$2" "$cdir"
+    seq 1 1500000 > "$sdir/big_file1.txt"	# more than 8 MiB
+    seq 1 200000 > "$sdir/big_file2.txt"
+    seq 1 300000 > "$sdir/big_file3.txt"
+
+    # local copies: truncated, altered in the middle, altered and truncated
+    head -c 5000000 "$sdir/big_file1.txt" > "$cdir/big_file1.txt"
+    cp -f "$sdir/big_file2.txt" "$cdir/big_file2.txt"
+    printf "altered" | dd of="$cdir/big_file2.txt" bs=1 seek=300000 conv=notrunc &> /dev/null
+    head -c 1000000 "$sdir/big_file3.txt" > "$cdir/big_file3.txt"
+    printf "altered" | dd of="$cdir/big_file3.txt" bs=1 seek=100 conv=notrunc &> /dev/null
+
+    echo -e "Running server $1 ...\n\n"
+    server_port=$(runServer "./$1" "$sdir" "$1output$test_suite.txt")
+    if [[ $server_port -eq "-1" ]] ; then
+        echo -e "Server did not start."
+        return
+    else
+        echo -e "\t $1 [PORT $server_port] Ok!"
+    fi
+
+    runClientArgs "$2" "$cdir" "$out" -d -v "127.0.0.1" "$server_port" $files
+    testCondition "the client completed the transfer" "$rc" "Client exited with code $rc"
+
+    for fname in $files
+    do
+        testFilesEquality "$sdir" "$cdir" "$fname"
+    done
+}
+
+#*************************************TEST MANIFEST ON STANDARD INPUT*************************************
+# Runs the specified server and client with the filenames read from the standard input (-i -), with an
+# empty line and a missing file among them, alone and over 4 connections (-j 4)
+# Arguments:
+# $1: server to be run (name of executable file)
+# $2: client to be run (name of executable file)
+#
+function testManifest
+{
+    local sdir="/tmp/temp_server_dir_$$"
+    local cdir="/tmp/temp_client_dir_$$"
+    local out="/tmp/temp_client_output_$$"
+    local opts=""
+
+    setupTempServerDir "$1" "$sdir"
+    setupTempClientDir "$2" "$cdir"
+    seq 1 1500000 > "$sdir/big_file1.txt"	# more than 8 MiB
+
+    echo -e "Running server $1 ...\n\n"
+    server_port=$(runServer "./$1" "$sdir" "$1output$test_suite.txt")
+    if [[ $server_port -eq "-1" ]] ; then
+        echo -e "Server did not start."
+        return
+    else
+        echo -e "\t $1 [PORT $server_port] Ok!"
+    fi
+
+    for opts in "" "-j 4"
+    do
+        rm -f "$cdir"/*_file*
+        echo "Running client $2 (options -i - $opts, server 127.0.0.1, port $server_port) ..."
+        ( cd "$cdir" && printf "%s\n\n%s\n%s\n" "$TEST_FILE" missing_file1.txt big_file1.txt | \
+            $TIMEOUT $MAX_EXEC_TIME ./$2 -i - $opts "127.0.0.1" "$server_port" &> "$out" )
+        rc=$?
+        testCondition "the client completed the transfer (options: -i -${opts:+ $opts})" "$rc" "Client exited with code $rc"
+
+        testAllFilesEquality "$sdir" "$cdir" "$TEST_FILE" big_file1.txt
+
+        [[ $(grep -c "^ERROR" "$out") == 1 ]] && grep -q "error for \"missing_file1.txt\"" "$out"
+        testCondition "only the missing file was reported" "$?" "Client output: $(grep "^ERROR" "$out")"
+    done
+}
+
+#*************************************TEST DIRECTORY LISTINGS********************************************
+# Runs the specified server and client listing a pattern, a missing directory and a directory (-l): the
+# missing one is only reported (-NOK) and the next one is still listed
+# Arguments:
+# $1: server to be run (name of executable file)
+# $2: client to be run (name of executable file)
+#
+function testList
+{
+    local sdir="/tmp/temp_server_dir_$$"
+    local cdir="/tmp/temp_client_dir_$$"
+    local out="/tmp/temp_client_output_$$"
+
+    setupTempServerDir "$1" "$sdir"
+    setupTempClientDir "$2" "$cdir"
+    mkdir -p "$sdir/logs" "$sdir/next_dir"
+    seq 1 100 | gzip > "$sdir/logs/log_file1.gz"
+    seq 1 200 | gzip > "$sdir/logs/log_file2.gz"
+    seq 1 300 > "$sdir/logs/log_file3.txt"
+    seq 1 400 > "$sdir/next_dir/next_file1.txt"
+
+    echo -e "Running server $1 ...\n\n"
+    server_port=$(runServer "./$1" "$sdir" "$1output$test_suite.txt")
+    if [[ $server_port -eq "-1" ]] ; then
+        echo -e "Server did not start."
+        return
+    else
+        echo -e "\t $1 [PORT $server_port] Ok!"
+    fi
+
+    runClientArgs "$2" "$cdir" "$out" -l "127.0.0.1" "$server_port" "logs/*.gz" missing_dir next_dir
+    testCondition "the client completed the listing" "$rc" "Client exited with code $rc"
+
+    grep -q " log_file1.gz$" "$out" && grep -q " log_file2.gz$" "$out" && ! grep -q "log_file3.txt" "$out"
+    testCondition "the pattern listed the matching files only" "$?" "Client output: $(cat "$out")"
+
+    [[ $(grep -n "error for \"missing_dir\"" "$out" | cut -d: -f1) -lt $(grep -n " next_file1.txt$" "$out" | cut -d: -f1) ]]
+    testCondition "the missing directory was reported and the next one listed" "$?" "Client output: $(cat "$out")"
+}
+
+#*************************************TEST FOLLOWED FILE*************************************************
+# Runs the specified server and client following a file (-f 1000) while it grows on the server, until it
+# is idle for a second; then follows it again, continuing the local copy
+# Arguments:
+# $1: server to be run (name of executable file)
+# $2: client to be run (name of executable file)
+#
+function testFollow
+{
+    local sdir="/tmp/temp_server_dir_$$"
+    local cdir="/tmp/temp_client_dir_$$"
+    local out="/tmp/temp_client_output_$$"
+    local fname="growing_file1.log"
+    local cli_pid=""
+    local i=0
+
+    setupTempServerDir "$1" "$sdir"
+    setupTempClientDir "$2" "$cdir"
+    seq 1 1000 > "$sdir/$fname"
+
+    echo -e "Running server $1 ...\n\n"
+    server_port=$(runServer "./$1" "$sdir" "$1output$test_suite.txt")
+    if [[ $server_port -eq "-1" ]] ; then
+        echo -e "Server did not start."
+        return
+    else
+        echo -e "\t $1 [PORT $server_port] Ok!"
+    fi
+
+    # appended every 200 ms, then idle
+    echo "Running client $2 (options -f 1000, server 127.0.0.1, port $server_port, file $fname) ..."
+    ( cd "$cdir" && $TIMEOUT $MAX_EXEC_TIME ./$2 -f 1000 "127.0.0.1" "$server_port" "$fname" &> "$out" ) &
+    cli_pid=$!
+    for (( i=1; i<=5; i++ ))
+    do
+        sleep 0.2
+        seq $i 5000 >> "$sdir/$fname"
+    done
+    wait $cli_pid
+    rc=$?
+    [[ $rc == 0 ]] && grep -q "(idle)" "$out"
+    testCondition "the client followed the file until it was idle" "$?" "Client exited with code $rc: $(cat "$out")"
+    testFilesEquality "$sdir" "$cdir" "$fname"
+
+    # the local copy is continued
+    seq 1 100000 >> "$sdir/$fname"
+    runClientArgs "$2" "$cdir" "$out" -f 500 "127.0.0.1" "$server_port" "$fname"
+    [[ $rc == 0 ]] && grep -q "from offset [1-9]" "$out"
+    testCondition "the client continued the local copy" "$?" "Client exited with code $rc: $(cat "$out")"
+    testFilesEquality "$sdir" "$cdir" "$fname"
+}
+
 #************************************Get return value of test client*************************************
 # returns (to the standard output) the client return value
 # Arguments:
@@ -467,6 +1271,38 @@ function testFilesEquality
     fi
 }
 
+#************************************Test files present and identical************************************
+# Check the expected files are all present in the client directory and equal the expected ones, as a
+# single test
+# Stores result ("passed" or "failed") in global var $result
+# Arguments:
+# $1: the server directory
+# $2: the client directory
+# $3...: the names of the files to test
+#
+function testAllFilesEquality
+{
+    local sdir=$1
+    local cdir=$2
+    local fname=""
+    local fequality="0"
+    shift 2
+    for fname in "$@"
+    do
+        fequality=$(getFileEquality "$sdir" "$cdir" "$fname")
+        if [[ $fequality != "0" ]] ; then
+            break
+        fi
+    done
+    if [[ $fequality == "1" ]] ; then
+        testCondition "the $# transferred files exist in client directory and equal the original ones" "1" \
+            "File $fname is not present in the client directory."
+    else
+        testCondition "the $# transferred files exist in client directory and equal the original ones" "$fequality" \
+            "File $fname does not equal the original one."
+    fi
+}
+
 #************************************Get info about file present and identical***************************
 # Test if the expected file is present in the client directory and equals the expected one
 # (with same name in $TOOLS_DIR directory
@@ -545,6 +1381,233 @@ else
 fi
 echo "*** END OF TESTING PART 3 *************"
 
+#********************************** TEST SUITE 4 ********************************************************
+echo -e "\n\n*** PART 4: TESTS ON THE STUDENT'S CLIENT AND SERVER: COMPRESSED AND VERIFIED BIG FILE *************"
+test_suite=4
+test_number=0
+client_run=0
+
+if [[ $TEST_01_PASSED == true ]] && [[ $TEST_02_PASSED == true ]] ; then
+
+    testLzCrcLargeFile "$SERVER1" "$CLIENT1"
+    killProcesses
+else
+	echo -e "---Skipping test of Part 4 because the student's server or client didn't compile---"
+fi
+echo "*** END OF TESTING PART 4 *************"
+
+#********************************** TEST SUITE 5 ********************************************************
+echo -e "\n\n*** PART 5: TESTS ON THE STUDENT'S CLIENT AND SERVER: FILES STREAMED ON THE STANDARD OUTPUT *************"
+test_suite=5
+test_number=0
+client_run=0
+
+if [[ $TEST_01_PASSED == true ]] && [[ $TEST_02_PASSED == true ]] ; then
+
+    testStreamOutput "$SERVER1" "$CLIENT1"
+    killProcesses
+else
+	echo -e "---Skipping test of Part 5 because the student's server or client didn't compile---"
+fi
+echo "*** END OF TESTING PART 5 *************"
+
+#********************************** TEST SUITE 6 ********************************************************
+echo -e "\n\n*** PART 6: TESTS ON THE STUDENT'S CLIENT AND SERVER: MIRRORS THAT DIE *************"
+test_suite=6
+test_number=0
+client_run=0
+
+if [[ $TEST_01_PASSED == true ]] && [[ $TEST_02_PASSED == true ]] ; then
+
+    testMirrorFailover "$SERVER1" "$CLIENT1"
+    killProcesses
+else
+	echo -e "---Skipping test of Part 6 because the student's server or client didn't compile---"
+fi
+echo "*** END OF TESTING PART 6 *************"
+
+#********************************** TEST SUITE 7 ********************************************************
+echo -e "\n\n*** PART 7: TESTS ON THE STUDENT'S CLIENT AND SERVER: PARALLEL TRANSFERS *************"
+test_suite=7
+test_number=0
+client_run=0
+
+if [[ $TEST_01_PASSED == true ]] && [[ $TEST_02_PASSED == true ]] ; then
+
+    testParallelJobs "$SERVER1" "$CLIENT1"
+    killProcesses
+else
+	echo -e "---Skipping test of Part 7 because the student's server or client didn't compile---"
+fi
+echo "*** END OF TESTING PART 7 *************"
+
+#********************************** TEST SUITE 8 ********************************************************
+echo -e "\n\n*** PART 8: TESTS ON THE STUDENT'S CLIENT AND SERVER: ADAPTIVE PARALLELISM *************"
+test_suite=8
+test_number=0
+client_run=0
+
+if [[ $TEST_01_PASSED == true ]] && [[ $TEST_02_PASSED == true ]] ; then
+
+    testAdaptive "$SERVER1" "$CLIENT1"
+    killProcesses
+else
+	echo -e "---Skipping test of Part 8 because the student's server or client didn't compile---"
+fi
+echo "*** END OF TESTING PART 8 *************"
+
+#********************************** TEST SUITE 9 ********************************************************
+echo -e "\n\n*** PART 9: TESTS ON THE STUDENT'S CLIENT WITH THE STUDENT'S AND THE REFERENCE SERVER: PIPELINED PLAIN REQUESTS *************"
+test_suite=9
+test_number=0
+client_run=0
+
+if [[ $TEST_01_PASSED == true ]] && [[ $TEST_02_PASSED == true ]] ; then
+
+    testPlainWindow "$SERVER1" "$CLIENT1"
+    killProcesses
+    testPlainWindow "$TESTSERVER1" "$CLIENT1"
+    killProcesses
+else
+	echo -e "---Skipping test of Part 9 because the student's server or client didn't compile---"
+fi
+echo "*** END OF TESTING PART 9 *************"
+
+#********************************** TEST SUITE 10 *******************************************************
+echo -e "\n\n*** PART 10: TESTS ON THE STUDENT'S CLIENT AND SERVER: MISSING FILES AMONG GOOD ONES *************"
+test_suite=10
+test_number=0
+client_run=0
+
+if [[ $TEST_01_PASSED == true ]] && [[ $TEST_02_PASSED == true ]] ; then
+
+    testMissingFiles "$SERVER1" "$CLIENT1"
+    killProcesses
+else
+	echo -e "---Skipping test of Part 10 because the student's server or client didn't compile---"
+fi
+echo "*** END OF TESTING PART 10 *************"
+
+#********************************** TEST SUITE 11 *******************************************************
+echo -e "\n\n*** PART 11: TESTS ON THE STUDENT'S CLIENT AND SERVER: DIRECTORY TREES *************"
+test_suite=11
+test_number=0
+client_run=0
+
+if [[ $TEST_01_PASSED == true ]] && [[ $TEST_02_PASSED == true ]] ; then
+
+    testBundle "$SERVER1" "$CLIENT1"
+    killProcesses
+else
+	echo -e "---Skipping test of Part 11 because the student's server or client didn't compile---"
+fi
+echo "*** END OF TESTING PART 11 *************"
+
+#********************************** TEST SUITE 12 *******************************************************
+echo -e "\n\n*** PART 12: TESTS ON THE STUDENT'S CLIENT AND SERVER: SERVERS REDIRECTING TO EACH OTHER *************"
+test_suite=12
+test_number=0
+client_run=0
+
+if [[ $TEST_01_PASSED == true ]] && [[ $TEST_02_PASSED == true ]] ; then
+
+    testRedirectLoop "$SERVER1" "$CLIENT1"
+    killProcesses
+else
+	echo -e "---Skipping test of Part 12 because the student's server or client didn't compile---"
+fi
+echo "*** END OF TESTING PART 12 *************"
+
+#********************************** TEST SUITE 13 *******************************************************
+echo -e "\n\n*** PART 13: TESTS ON THE STUDENT'S CLIENT AND SERVER: STRIPED TRANSFERS *************"
+test_suite=13
+test_number=0
+client_run=0
+
+if [[ $TEST_01_PASSED == true ]] && [[ $TEST_02_PASSED == true ]] ; then
+
+    testStriped "$SERVER1" "$CLIENT1"
+    killProcesses
+else
+	echo -e "---Skipping test of Part 13 because the student's server or client didn't compile---"
+fi
+echo "*** END OF TESTING PART 13 *************"
+
+#********************************** TEST SUITE 14 *******************************************************
+echo -e "\n\n*** PART 14: TESTS ON THE STUDENT'S CLIENT AND SERVER: CONDITIONAL REQUESTS *************"
+test_suite=14
+test_number=0
+client_run=0
+
+if [[ $TEST_01_PASSED == true ]] && [[ $TEST_02_PASSED == true ]] ; then
+
+    testConditional "$SERVER1" "$CLIENT1"
+    killProcesses
+else
+	echo -e "---Skipping test of Part 14 because the student's server or client didn't compile---"
+fi
+echo "*** END OF TESTING PART 14 *************"
+
+#********************************** TEST SUITE 15 *******************************************************
+echo -e "\n\n*** PART 15: TESTS ON THE STUDENT'S CLIENT AND SERVER: DELTA TRANSFERS *************"
+test_suite=15
+test_number=0
+client_run=0
+
+if [[ $TEST_01_PASSED == true ]] && [[ $TEST_02_PASSED == true ]] ; then
+
+    testDelta "$SERVER1" "$CLIENT1"
+    killProcesses
+else
+	echo -e "---Skipping test of Part 15 because the student's server or client didn't compile---"
+fi
+echo "*** END OF TESTING PART 15 *************"
+
+#********************************** TEST SUITE 16 *******************************************************
+echo -e "\n\n*** PART 16: TESTS ON THE STUDENT'S CLIENT AND SERVER: FILENAMES FROM THE STANDARD INPUT *************"
+test_suite=16
+test_number=0
+client_run=0
+
+if [[ $TEST_01_PASSED == true ]] && [[ $TEST_02_PASSED == true ]] ; then
+
+    testManifest "$SERVER1" "$CLIENT1"
+    killProcesses
+else
+	echo -e "---Skipping test of Part 16 because the student's server or client didn't compile---"
+fi
+echo "*** END OF TESTING PART 16 *************"
+
+#********************************** TEST SUITE 17 *******************************************************
+echo -e "\n\n*** PART 17: TESTS ON THE STUDENT'S CLIENT AND SERVER: DIRECTORY LISTINGS *************"
+test_suite=17
+test_number=0
+client_run=0
+
+if [[ $TEST_01_PASSED == true ]] && [[ $TEST_02_PASSED == true ]] ; then
+
+    testList "$SERVER1" "$CLIENT1"
+    killProcesses
+else
+	echo -e "---Skipping test of Part 17 because the student's server or client didn't compile---"
+fi
+echo "*** END OF TESTING PART 17 *************"
+
+#********************************** TEST SUITE 18 *******************************************************
+echo -e "\n\n*** PART 18: TESTS ON THE STUDENT'S CLIENT AND SERVER: FOLLOWED FILE *************"
+test_suite=18
+test_number=0
+client_run=0
+
+if [[ $TEST_01_PASSED == true ]] && [[ $TEST_02_PASSED == true ]] ; then
+
+    testFollow "$SERVER1" "$CLIENT1"
+    killProcesses
+else
+	echo -e "---Skipping test of Part 18 because the student's server or client didn't compile---"
+fi
+echo "*** END OF TESTING PART 18 *************"
+
 
 #****************************** SUMMARY *****************************************************************
 
@@ -560,6 +1623,99 @@ echo ""
 echo " - test 2.1: "${TEST_21_PASSED:-skipped}
 echo ""
 echo " - test 3.1: "${TEST_31_PASSED:-skipped}
+echo ""
+echo " - test 4.1: "${TEST_41_PASSED:-skipped}
+echo " - test 4.2: "${TEST_42_PASSED:-skipped}
+echo " - test 4.3: "${TEST_43_PASSED:-skipped}
+echo " - test 4.4: "${TEST_44_PASSED:-skipped}
+echo ""
+echo " - test 5.1: "${TEST_51_PASSED:-skipped}
+echo " - test 5.2: "${TEST_52_PASSED:-skipped}
+echo " - test 5.3: "${TEST_53_PASSED:-skipped}
+echo " - test 5.4: "${TEST_54_PASSED:-skipped}
+echo " - test 5.5: "${TEST_55_PASSED:-skipped}
+echo " - test 5.6: "${TEST_56_PASSED:-skipped}
+echo ""
+echo " - test 6.1: "${TEST_61_PASSED:-skipped}
+echo " - test 6.2: "${TEST_62_PASSED:-skipped}
+echo " - test 6.3: "${TEST_63_PASSED:-skipped}
+echo " - test 6.4: "${TEST_64_PASSED:-skipped}
+echo " - test 6.5: "${TEST_65_PASSED:-skipped}
+echo " - test 6.6: "${TEST_66_PASSED:-skipped}
+echo " - test 6.7: "${TEST_67_PASSED:-skipped}
+echo " - test 6.8: "${TEST_68_PASSED:-skipped}
+echo " - test 6.9: "${TEST_69_PASSED:-skipped}
+echo " - test 6.10: "${TEST_610_PASSED:-skipped}
+echo " - test 6.11: "${TEST_611_PASSED:-skipped}
+echo " - test 6.12: "${TEST_612_PASSED:-skipped}
+echo ""
+echo " - test 7.1: "${TEST_71_PASSED:-skipped}
+echo " - test 7.2: "${TEST_72_PASSED:-skipped}
+echo " - test 7.3: "${TEST_73_PASSED:-skipped}
+echo ""
+echo " - test 8.1: "${TEST_81_PASSED:-skipped}
+echo " - test 8.2: "${TEST_82_PASSED:-skipped}
+echo " - test 8.3: "${TEST_83_PASSED:-skipped}
+echo " - test 8.4: "${TEST_84_PASSED:-skipped}
+echo ""
+echo " - test 9.1: "${TEST_91_PASSED:-skipped}
+echo " - test 9.2: "${TEST_92_PASSED:-skipped}
+echo " - test 9.3: "${TEST_93_PASSED:-skipped}
+echo " - test 9.4: "${TEST_94_PASSED:-skipped}
+echo " - test 9.5: "${TEST_95_PASSED:-skipped}
+echo " - test 9.6: "${TEST_96_PASSED:-skipped}
+echo " - test 9.7: "${TEST_97_PASSED:-skipped}
+echo " - test 9.8: "${TEST_98_PASSED:-skipped}
+echo ""
+echo " - test 10.1: "${TEST_101_PASSED:-skipped}
+echo " - test 10.2: "${TEST_102_PASSED:-skipped}
+echo " - test 10.3: "${TEST_103_PASSED:-skipped}
+echo " - test 10.4: "${TEST_104_PASSED:-skipped}
+echo " - test 10.5: "${TEST_105_PASSED:-skipped}
+echo " - test 10.6: "${TEST_106_PASSED:-skipped}
+echo ""
+echo " - test 11.1: "${TEST_111_PASSED:-skipped}
+echo " - test 11.2: "${TEST_112_PASSED:-skipped}
+echo " - test 11.3: "${TEST_113_PASSED:-skipped}
+echo " - test 11.4: "${TEST_114_PASSED:-skipped}
+echo " - test 11.5: "${TEST_115_PASSED:-skipped}
+echo " - test 11.6: "${TEST_116_PASSED:-skipped}
+echo ""
+echo " - test 12.1: "${TEST_121_PASSED:-skipped}
+echo " - test 12.2: "${TEST_122_PASSED:-skipped}
+echo " - test 12.3: "${TEST_123_PASSED:-skipped}
+echo ""
+echo " - test 13.1: "${TEST_131_PASSED:-skipped}
+echo " - test 13.2: "${TEST_132_PASSED:-skipped}
+echo " - test 13.3: "${TEST_133_PASSED:-skipped}
+echo " - test 13.4: "${TEST_134_PASSED:-skipped}
+echo ""
+echo " - test 14.1: "${TEST_141_PASSED:-skipped}
+echo " - test 14.2: "${TEST_142_PASSED:-skipped}
+echo " - test 14.3: "${TEST_143_PASSED:-skipped}
+echo " - test 14.4: "${TEST_144_PASSED:-skipped}
+echo " - test 14.5: "${TEST_145_PASSED:-skipped}
+echo ""
+echo " - test 15.1: "${TEST_151_PASSED:-skipped}
+echo " - test 15.2: "${TEST_152_PASSED:-skipped}
+echo " - test 15.3: "${TEST_153_PASSED:-skipped}
+echo " - test 15.4: "${TEST_154_PASSED:-skipped}
+echo ""
+echo " - test 16.1: "${TEST_161_PASSED:-skipped}
+echo " - test 16.2: "${TEST_162_PASSED:-skipped}
+echo " - test 16.3: "${TEST_163_PASSED:-skipped}
+echo " - test 16.4: "${TEST_164_PASSED:-skipped}
+echo " - test 16.5: "${TEST_165_PASSED:-skipped}
+echo " - test 16.6: "${TEST_166_PASSED:-skipped}
+echo ""
+echo " - test 17.1: "${TEST_171_PASSED:-skipped}
+echo " - test 17.2: "${TEST_172_PASSED:-skipped}
+echo " - test 17.3: "${TEST_173_PASSED:-skipped}
+echo ""
+echo " - test 18.1: "${TEST_181_PASSED:-skipped}
+echo " - test 18.2: "${TEST_182_PASSED:-skipped}
+echo " - test 18.3: "${TEST_183_PASSED:-skipped}
+echo " - test 18.4: "${TEST_184_PASSED:-skipped}
 echo " ------------------------"
 
 # Checking minimum requirements
@@ -347,6 +347,49 @@ function ensureServerStarted
 	echo "-1"
 }
 
+#*************************************RUN CLIENT WITH OPTIONS********************************************
+# Runs the specified client in the specified directory, with options before the server address
+# Arguments:
+# $1: the client to be run (name of executable file)
+# $2: the directory of the client to be run
+# $3: the file for recording the client standard output and error
+# $4...: the arguments of the client (options, address, port, files)
+# Sets $rc to the client exit code
+function runClientArgs
+{
+    local cli=$1
+    local cli_dir=$2
+    local out=$3
+    shift 3
+    echo "Running client $cli (arguments: $@) ..."
+    ( cd "$cli_dir" && $TIMEOUT $MAX_EXEC_TIME ./$cli "$@" &> "$out" )
+    rc=$?
+}
+
+#*************************************TEST A CONDITION***************************************************
+# Records the result of a check as the next test
+# Stores result ("passed" or "failed") in global var $result
+# Arguments:
+# $1: what is checked
+# $2: "0" if the check passed
+# $3: the message printed if it failed
+function testCondition
+{
+    test_number=$(($test_number + 1))
+    echo -e "\n\n[TEST $test_suite.$test_number] Checking $1 ..."
+    local tname="TEST_$test_suite$test_number"
+    local tname+="_PASSED"
+    if [[ $2 == "0" ]] ; then
+        echo -e "\t[++TEST $test_suite.$test_number PASSED++] "
+        eval ${tname}=true
+        result=passed
+    else
+        echo -e "\t[--TEST $test_suite.$test_number FAILED--] $3"
+        eval ${tname}=false
+        result=failed
+    fi
+}
+
 #*************************************TEST CLIENT-SERVER INTERACTION*************************************
 # Runs the specified server and client and performs a number of tests
 # Arguments:
@@ -394,6 +437,109 @@ function testClientServerInteraction
 
 }
 
+#*************************************TEST QUEUE LIMITS**************************************************
+# Runs the specified server with the smallest queue of each connection (-Q 1, then -B 1) and the client
+# with 32 requests in flight (-w 32), also as interactive (-p 0): every file must be received
+# Arguments:
+# $1: server to be run (name of executable file)
+# $2: client to be run (name of executable file)
+#
+function testQueueLimits
+{
+    local sdir="/tmp/temp_server_dir_$$"
+    local cdir="/tmp/temp_client_dir_$$"
+    local out="/tmp/temp_client_output_$$"
+    local files="$TEST_FILE"
+    local sopts=""
+    local opts=""
+    local i=0
+
+    setupTempServerDir "$1" "$sdir"
+    setupTempClientDir "$2" "$cdir"
+    for (( i=1; i<=2; i++ ))
+    do
+        seq $i 1500000 > "$sdir/big_file$i.txt"	# more than 8 MiB each
+        files+=" big_file$i.txt"
+    done
+    for (( i=1; i<=100; i++ ))
+    do
+        seq $i $(($i * 100)) > "$sdir/tiny_file$i.txt"
+        files+=" tiny_file$i.txt"
+    done
+
+    for sopts in "-Q 1" "-B 1"
+    do
+        echo -e "Running server $1 $sopts ...\n\n"
+        server_port=$(runServer "./$1 $sopts" "$sdir" "$1output$test_suite.txt")
+        if [[ $server_port -eq "-1" ]] ; then
+            echo -e "Server did not start."
+            return
+        else
+            echo -e "\t $1 $sopts [PORT $server_port] Ok!"
+        fi
+
+        for opts in "-w 32" "-w 32 -p 0"
+        do
+            rm -f "$cdir"/*_file*
+            runClientArgs "$2" "$cdir" "$out" $opts "127.0.0.1" "$server_port" $files
+            testCondition "the client completed the transfer (server $sopts, client $opts)" "$rc" "Client exited with code $rc"
+            testAllFilesEquality "$sdir" "$cdir" $files
+        done
+
+        killall -9 $1 &> /dev/null
+    done
+}
+
+#*************************************TEST REDIRECT******************************************************
+# Runs the specified server as a peer with the files and again, without the files, to send every client
+# to the peer (-L 0 -r): the client must be redirected and then receive the files
+# Arguments:
+# $1: server to be run (name of executable file)
+# $2: client to be run (name of executable file)
+#
+function testRedirect
+{
+    local sdir="/tmp/temp_server_dir_$$"
+    local pdir="/tmp/temp_peer_dir_$$"
+    local cdir="/tmp/temp_client_dir_$$"
+    local out="/tmp/temp_client_output_$$"
+    local files="$TEST_FILE"
+    local peer_port=""
+    local i=0
+
+    setupTempServerDir "$1" "$sdir"
+    setupTempServerDir "$1" "$pdir"
+    rm -f "$sdir/$TEST_FILE"	# only the peer can send it
+    setupTempClientDir "$2" "$cdir"
+    for (( i=1; i<=10; i++ ))
+    do
+        seq $i $(($i * 100)) > "$pdir/tiny_file$i.txt"
+        files+=" tiny_file$i.txt"
+    done
+
+    echo -e "Running servers $1 (peer) and $1 -L 0 ...\n\n"
+    peer_port=$(runServer "./$1" "$pdir" "$1peeroutput$test_suite.txt")
+    if [[ $peer_port -eq "-1" ]] ; then
+        echo -e "Server did not start."
+        return
+    fi
+    server_port=$(runServer "./$1 -L 0 -r 127.0.0.1:$peer_port" "$sdir" "$1output$test_suite.txt")
+    if [[ $server_port -eq "-1" ]] ; then
+        echo -e "Server did not start."
+        return
+    else
+        echo -e "\t $1 [PORT $peer_port] $1 -L 0 [PORT $server_port] Ok!"
+    fi
+
+    runClientArgs "$2" "$cdir" "$out" "127.0.0.1" "$server_port" $files
+    testCondition "the client completed the transfer" "$rc" "Client exited with code $rc"
+
+    grep -q "Redirected by 127.0.0.1 $server_port to 127.0.0.1 $peer_port" "$out"
+    testCondition "the client was redirected to the peer" "$?" "Client output: $(head -n 1 "$out")"
+
+    testAllFilesEquality "$pdir" "$cdir" $files
+}
+
 #************************************Get return value of test client*************************************
 # returns (to the standard output) the client return value
 # Arguments:
@@ -467,6 +613,38 @@ function testFilesEquality
     fi
 }
 
+#************************************Test files present and identical************************************
+# Check the expected files are all present in the client directory and equal the expected ones, as a
+# single test
+# Stores result ("passed" or "failed") in global var $result
+# Arguments:
+# $1: the server directory
+# $2: the client directory
+# $3...: the names of the files to test
+#
+function testAllFilesEquality
+{
+    local sdir=$1
+    local cdir=$2
+    local fname=""
+    local fequality="0"
+    shift 2
+    for fname in "$@"
+    do
+        fequality=$(getFileEquality "$sdir" "$cdir" "$fname")
+        if [[ $fequality != "0" ]] ; then
+            break
+        fi
+    done
+    if [[ $fequality == "1" ]] ; then
+        testCondition "the $# transferred files exist in client directory and equal the original ones" "1" \
+            "File $fname is not present in the client directory."
+    else
+        testCondition "the $# transferred files exist in client directory and equal the original ones" "$fequality" \
+            "File $fname does not equal the original one."
+    fi
+}
+
 #************************************Get info about file present and identical***************************
 # Test if the expected file is present in the client directory and equals the expected one
 # (with same name in $TOOLS_DIR directory
@@ -545,6 +723,36 @@ else
 fi
 echo "*** END OF TESTING PART 3 *************"
 
+#********************************** TEST SUITE 4 ********************************************************
+echo -e "\n\n*** PART 4: TESTS ON THE STUDENT'S CLIENT AND SERVER: QUEUE LIMITS AND PRIORITIES *************"
+test_suite=4
+test_number=0
+client_run=0
+
+if [[ $TEST_01_PASSED == true ]] && [[ $TEST_02_PASSED == true ]] ; then
+
+    testQueueLimits "$SERVER1" "$CLIENT1"
+    killProcesses
+else
+	echo -e "---Skipping test of Part 4 because the student's server or client didn't compile---"
+fi
+echo "*** END OF TESTING PART 4 *************"
+
+#********************************** TEST SUITE 5 ********************************************************
+echo -e "\n\n*** PART 5: TESTS ON THE STUDENT'S CLIENT AND SERVER: REDIRECT TO A PEER *************"
+test_suite=5
+test_number=0
+client_run=0
+
+if [[ $TEST_01_PASSED == true ]] && [[ $TEST_02_PASSED == true ]] ; then
+
+    testRedirect "$SERVER1" "$CLIENT1"
+    killProcesses
+else
+	echo -e "---Skipping test of Part 5 because the student's server or client didn't compile---"
+fi
+echo "*** END OF TESTING PART 5 *************"
+
 
 #****************************** SUMMARY *****************************************************************
 
@@ -560,6 +768,19 @@ echo ""
 echo " - test 2.1: "${TEST_21_PASSED:-skipped}
 echo ""
 echo " - test 3.1: "${TEST_31_PASSED:-skipped}
+echo ""
+echo " - test 4.1: "${TEST_41_PASSED:-skipped}
+echo " - test 4.2: "${TEST_42_PASSED:-skipped}
+echo " - test 4.3: "${TEST_43_PASSED:-skipped}
+echo " - test 4.4: "${TEST_44_PASSED:-skipped}
+echo " - test 4.5: "${TEST_45_PASSED:-skipped}
+echo " - test 4.6: "${TEST_46_PASSED:-skipped}
+echo " - test 4.7: "${TEST_47_PASSED:-skipped}
+echo " - test 4.8: "${TEST_48_PASSED:-skipped}
+echo ""
+echo " - test 5.1: "${TEST_51_PASSED:-skipped}
+echo " - test 5.2: "${TEST_52_PASSED:-skipped}
+echo " - test 5.3: "${TEST_53_PASSED:-skipped}
 echo " ------------------------"
 
 # Checking minimum requirements